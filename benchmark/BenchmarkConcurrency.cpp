@@ -0,0 +1,546 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "SimpleFixedMemoryPool.h"
+
+namespace smp = SimpleMemoryPool;
+
+// Drives pool engines from 1..N pinned threads under churn, producer/consumer
+// and burst patterns, and reports throughput and latency percentiles.
+namespace
+{
+    struct Options
+    {
+        size_t  maxThreadsCount = std::max(1u, std::thread::hardware_concurrency());
+        size_t  operationsCount = 200000;
+        size_t  blockSize = 64;
+        size_t  poolSize = 64 * 1024 * 1024;
+        size_t  burstSize = 256;
+        size_t  latencySamplingRate = 16;
+        bool    isPerfEnabled = false;
+        bool    isPinningEnabled = true;
+        const char * scenario = "all";
+        const char * engine = "all";
+    };
+
+    uint64_t now()
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    // Engine wrapping today's SimpleFixedMemoryPool behind a single mutex.
+    class MutexPoolEngine
+    {
+        smp::SimpleFixedMemoryPool  m_memoryPool;
+        std::mutex                  m_mutex;
+
+    public:
+        explicit MutexPoolEngine(const Options & options) : m_memoryPool(options.poolSize, options.blockSize) {}
+
+        static const char * getName()
+        {
+            return "mutex-pool";
+        }
+
+        smp::MemoryBlock allocate(size_t size)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_memoryPool.allocateMemory(size);
+        }
+
+        void free(smp::MemoryBlock & memoryBlock)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_memoryPool.freeMemory(&memoryBlock);
+        }
+    };
+
+    class MallocEngine
+    {
+    public:
+        explicit MallocEngine(const Options &) {}
+
+        static const char * getName()
+        {
+            return "malloc";
+        }
+
+        smp::MemoryBlock allocate(size_t size)
+        {
+            return smp::MemoryBlock(reinterpret_cast<unsigned char *>(malloc(size)), size);
+        }
+
+        void free(smp::MemoryBlock & memoryBlock)
+        {
+            ::free(memoryBlock.ptr);
+            memoryBlock = smp::MemoryBlock();
+        }
+    };
+
+    // Single producer single consumer ring used to hand blocks between threads.
+    class BlockQueue
+    {
+        std::vector<smp::MemoryBlock>   m_blocks;
+        alignas(64) std::atomic<size_t> m_head{0};
+        alignas(64) std::atomic<size_t> m_tail{0};
+
+    public:
+        explicit BlockQueue(size_t capacity) : m_blocks(capacity) {}
+
+        bool push(const smp::MemoryBlock & memoryBlock)
+        {
+            size_t tail = m_tail.load(std::memory_order_relaxed);
+            if(tail - m_head.load(std::memory_order_acquire) == m_blocks.size())
+            {
+                return false;
+            }
+            m_blocks[tail % m_blocks.size()] = memoryBlock;
+            m_tail.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool pop(smp::MemoryBlock & memoryBlock)
+        {
+            size_t head = m_head.load(std::memory_order_relaxed);
+            if(head == m_tail.load(std::memory_order_acquire))
+            {
+                return false;
+            }
+            memoryBlock = m_blocks[head % m_blocks.size()];
+            m_head.store(head + 1, std::memory_order_release);
+            return true;
+        }
+    };
+
+    // Hardware and software counters of the calling thread, read through perf_event_open.
+    class ThreadCounters
+    {
+#ifdef __linux__
+        int m_cacheMissesFd = -1;
+        int m_contextSwitchesFd = -1;
+
+        static int open(uint32_t type, uint64_t config)
+        {
+            perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = type;
+            attr.config = config;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+        }
+
+        static uint64_t read(int fd)
+        {
+            uint64_t value = 0;
+            if(fd >= 0 && sizeof(value) != ::read(fd, &value, sizeof(value)))
+            {
+                value = 0;
+            }
+            return value;
+        }
+#endif
+
+    public:
+        uint64_t cacheMisses = 0;
+        uint64_t contextSwitches = 0;
+
+        void start(bool isEnabled)
+        {
+#ifdef __linux__
+            if(isEnabled)
+            {
+                m_cacheMissesFd = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+                m_contextSwitchesFd = open(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES);
+            }
+#else
+            (void)isEnabled;
+#endif
+        }
+
+        void stop()
+        {
+#ifdef __linux__
+            cacheMisses = read(m_cacheMissesFd);
+            contextSwitches = read(m_contextSwitchesFd);
+            for(int fd : { m_cacheMissesFd, m_contextSwitchesFd })
+            {
+                if(fd >= 0)
+                {
+                    close(fd);
+                }
+            }
+            m_cacheMissesFd = m_contextSwitchesFd = -1;
+#endif
+        }
+    };
+
+    struct ThreadResult
+    {
+        size_t                  operationsCount = 0;
+        size_t                  failuresCount = 0;
+        std::vector<uint64_t>   latencies;
+        ThreadCounters          counters;
+    };
+
+    void pinThread(size_t index, const Options & options)
+    {
+#ifdef __linux__
+        if(options.isPinningEnabled)
+        {
+            cpu_set_t cpuSet;
+            CPU_ZERO(&cpuSet);
+            CPU_SET(index % std::max(1u, std::thread::hardware_concurrency()), &cpuSet);
+            pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet);
+        }
+#else
+        (void)index;
+        (void)options;
+#endif
+    }
+
+    template<typename Engine>
+    smp::MemoryBlock timedAllocate(Engine & engine, size_t size, size_t operationIndex, const Options & options, ThreadResult & result)
+    {
+        bool isSampled = 0 == operationIndex % options.latencySamplingRate;
+        uint64_t start = isSampled ? now() : 0;
+        smp::MemoryBlock ret = engine.allocate(size);
+        if(isSampled)
+        {
+            result.latencies.push_back(now() - start);
+        }
+        ++result.operationsCount;
+        if(!ret.ptr)
+        {
+            ++result.failuresCount;
+        }
+        return ret;
+    }
+
+    template<typename Engine>
+    void timedFree(Engine & engine, smp::MemoryBlock & memoryBlock, size_t operationIndex, const Options & options, ThreadResult & result)
+    {
+        bool isSampled = 0 == operationIndex % options.latencySamplingRate;
+        uint64_t start = isSampled ? now() : 0;
+        engine.free(memoryBlock);
+        if(isSampled)
+        {
+            result.latencies.push_back(now() - start);
+        }
+        ++result.operationsCount;
+    }
+
+    // Each thread keeps a small working set and replaces one random entry per step.
+    template<typename Engine>
+    void runChurn(Engine & engine, size_t threadIndex, const Options & options, ThreadResult & result)
+    {
+        std::vector<smp::MemoryBlock> workingSet(64);
+        unsigned int seed = static_cast<unsigned int>(threadIndex + 1);
+        for(size_t i = 0; i < options.operationsCount; ++i)
+        {
+            seed = seed * 1103515245 + 12345;
+            smp::MemoryBlock & slot = workingSet[(seed >> 16) % workingSet.size()];
+            if(slot.ptr)
+            {
+                timedFree(engine, slot, i, options, result);
+            }
+            slot = timedAllocate(engine, options.blockSize * ((seed >> 8) % 4 + 1), i, options, result);
+        }
+        for(auto & slot : workingSet)
+        {
+            if(slot.ptr)
+            {
+                engine.free(slot);
+            }
+        }
+    }
+
+    // Each thread allocates a whole burst before releasing it.
+    template<typename Engine>
+    void runBurst(Engine & engine, size_t, const Options & options, ThreadResult & result)
+    {
+        std::vector<smp::MemoryBlock> burst(options.burstSize);
+        for(size_t i = 0; i < options.operationsCount; i += 2 * burst.size())
+        {
+            for(size_t j = 0; j < burst.size(); ++j)
+            {
+                burst[j] = timedAllocate(engine, options.blockSize, i + j, options, result);
+            }
+            for(size_t j = 0; j < burst.size(); ++j)
+            {
+                if(burst[j].ptr)
+                {
+                    timedFree(engine, burst[j], i + j, options, result);
+                }
+            }
+        }
+    }
+
+    // Even threads allocate and hand blocks to the next odd thread, which frees them.
+    template<typename Engine>
+    void runProducerConsumer(Engine & engine, size_t threadIndex, const Options & options, ThreadResult & result,
+                             std::vector<std::unique_ptr<BlockQueue>> & queues, std::atomic<size_t> & producersDone)
+    {
+        BlockQueue & queue = *queues[threadIndex / 2];
+        if(0 == threadIndex % 2)
+        {
+            for(size_t i = 0; i < options.operationsCount / 2; ++i)
+            {
+                smp::MemoryBlock memoryBlock = timedAllocate(engine, options.blockSize, i, options, result);
+                while(memoryBlock.ptr && !queue.push(memoryBlock))
+                {
+                    std::this_thread::yield();
+                }
+            }
+            producersDone.fetch_add(1, std::memory_order_release);
+        }
+        else
+        {
+            size_t producersCount = (queues.size());
+            size_t i = 0;
+            smp::MemoryBlock memoryBlock;
+            while(true)
+            {
+                if(queue.pop(memoryBlock))
+                {
+                    timedFree(engine, memoryBlock, i++, options, result);
+                }
+                else if(producersDone.load(std::memory_order_acquire) == producersCount)
+                {
+                    if(!queue.pop(memoryBlock))
+                    {
+                        break;
+                    }
+                    timedFree(engine, memoryBlock, i++, options, result);
+                }
+                else
+                {
+                    std::this_thread::yield();
+                }
+            }
+        }
+    }
+
+    uint64_t percentile(const std::vector<uint64_t> & sortedLatencies, double fraction)
+    {
+        uint64_t ret = 0;
+        if(!sortedLatencies.empty())
+        {
+            size_t index = static_cast<size_t>(fraction * (sortedLatencies.size() - 1));
+            ret = sortedLatencies[index];
+        }
+        return ret;
+    }
+
+    template<typename Engine>
+    void runScenario(const char * scenario, size_t threadsCount, const Options & options)
+    {
+        bool isProducerConsumer = 0 == strcmp(scenario, "pc");
+        if(isProducerConsumer && threadsCount < 2)
+        {
+            return;
+        }
+        if(isProducerConsumer)
+        {
+            threadsCount &= ~static_cast<size_t>(1);
+        }
+
+        Engine engine(options);
+        std::vector<ThreadResult> results(threadsCount);
+        std::vector<std::unique_ptr<BlockQueue>> queues;
+        for(size_t i = 0; i < threadsCount / 2; ++i)
+        {
+            queues.emplace_back(new BlockQueue(1024));
+        }
+        std::atomic<size_t> producersDone{0};
+        std::atomic<size_t> readyCount{0};
+        std::atomic<bool> isStarted{false};
+        std::vector<std::thread> threads;
+
+        for(size_t i = 0; i < threadsCount; ++i)
+        {
+            threads.emplace_back([&, i]() {
+                pinThread(i, options);
+                results[i].latencies.reserve(2 * options.operationsCount / options.latencySamplingRate + 1);
+                readyCount.fetch_add(1);
+                while(!isStarted.load(std::memory_order_acquire))
+                {
+                    std::this_thread::yield();
+                }
+                results[i].counters.start(options.isPerfEnabled);
+                if(isProducerConsumer)
+                {
+                    runProducerConsumer(engine, i, options, results[i], queues, producersDone);
+                }
+                else if(0 == strcmp(scenario, "burst"))
+                {
+                    runBurst(engine, i, options, results[i]);
+                }
+                else
+                {
+                    runChurn(engine, i, options, results[i]);
+                }
+                results[i].counters.stop();
+            });
+        }
+        while(readyCount.load() != threadsCount)
+        {
+            std::this_thread::yield();
+        }
+        uint64_t start = now();
+        isStarted.store(true, std::memory_order_release);
+        for(auto & thread : threads)
+        {
+            thread.join();
+        }
+        double elapsed = (now() - start) / 1e9;
+
+        size_t operationsCount = 0;
+        size_t failuresCount = 0;
+        uint64_t cacheMisses = 0;
+        uint64_t contextSwitches = 0;
+        std::vector<uint64_t> latencies;
+        for(auto & result : results)
+        {
+            operationsCount += result.operationsCount;
+            failuresCount += result.failuresCount;
+            cacheMisses += result.counters.cacheMisses;
+            contextSwitches += result.counters.contextSwitches;
+            latencies.insert(latencies.end(), result.latencies.begin(), result.latencies.end());
+        }
+        std::sort(latencies.begin(), latencies.end());
+
+        printf("%-10s %-6s %7zu %14.0f %9llu %9llu %9llu %9zu", Engine::getName(), scenario, threadsCount,
+               elapsed > 0 ? operationsCount / elapsed : 0.0,
+               (unsigned long long)percentile(latencies, 0.5), (unsigned long long)percentile(latencies, 0.99),
+               (unsigned long long)percentile(latencies, 0.999), failuresCount);
+        if(options.isPerfEnabled)
+        {
+            printf(" %14llu %9llu", (unsigned long long)cacheMisses, (unsigned long long)contextSwitches);
+        }
+        printf("\n");
+    }
+
+    template<typename Engine>
+    void runEngine(const Options & options)
+    {
+        if(0 != strcmp(options.engine, "all") && 0 != strcmp(options.engine, Engine::getName()))
+        {
+            return;
+        }
+        for(const char * scenario : { "churn", "pc", "burst" })
+        {
+            if(0 != strcmp(options.scenario, "all") && 0 != strcmp(options.scenario, scenario))
+            {
+                continue;
+            }
+            for(size_t threadsCount = 1; threadsCount <= options.maxThreadsCount; threadsCount *= 2)
+            {
+                runScenario<Engine>(scenario, threadsCount, options);
+            }
+        }
+    }
+
+    void printUsage(const char * programName)
+    {
+        printf("Usage : %s [--threads N] [--ops N] [--block-size N] [--pool-size N] [--burst N]\n"
+               "          [--sampling N] [--scenario churn|pc|burst|all] [--engine mutex-pool|malloc|all]\n"
+               "          [--perf] [--no-pin]\n", programName);
+    }
+
+    bool parseOptions(int argc, char ** argv, Options & options)
+    {
+        bool ret = true;
+        for(int i = 1; i < argc && ret; ++i)
+        {
+            bool hasValue = i + 1 < argc;
+            if(0 == strcmp(argv[i], "--perf"))
+            {
+                options.isPerfEnabled = true;
+            }
+            else if(0 == strcmp(argv[i], "--no-pin"))
+            {
+                options.isPinningEnabled = false;
+            }
+            else if(hasValue && 0 == strcmp(argv[i], "--threads"))
+            {
+                options.maxThreadsCount = strtoull(argv[++i], nullptr, 10);
+            }
+            else if(hasValue && 0 == strcmp(argv[i], "--ops"))
+            {
+                options.operationsCount = strtoull(argv[++i], nullptr, 10);
+            }
+            else if(hasValue && 0 == strcmp(argv[i], "--block-size"))
+            {
+                options.blockSize = strtoull(argv[++i], nullptr, 10);
+            }
+            else if(hasValue && 0 == strcmp(argv[i], "--pool-size"))
+            {
+                options.poolSize = strtoull(argv[++i], nullptr, 10);
+            }
+            else if(hasValue && 0 == strcmp(argv[i], "--burst"))
+            {
+                options.burstSize = strtoull(argv[++i], nullptr, 10);
+            }
+            else if(hasValue && 0 == strcmp(argv[i], "--sampling"))
+            {
+                options.latencySamplingRate = strtoull(argv[++i], nullptr, 10);
+            }
+            else if(hasValue && 0 == strcmp(argv[i], "--scenario"))
+            {
+                options.scenario = argv[++i];
+            }
+            else if(hasValue && 0 == strcmp(argv[i], "--engine"))
+            {
+                options.engine = argv[++i];
+            }
+            else
+            {
+                ret = false;
+            }
+        }
+        ret = ret && options.maxThreadsCount > 0 && options.latencySamplingRate > 0 && options.burstSize > 0;
+        return ret;
+    }
+}
+
+int main(int argc, char ** argv)
+{
+    Options options;
+    if(!parseOptions(argc, argv, options))
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    printf("%-10s %-6s %7s %14s %9s %9s %9s %9s", "engine", "test", "threads", "ops/s", "p50 ns", "p99 ns", "p99.9 ns", "failures");
+    if(options.isPerfEnabled)
+    {
+        printf(" %14s %9s", "cache misses", "ctx sw");
+    }
+    printf("\n");
+
+    runEngine<MutexPoolEngine>(options);
+    runEngine<MallocEngine>(options);
+    return 0;
+}
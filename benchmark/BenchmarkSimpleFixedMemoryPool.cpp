@@ -0,0 +1,865 @@
+#include <cstdlib>
+#include <memory_resource>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "SimpleFixedMemoryPool.h"
+#include "BasicFixedPool.h"
+#include "SMPString.h"
+#include "SMPStringBuilder.h"
+#include "SMPStringTable.h"
+#include "SMPVector.h"
+#include "SMPHashMap.h"
+#include "EpochReclaimer.h"
+#include "PoolCoroutine.h"
+
+namespace smp = SimpleMemoryPool;
+
+// Every pool benchmark takes { block size, blocks count, occupancy %, distribution policy }.
+// Run with --benchmark_format=json or --benchmark_out=<file> to track regressions.
+namespace
+{
+    const size_t DistributedCount = 4;
+    const size_t BatchSize = 64;
+
+    struct Record
+    {
+        double  price;
+        long    quantity;
+        int     side;
+        int     venue;
+    };
+
+    struct Point
+    {
+        float x;
+        float y;
+
+        Point(float _x, float _y) : x(_x), y(_y) {}
+    };
+
+    smp::MemoryDistributionPolicy toPolicy(int64_t value)
+    {
+        switch(value)
+        {
+        case 1:
+            return smp::MemoryDistributionPolicy::CloseRanges;
+        case 2:
+            return smp::MemoryDistributionPolicy::OpenRanges;
+        case 3:
+            return smp::MemoryDistributionPolicy::AdaptiveRanges;
+        default:
+            return smp::MemoryDistributionPolicy::None;
+        }
+    }
+
+    // Pool built from the benchmark arguments, with occupancy % of its blocks
+    // left allocated in a scattered pattern so that free runs are fragmented.
+    class OccupiedPool
+    {
+        smp::SimpleFixedMemoryPool      m_memoryPool;
+        std::vector<smp::MemoryBlock>   m_blocks;
+
+    public:
+        explicit OccupiedPool(const benchmark::State & state)
+            : m_memoryPool(static_cast<size_t>(state.range(0) * state.range(1)), static_cast<size_t>(state.range(0)),
+                           DistributedCount, toPolicy(state.range(3)))
+        {
+            size_t occupancy = static_cast<size_t>(state.range(2));
+            m_blocks.resize(m_memoryPool.getMemoryBlocksCount());
+            for(auto & block : m_blocks)
+            {
+                block = m_memoryPool.allocateMemory();
+            }
+            unsigned int seed = 12345;
+            for(auto & block : m_blocks)
+            {
+                seed = seed * 1103515245 + 12345;
+                if((seed >> 16) % 100 >= occupancy)
+                {
+                    m_memoryPool.freeMemory(&block);
+                }
+            }
+        }
+
+        ~OccupiedPool()
+        {
+            for(auto & block : m_blocks)
+            {
+                m_memoryPool.freeMemory(&block);
+            }
+        }
+
+        smp::SimpleFixedMemoryPool & get()
+        {
+            return m_memoryPool;
+        }
+    };
+
+    void poolArguments(benchmark::internal::Benchmark * benchmark)
+    {
+        benchmark->ArgNames({ "block", "blocks", "occupancy", "policy" })
+                 ->ArgsProduct({ { 64, 256, 4096 }, { 1 << 10, 1 << 14 }, { 0, 50, 90 }, { 0, 1, 2, 3 } });
+    }
+
+    void sizeArguments(benchmark::internal::Benchmark * benchmark)
+    {
+        benchmark->ArgName("size")->Arg(16)->Arg(64)->Arg(256)->Arg(1024)->Arg(4096);
+    }
+}
+
+static void BM_Pool_AllocateFree(benchmark::State & state)
+{
+    OccupiedPool pool(state);
+    for(auto _ : state)
+    {
+        smp::MemoryBlock mem = pool.get().allocateMemory();
+        benchmark::DoNotOptimize(mem.ptr);
+        pool.get().freeMemory(&mem);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_Pool_AllocateFree)->Apply(poolArguments);
+
+static void BM_Pool_AllocateSizeFree(benchmark::State & state)
+{
+    OccupiedPool pool(state);
+    size_t size = static_cast<size_t>(state.range(0)) * 3;
+    for(auto _ : state)
+    {
+        smp::MemoryBlock mem = pool.get().allocateMemory(size);
+        benchmark::DoNotOptimize(mem.ptr);
+        pool.get().freeMemory(&mem);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_Pool_AllocateSizeFree)->Apply(poolArguments);
+
+static void BM_Pool_AllocateBatch(benchmark::State & state)
+{
+    OccupiedPool pool(state);
+    smp::MemoryBlock blocks[BatchSize];
+    for(auto _ : state)
+    {
+        for(auto & block : blocks)
+        {
+            block = pool.get().allocateMemory();
+        }
+        for(auto & block : blocks)
+        {
+            pool.get().freeMemory(&block);
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * BatchSize);
+}
+BENCHMARK(BM_Pool_AllocateBatch)->Apply(poolArguments);
+
+static void BM_Pool_ConstructDestruct(benchmark::State & state)
+{
+    OccupiedPool pool(state);
+    for(auto _ : state)
+    {
+        Point * p = pool.get().construct<Point>(1.0f, 2.0f);
+        benchmark::DoNotOptimize(p);
+        pool.get().destruct(&p);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_Pool_ConstructDestruct)->Apply(poolArguments);
+
+static void BM_Pool_Create(benchmark::State & state)
+{
+    size_t totalSize = static_cast<size_t>(state.range(0)) << 20;
+    for(auto _ : state)
+    {
+        smp::SimpleFixedMemoryPool memoryPool(totalSize, 64);
+        benchmark::DoNotOptimize(memoryPool.allocateMemory().ptr);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_Pool_Create)->ArgName("MiB")->Arg(1)->Arg(64)->Arg(1024)->Unit(benchmark::kMicrosecond);
+
+// A short lived session: build a 256 KiB pool, make a few allocations and drop everything.
+static void BM_Pool_Session(benchmark::State & state)
+{
+    for(auto _ : state)
+    {
+        smp::SimpleFixedMemoryPool memoryPool(256 * 1024, 64);
+        for(size_t i = 0; i < 64; ++i)
+        {
+            benchmark::DoNotOptimize(memoryPool.allocateMemory(96).ptr);
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_Pool_Session);
+
+static void BM_SubPool_Session(benchmark::State & state)
+{
+    smp::SimpleFixedMemoryPool parentMemoryPool(4 * 1024 * 1024, 4096, 1, smp::MemoryDistributionPolicy::None,
+                                                static_cast<smp::MemoryZeroingPolicy>(state.range(0)));
+    for(auto _ : state)
+    {
+        smp::SimpleFixedMemoryPool memoryPool(&parentMemoryPool, 256 * 1024, 64);
+        for(size_t i = 0; i < 64; ++i)
+        {
+            benchmark::DoNotOptimize(memoryPool.allocateMemory(96).ptr);
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SubPool_Session)->ArgName("parentZeroing")
+    ->Arg(static_cast<int64_t>(smp::MemoryZeroingPolicy::OnFree))->Arg(static_cast<int64_t>(smp::MemoryZeroingPolicy::OnFreeBulk));
+
+// Destroying a sub-pool only, its run goes back to the default OnFree parent.
+static void BM_SubPool_Release(benchmark::State & state)
+{
+    const size_t subPoolSize = static_cast<size_t>(state.range(0)) * 1024;
+    smp::SimpleFixedMemoryPool parentMemoryPool(4 * subPoolSize, 4096);
+    std::optional<smp::SimpleFixedMemoryPool> memoryPool;
+    for(auto _ : state)
+    {
+        state.PauseTiming();
+        memoryPool.emplace(&parentMemoryPool, subPoolSize, 64);
+        memoryPool->allocateMemory();
+        state.ResumeTiming();
+        memoryPool.reset();
+    }
+}
+BENCHMARK(BM_SubPool_Release)->ArgName("KiB")->Arg(256)->Arg(4096);
+
+// Skewed traffic: every request is of the first size class. The served counter is the share of
+// the 3/4 of the pool asked for that the first range could hold without spilling or failing.
+static void BM_Pool_SkewedDemand(benchmark::State & state)
+{
+    const size_t blocksCount = 4096;
+    smp::SimpleFixedMemoryPool memoryPool(blocksCount * 64, 64, DistributedCount, toPolicy(state.range(0)));
+    std::vector<smp::MemoryBlock> blocks(blocksCount * 3 / 4);
+    for(auto _ : state)
+    {
+        for(auto & block : blocks)
+        {
+            block = memoryPool.allocateMemory(64);
+        }
+        for(auto & block : blocks)
+        {
+            memoryPool.freeMemory(&block);
+        }
+    }
+    smp::MemoryRangeStats range = memoryPool.getDistributionRangeStats(0);
+    state.counters["served"] = static_cast<double>(range.allocationsCount - range.spillsCount) /
+                               static_cast<double>(blocks.size() * state.iterations());
+    state.SetItemsProcessed(state.iterations() * blocks.size());
+}
+BENCHMARK(BM_Pool_SkewedDemand)->ArgName("policy")->Arg(1)->Arg(3);
+
+// Reads the header word of a few hundred live blocks over and over. Packed blocks of a power of
+// two size put every header in the same few cache sets, so they keep evicting each other even
+// though they would all fit in L1. Colored blocks spread them over every set.
+static void BM_Pool_ScanHeaders(benchmark::State & state)
+{
+    const size_t blockSize = static_cast<size_t>(state.range(0));
+    const size_t blocksCount = 512;
+    smp::SimpleFixedMemoryPool memoryPool(blocksCount * (blockSize + smp::SimpleFixedMemoryPool::CacheLineSize), blockSize,
+                                          1, smp::MemoryDistributionPolicy::None, smp::MemoryZeroingPolicy::OnFree,
+                                          static_cast<smp::MemoryColoringPolicy>(state.range(1)));
+    std::vector<uint64_t *> headers(blocksCount);
+    for(size_t i = 0; i < blocksCount; ++i)
+    {
+        headers[i] = reinterpret_cast<uint64_t *>(memoryPool.allocateMemory().ptr);
+        *headers[i] = i;
+    }
+    for(auto _ : state)
+    {
+        uint64_t sum = 0;
+        for(uint64_t * header : headers)
+        {
+            sum += *header;
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * blocksCount);
+}
+BENCHMARK(BM_Pool_ScanHeaders)->ArgNames({ "block", "coloring" })->ArgsProduct({ { 256, 4096 }, { 0, 1 } });
+
+static void BM_Pool_ConstructArray(benchmark::State & state)
+{
+    smp::SimpleFixedMemoryPool memoryPool(1 << 24, 256);
+    size_t count = static_cast<size_t>(state.range(0));
+    for(auto _ : state)
+    {
+        smp::ArrayBlock<Record> records = memoryPool.constructArray<Record>(count);
+        benchmark::DoNotOptimize(records.ptr);
+        memoryPool.destructArray(&records);
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_Pool_ConstructArray)->ArgName("count")->Arg(16)->Arg(256)->Arg(4096);
+
+static void BM_Pool_ConstructArrayFromPrototype(benchmark::State & state)
+{
+    smp::SimpleFixedMemoryPool memoryPool(1 << 24, 256);
+    size_t count = static_cast<size_t>(state.range(0));
+    const Record prototype = { 1.5, 100, 1, 2 };
+    for(auto _ : state)
+    {
+        smp::ArrayBlock<Record> records = memoryPool.constructArray<Record>(count, prototype);
+        benchmark::DoNotOptimize(records.ptr);
+        memoryPool.destructArray(&records);
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_Pool_ConstructArrayFromPrototype)->ArgName("count")->Arg(16)->Arg(256)->Arg(4096);
+
+static void BM_BasicPool_AllocateFree(benchmark::State & state)
+{
+    smp::BasicFixedPool<256> memoryPool(256 << 14);
+    for(auto _ : state)
+    {
+        smp::MemoryBlock mem = memoryPool.allocateMemory();
+        benchmark::DoNotOptimize(mem.ptr);
+        memoryPool.freeMemory(&mem);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_BasicPool_AllocateFree);
+
+static void BM_BasicPool_AllocateSizeFree(benchmark::State & state)
+{
+    smp::BasicFixedPool<256, smp::CloseRangesDistribution<4>, smp::NoLock, smp::NoStats, smp::NoZeroing> memoryPool(256 << 14);
+    for(auto _ : state)
+    {
+        smp::MemoryBlock mem = memoryPool.allocateMemory(3 * 256);
+        benchmark::DoNotOptimize(mem.ptr);
+        memoryPool.freeMemory(&mem);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_BasicPool_AllocateSizeFree);
+
+static void BM_Malloc_AllocateFree(benchmark::State & state)
+{
+    size_t size = static_cast<size_t>(state.range(0));
+    for(auto _ : state)
+    {
+        void * ptr = malloc(size);
+        benchmark::DoNotOptimize(ptr);
+        free(ptr);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_Malloc_AllocateFree)->Apply(sizeArguments);
+
+static void BM_New_ConstructDestruct(benchmark::State & state)
+{
+    for(auto _ : state)
+    {
+        Point * p = new Point(1.0f, 2.0f);
+        benchmark::DoNotOptimize(p);
+        delete p;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_New_ConstructDestruct);
+
+static void BM_New_ConstructArray(benchmark::State & state)
+{
+    size_t count = static_cast<size_t>(state.range(0));
+    for(auto _ : state)
+    {
+        Record * records = new Record[count]();
+        benchmark::DoNotOptimize(records);
+        delete[] records;
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_New_ConstructArray)->ArgName("count")->Arg(16)->Arg(256)->Arg(4096);
+
+static void BM_Pmr_AllocateFree(benchmark::State & state)
+{
+    std::pmr::unsynchronized_pool_resource resource;
+    size_t size = static_cast<size_t>(state.range(0));
+    for(auto _ : state)
+    {
+        void * ptr = resource.allocate(size);
+        benchmark::DoNotOptimize(ptr);
+        resource.deallocate(ptr, size);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_Pmr_AllocateFree)->Apply(sizeArguments);
+
+static void BM_Malloc_AllocateBatch(benchmark::State & state)
+{
+    size_t size = static_cast<size_t>(state.range(0));
+    void * ptrs[BatchSize];
+    for(auto _ : state)
+    {
+        for(auto & ptr : ptrs)
+        {
+            ptr = malloc(size);
+        }
+        for(auto & ptr : ptrs)
+        {
+            free(ptr);
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * BatchSize);
+}
+BENCHMARK(BM_Malloc_AllocateBatch)->Apply(sizeArguments);
+
+static void BM_SMPString_Construct(benchmark::State & state)
+{
+    smp::SimpleFixedMemoryPool memoryPool(1 << 20, 64);
+    for(auto _ : state)
+    {
+        smp::SMPString str(&memoryPool, "EURUSD.XLON");
+        benchmark::DoNotOptimize(str.getBuffer());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SMPString_Construct);
+
+static void BM_SMPString_Copy(benchmark::State & state)
+{
+    smp::SimpleFixedMemoryPool memoryPool(1 << 20, 64);
+    smp::SMPString str(&memoryPool, "EURUSD.XLON");
+    for(auto _ : state)
+    {
+        smp::SMPString copy(str);
+        benchmark::DoNotOptimize(copy.getBuffer());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SMPString_Copy);
+
+// Fans a payload out to subscribers, copies of a pool string share its buffer.
+static void BM_SMPString_CopyLong(benchmark::State & state)
+{
+    smp::SimpleFixedMemoryPool memoryPool(1 << 20, 64);
+    smp::SMPString payload(&memoryPool, "8=FIX.4.4|35=D|55=EURUSD|54=1|38=1000000|40=2|44=1.0842|59=0|");
+    for(auto _ : state)
+    {
+        smp::SMPString copy(payload);
+        benchmark::DoNotOptimize(copy.getBuffer());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SMPString_CopyLong);
+
+static void BM_SMPString_Append(benchmark::State & state)
+{
+    smp::SimpleFixedMemoryPool memoryPool(1 << 24, 64);
+    size_t count = static_cast<size_t>(state.range(0));
+    for(auto _ : state)
+    {
+        smp::SMPString str(&memoryPool);
+        for(size_t i = 0; i < count; ++i)
+        {
+            str += "field=value;";
+        }
+        benchmark::DoNotOptimize(str.getBuffer());
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_SMPString_Append)->ArgName("appends")->Arg(4)->Arg(64);
+
+static void BM_SMPString_Concatenate(benchmark::State & state)
+{
+    smp::SimpleFixedMemoryPool memoryPool(1 << 20, 64);
+    smp::SMPString a(&memoryPool, "EURUSD");
+    smp::SMPString b(&memoryPool, ".");
+    smp::SMPString c(&memoryPool, "XLON");
+    for(auto _ : state)
+    {
+        smp::SMPString str = a + b + c;
+        benchmark::DoNotOptimize(str.getBuffer());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SMPString_Concatenate);
+
+static void BM_SMPString_ConcatenateLong(benchmark::State & state)
+{
+    smp::SimpleFixedMemoryPool memoryPool(1 << 20, 64);
+    smp::SMPString symbol(&memoryPool, "EURUSD.XLON.SPOT.FIXING");
+    smp::SMPString venue(&memoryPool, "LONDON.STOCK.EXCHANGE.MAIN");
+    smp::SMPString account(&memoryPool, "ACCOUNT.0001.PRIMARY.BOOK");
+    for(auto _ : state)
+    {
+        smp::SMPString str = symbol + "|" + venue + "|" + account;
+        benchmark::DoNotOptimize(str.getBuffer());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SMPString_ConcatenateLong);
+
+static void BM_SMPStringBuilder_ConcatenateLong(benchmark::State & state)
+{
+    smp::SimpleFixedMemoryPool memoryPool(1 << 20, 64);
+    smp::SMPString symbol(&memoryPool, "EURUSD.XLON.SPOT.FIXING");
+    smp::SMPString venue(&memoryPool, "LONDON.STOCK.EXCHANGE.MAIN");
+    smp::SMPString account(&memoryPool, "ACCOUNT.0001.PRIMARY.BOOK");
+    for(auto _ : state)
+    {
+        smp::SMPString str = smp::concatenate(&memoryPool, symbol, "|", venue, "|", account);
+        benchmark::DoNotOptimize(str.getBuffer());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SMPStringBuilder_ConcatenateLong);
+
+static void BM_SMPString_Equal(benchmark::State & state)
+{
+    smp::SimpleFixedMemoryPool memoryPool(1 << 20, 64);
+    smp::SMPString a(&memoryPool, "EURUSD.XLON.0001");
+    smp::SMPString b(&memoryPool, "EURUSD.XLON.0002");
+    for(auto _ : state)
+    {
+        benchmark::DoNotOptimize(a == b);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SMPString_Equal);
+
+static std::string makeSearchText(size_t size)
+{
+    std::string ret;
+    for(size_t i = 0; i < size; ++i)
+    {
+        ret += static_cast<char>('a' + (i * 7 + i / 13) % 20);
+    }
+    return ret;
+}
+
+static void BM_SMPString_EqualLong(benchmark::State & state)
+{
+    smp::SimpleFixedMemoryPool memoryPool(1 << 20, 64);
+    std::string text = makeSearchText(static_cast<size_t>(state.range(0)));
+    smp::SMPString a(&memoryPool, std::string_view(text));
+    text.back() = '#';
+    smp::SMPString b(&memoryPool, std::string_view(text));
+    for(auto _ : state)
+    {
+        benchmark::DoNotOptimize(a == b);
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_SMPString_EqualLong)->ArgName("size")->Arg(64)->Arg(1024);
+
+static void BM_StdString_EqualLong(benchmark::State & state)
+{
+    std::string a = makeSearchText(static_cast<size_t>(state.range(0)));
+    std::string b = a;
+    b.back() = '#';
+    for(auto _ : state)
+    {
+        benchmark::DoNotOptimize(a == b);
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_StdString_EqualLong)->ArgName("size")->Arg(64)->Arg(1024);
+
+static void BM_SMPString_Compare(benchmark::State & state)
+{
+    smp::SimpleFixedMemoryPool memoryPool(1 << 20, 64);
+    std::string text = makeSearchText(static_cast<size_t>(state.range(0)));
+    smp::SMPString a(&memoryPool, std::string_view(text));
+    text.back() = '#';
+    smp::SMPString b(&memoryPool, std::string_view(text));
+    for(auto _ : state)
+    {
+        benchmark::DoNotOptimize(a.compare(b));
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_SMPString_Compare)->ArgName("size")->Arg(64)->Arg(1024);
+
+static void BM_StdString_Compare(benchmark::State & state)
+{
+    std::string a = makeSearchText(static_cast<size_t>(state.range(0)));
+    std::string b = a;
+    b.back() = '#';
+    for(auto _ : state)
+    {
+        benchmark::DoNotOptimize(a.compare(b));
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_StdString_Compare)->ArgName("size")->Arg(64)->Arg(1024);
+
+// The pattern only appears at the end of the text.
+static void BM_SMPString_Find(benchmark::State & state)
+{
+    smp::SimpleFixedMemoryPool memoryPool(1 << 20, 64);
+    std::string text = makeSearchText(static_cast<size_t>(state.range(0))) + "|35=D|";
+    smp::SMPString str(&memoryPool, std::string_view(text));
+    for(auto _ : state)
+    {
+        benchmark::DoNotOptimize(str.find("|35=D|"));
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_SMPString_Find)->ArgName("size")->Arg(64)->Arg(1024);
+
+static void BM_StdString_Find(benchmark::State & state)
+{
+    std::string text = makeSearchText(static_cast<size_t>(state.range(0))) + "|35=D|";
+    for(auto _ : state)
+    {
+        benchmark::DoNotOptimize(text.find("|35=D|"));
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_StdString_Find)->ArgName("size")->Arg(64)->Arg(1024);
+
+static void BM_SMPString_RFind(benchmark::State & state)
+{
+    smp::SimpleFixedMemoryPool memoryPool(1 << 20, 64);
+    std::string text = "|35=D|" + makeSearchText(static_cast<size_t>(state.range(0)));
+    smp::SMPString str(&memoryPool, std::string_view(text));
+    for(auto _ : state)
+    {
+        benchmark::DoNotOptimize(str.rfind("|35=D|"));
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_SMPString_RFind)->ArgName("size")->Arg(64)->Arg(1024);
+
+static void BM_StdString_RFind(benchmark::State & state)
+{
+    std::string text = "|35=D|" + makeSearchText(static_cast<size_t>(state.range(0)));
+    for(auto _ : state)
+    {
+        benchmark::DoNotOptimize(text.rfind("|35=D|"));
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_StdString_RFind)->ArgName("size")->Arg(64)->Arg(1024);
+
+static void BM_SMPStringTable_InternBatch(benchmark::State & state)
+{
+    smp::SimpleFixedMemoryPool memoryPool(1 << 24, 64);
+    smp::SMPStringTable table(&memoryPool);
+    size_t distinctCount = static_cast<size_t>(state.range(0));
+    std::vector<std::string> tokens;
+    for(size_t i = 0; i < 4096; ++i)
+    {
+        tokens.push_back("SYMBOL." + std::to_string(i % distinctCount));
+    }
+    std::vector<std::string_view> views(tokens.begin(), tokens.end());
+    std::vector<smp::InternedString> handles(views.size());
+    for(auto _ : state)
+    {
+        benchmark::DoNotOptimize(table.internBatch(views.data(), views.size(), handles.data()));
+    }
+    state.SetItemsProcessed(state.iterations() * views.size());
+}
+BENCHMARK(BM_SMPStringTable_InternBatch)->ArgName("distinct")->Arg(64)->Arg(4096);
+
+static void BM_SMPStringTable_HandleEqual(benchmark::State & state)
+{
+    smp::SimpleFixedMemoryPool memoryPool(1 << 20, 64);
+    smp::SMPStringTable table(&memoryPool);
+    smp::InternedString a = table.intern("EURUSD.XLON.0001");
+    smp::InternedString b = table.intern("EURUSD.XLON.0002");
+    for(auto _ : state)
+    {
+        benchmark::DoNotOptimize(a == b);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SMPStringTable_HandleEqual);
+
+static void BM_SMPVector_PushBack(benchmark::State & state)
+{
+    smp::SimpleFixedMemoryPool memoryPool(1 << 24, 64);
+    size_t count = static_cast<size_t>(state.range(0));
+    for(auto _ : state)
+    {
+        smp::SMPVector<uint64_t> vector(&memoryPool);
+        for(size_t i = 0; i < count; ++i)
+        {
+            vector.pushBack(i);
+        }
+        benchmark::DoNotOptimize(vector.getData());
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_SMPVector_PushBack)->ArgName("count")->Arg(64)->Arg(4096);
+
+static void BM_StdVector_PushBack(benchmark::State & state)
+{
+    size_t count = static_cast<size_t>(state.range(0));
+    for(auto _ : state)
+    {
+        std::vector<uint64_t> vector;
+        for(size_t i = 0; i < count; ++i)
+        {
+            vector.push_back(i);
+        }
+        benchmark::DoNotOptimize(vector.data());
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_StdVector_PushBack)->ArgName("count")->Arg(64)->Arg(4096);
+
+static void BM_SMPHashMap_Find(benchmark::State & state)
+{
+    smp::SimpleFixedMemoryPool memoryPool(1 << 24, 64);
+    size_t count = static_cast<size_t>(state.range(0));
+    smp::SMPHashMap<uint64_t, uint64_t> map(&memoryPool, count);
+    for(size_t i = 0; i < count; ++i)
+    {
+        map.tryEmplace(i * 7919, i);
+    }
+    uint64_t key = 0;
+    for(auto _ : state)
+    {
+        benchmark::DoNotOptimize(map.find(key));
+        key = (key + 7919) % (count * 7919);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SMPHashMap_Find)->ArgName("count")->Arg(1024)->Arg(1 << 16);
+
+static void BM_StdUnorderedMap_Find(benchmark::State & state)
+{
+    size_t count = static_cast<size_t>(state.range(0));
+    std::unordered_map<uint64_t, uint64_t> map;
+    map.reserve(count);
+    for(size_t i = 0; i < count; ++i)
+    {
+        map.emplace(i * 7919, i);
+    }
+    uint64_t key = 0;
+    for(auto _ : state)
+    {
+        benchmark::DoNotOptimize(map.find(key));
+        key = (key + 7919) % (count * 7919);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_StdUnorderedMap_Find)->ArgName("count")->Arg(1024)->Arg(1 << 16);
+
+static void BM_SMPHashMap_InsertErase(benchmark::State & state)
+{
+    smp::SimpleFixedMemoryPool memoryPool(1 << 24, 64);
+    smp::SMPHashMap<uint64_t, uint64_t> map(&memoryPool, 1024);
+    uint64_t key = 0;
+    for(auto _ : state)
+    {
+        map.tryEmplace(key, key);
+        map.erase(key - 512);
+        ++key;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SMPHashMap_InsertErase);
+
+static void BM_StdUnorderedMap_InsertErase(benchmark::State & state)
+{
+    std::unordered_map<uint64_t, uint64_t> map;
+    map.reserve(1024);
+    uint64_t key = 0;
+    for(auto _ : state)
+    {
+        map.emplace(key, key);
+        map.erase(key - 512);
+        ++key;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_StdUnorderedMap_InsertErase);
+
+static smp::SimpleFixedMemoryPool g_epochMemoryPool(1 << 20, 64);
+static smp::EpochReclaimer<> g_epochReclaimer(&g_epochMemoryPool);
+static std::shared_mutex g_readersMutex;
+
+static void BM_EpochReclaimer_ReadGuard(benchmark::State & state)
+{
+    for(auto _ : state)
+    {
+        smp::EpochReclaimer<>::ReadGuard guard(g_epochReclaimer);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_EpochReclaimer_ReadGuard)->Threads(1)->Threads(4);
+
+static void BM_SharedMutex_ReadLock(benchmark::State & state)
+{
+    for(auto _ : state)
+    {
+        std::shared_lock<std::shared_mutex> lock(g_readersMutex);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SharedMutex_ReadLock)->Threads(1)->Threads(4);
+
+static void BM_EpochReclaimer_Retire(benchmark::State & state)
+{
+    smp::SimpleFixedMemoryPool memoryPool(1 << 20, 64);
+    smp::EpochReclaimer<smp::SimpleFixedMemoryPool, smp::NoLock> reclaimer(&memoryPool);
+    for(auto _ : state)
+    {
+        reclaimer.retire(memoryPool.allocateMemory(64));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_EpochReclaimer_Retire);
+
+#if defined(__cpp_impl_coroutine)
+static smp::PoolTask<int> spawnAsync(int value)
+{
+    co_return value + 1;
+}
+
+static smp::PoolTask<int> spawnAsync(std::allocator_arg_t, [[maybe_unused]] smp::SimpleFixedMemoryPool * memoryPool, int value)
+{
+    co_return value + 1;
+}
+
+static smp::PoolTask<int, smp::PoolFrameCache<>> spawnAsync(std::allocator_arg_t, [[maybe_unused]] smp::PoolFrameCache<> * frameCache, int value)
+{
+    co_return value + 1;
+}
+
+// Spawns a task and runs it to the end. frames: 0 the global operator new, 1 a pool passed
+// with std::allocator_arg, 2 the thread default pool, 3 a PoolFrameCache in front of the pool.
+static void BM_Coroutine_Spawn(benchmark::State & state)
+{
+    smp::SimpleFixedMemoryPool memoryPool(1 << 20, 256);
+    smp::PoolFrameCache<> frameCache(&memoryPool);
+    smp::SimpleFixedMemoryPool * previousPool = smp::PoolPromise<>::setThreadPool(2 == state.range(0) ? &memoryPool : nullptr);
+    int value = 0;
+    for(auto _ : state)
+    {
+        if(3 == state.range(0))
+        {
+            smp::PoolTask<int, smp::PoolFrameCache<>> task = spawnAsync(std::allocator_arg, &frameCache, value);
+            task.resume();
+            value = task.getResult();
+        }
+        else
+        {
+            smp::PoolTask<int> task = 1 == state.range(0) ? spawnAsync(std::allocator_arg, &memoryPool, value) : spawnAsync(value);
+            task.resume();
+            value = task.getResult();
+        }
+        benchmark::DoNotOptimize(value);
+    }
+    smp::PoolPromise<>::setThreadPool(previousPool);
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_Coroutine_Spawn)->ArgName("frames")->Arg(0)->Arg(1)->Arg(2)->Arg(3);
+#endif
+
+BENCHMARK_MAIN();
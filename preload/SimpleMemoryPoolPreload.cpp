@@ -0,0 +1,496 @@
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <new>
+
+#include <dlfcn.h>
+#include <pthread.h>
+
+#include "SimpleFixedMemoryPool.h"
+
+// LD_PRELOAD library sending small malloc and operator new requests to SimpleFixedMemoryPool
+// size classes, everything else goes to the glibc allocator through its __libc_ entry points.
+//
+//   LD_PRELOAD=./libSimpleMemoryPoolPreload.so <program>
+//
+// SMP_PRELOAD_BLOCKS_PER_CLASS sets the blocks count of every size class, 65536 by default.
+// A full size class falls back to the system allocator. The stats are printed to stderr at
+// exit, SMP_PRELOAD_STATS=0 turns that off.
+
+extern "C"
+{
+    void * __libc_malloc(size_t size);
+    void * __libc_calloc(size_t count, size_t size);
+    void * __libc_realloc(void * ptr, size_t size);
+    void * __libc_memalign(size_t alignment, size_t size);
+    void __libc_free(void * ptr);
+}
+
+namespace smp = SimpleMemoryPool;
+
+namespace
+{
+    // Size classes of 16, 32, ... 1024 bytes.
+    const size_t SizeClassesCount = 7;
+    const size_t MinSizeClassShift = 4;
+    const size_t DefaultBlocksPerClass = 1 << 16;
+    // Pool runs start from a malloc'ed region, every block keeps its alignment.
+    const size_t PoolAlignment = 16;
+
+    enum BootstrapState
+    {
+        Uninitialized,
+        Initializing,
+        Ready
+    };
+
+    // Every member is initialized so that the size classes are constant initialized: the first
+    // malloc comes before the static constructors, which must not reset the pools afterwards.
+    struct alignas(64) SizeClass
+    {
+        alignas(smp::SimpleFixedMemoryPool) unsigned char poolStorage[sizeof(smp::SimpleFixedMemoryPool)] = {};
+        smp::SimpleFixedMemoryPool *    pool = nullptr;
+        size_t                          usableSize = 0;
+        std::mutex                      mutex;
+        std::atomic<size_t>             fallbacksCount { 0 };
+    };
+
+    // Pools are built in static storage and never destroyed, other exit handlers may still free.
+    SizeClass g_sizeClasses[SizeClassesCount];
+    std::atomic<int> g_state { Uninitialized };
+    std::atomic<size_t> g_systemAllocationsCount { 0 };
+
+    // Set while the thread runs pool or bootstrap code, so that anything they allocate
+    // goes straight to the system allocator instead of coming back here.
+    __attribute__((tls_model("initial-exec"))) thread_local bool t_isInsideAllocator = false;
+
+    class ReentryGuard
+    {
+        bool m_wasInside;
+
+    public :
+        ReentryGuard() : m_wasInside(t_isInsideAllocator) { t_isInsideAllocator = true; }
+        ~ReentryGuard() { t_isInsideAllocator = m_wasInside; }
+    };
+
+    size_t readSizeEnv(const char * name, size_t defaultValue)
+    {
+        const char * value = getenv(name);
+        size_t ret = value ? strtoull(value, nullptr, 10) : 0;
+        return ret ? ret : defaultValue;
+    }
+
+    void lockSizeClasses()
+    {
+        for(SizeClass & sizeClass : g_sizeClasses)
+        {
+            sizeClass.mutex.lock();
+        }
+    }
+
+    void unlockSizeClasses()
+    {
+        for(SizeClass & sizeClass : g_sizeClasses)
+        {
+            sizeClass.mutex.unlock();
+        }
+    }
+
+    // The first thread in builds the pools, the others use the system allocator meanwhile.
+    void bootstrap()
+    {
+        int expected = Uninitialized;
+        if(g_state.compare_exchange_strong(expected, Initializing))
+        {
+            ReentryGuard guard;
+            size_t blocksCount = readSizeEnv("SMP_PRELOAD_BLOCKS_PER_CLASS", DefaultBlocksPerClass);
+            for(size_t i = 0; i < SizeClassesCount; ++i)
+            {
+                SizeClass & sizeClass = g_sizeClasses[i];
+                size_t blockSize = size_t(1) << (MinSizeClassShift + i);
+                sizeClass.pool = new (sizeClass.poolStorage) smp::SimpleFixedMemoryPool(
+                    blocksCount * blockSize, blockSize, 1, smp::MemoryDistributionPolicy::None, smp::MemoryZeroingPolicy::Never);
+#if SMP_HARDENING_ENABLED
+                sizeClass.usableSize = blockSize - smp::Hardening::RedZoneSize;
+#else
+                sizeClass.usableSize = blockSize;
+#endif
+            }
+            // A child forked while another thread held a size class would deadlock on it.
+            pthread_atfork(&lockSizeClasses, &unlockSizeClasses, &unlockSizeClasses);
+            g_state.store(Ready, std::memory_order_release);
+        }
+    }
+
+    bool isPoolReady()
+    {
+        if(t_isInsideAllocator)
+        {
+            return false;
+        }
+        if(Ready != g_state.load(std::memory_order_acquire))
+        {
+            bootstrap();
+        }
+        return Ready == g_state.load(std::memory_order_acquire);
+    }
+
+    SizeClass * findSizeClass(size_t size)
+    {
+        size_t i = size <= (size_t(1) << MinSizeClassShift) ? 0 :
+            64 - __builtin_clzll(static_cast<unsigned long long>(size - 1)) - MinSizeClassShift;
+        while(i < SizeClassesCount && g_sizeClasses[i].usableSize < size)
+        {
+            ++i;
+        }
+        return i < SizeClassesCount ? &g_sizeClasses[i] : nullptr;
+    }
+
+    // Pool regions never move, no lock is needed to tell whose pointer it is.
+    SizeClass * findOwner(const void * ptr)
+    {
+        SizeClass * ret = nullptr;
+        if(Ready == g_state.load(std::memory_order_acquire))
+        {
+            for(size_t i = 0; i < SizeClassesCount && !ret; ++i)
+            {
+                if(g_sizeClasses[i].pool->containsMemory(ptr))
+                {
+                    ret = &g_sizeClasses[i];
+                }
+            }
+        }
+        return ret;
+    }
+
+    void * allocate(size_t size)
+    {
+        void * ret = nullptr;
+        SizeClass * sizeClass = isPoolReady() ? findSizeClass(size) : nullptr;
+        if(sizeClass)
+        {
+            ReentryGuard guard;
+            std::lock_guard<std::mutex> lock(sizeClass->mutex);
+            ret = sizeClass->pool->allocateMemory().ptr;
+        }
+        if(!ret)
+        {
+            if(sizeClass)
+            {
+                sizeClass->fallbacksCount.fetch_add(1, std::memory_order_relaxed);
+            }
+            else
+            {
+                g_systemAllocationsCount.fetch_add(1, std::memory_order_relaxed);
+            }
+            ret = __libc_malloc(size);
+        }
+        return ret;
+    }
+
+    void release(void * ptr)
+    {
+        SizeClass * sizeClass = ptr ? findOwner(ptr) : nullptr;
+        if(sizeClass)
+        {
+            ReentryGuard guard;
+            std::lock_guard<std::mutex> lock(sizeClass->mutex);
+            smp::MemoryBlock memoryBlock(static_cast<unsigned char *>(ptr), sizeClass->usableSize);
+            sizeClass->pool->freeMemory(&memoryBlock);
+        }
+        else if(ptr)
+        {
+            __libc_free(ptr);
+        }
+    }
+
+    void * allocateAligned(size_t alignment, size_t size)
+    {
+        return alignment <= PoolAlignment ? allocate(size) : __libc_memalign(alignment, size);
+    }
+
+    void * allocateZeroed(size_t count, size_t size)
+    {
+        void * ret = nullptr;
+        size_t totalSize = 0;
+        if(__builtin_mul_overflow(count, size, &totalSize))
+        {
+            errno = ENOMEM;
+        }
+        else if(findSizeClass(totalSize) && !t_isInsideAllocator)
+        {
+            // The pools do not zero anything, and system fallbacks come from malloc too.
+            ret = allocate(totalSize);
+            if(ret)
+            {
+                memset(ret, 0, totalSize);
+            }
+        }
+        else
+        {
+            g_systemAllocationsCount.fetch_add(1, std::memory_order_relaxed);
+            ret = __libc_calloc(count, size);
+        }
+        return ret;
+    }
+
+    void * reallocate(void * ptr, size_t size)
+    {
+        void * ret = nullptr;
+        SizeClass * sizeClass = ptr ? findOwner(ptr) : nullptr;
+        if(!ptr)
+        {
+            ret = allocate(size);
+        }
+        else if(!sizeClass)
+        {
+            ret = __libc_realloc(ptr, size);
+        }
+        else if(0 == size)
+        {
+            release(ptr);
+        }
+        else if(size <= sizeClass->usableSize)
+        {
+            ret = ptr;
+        }
+        else
+        {
+            ret = allocate(size);
+            if(ret)
+            {
+                memcpy(ret, ptr, sizeClass->usableSize);
+                release(ptr);
+            }
+        }
+        return ret;
+    }
+
+    size_t getUsableSize(void * ptr)
+    {
+        using UsableSizeFunction = size_t (*)(void *);
+        static UsableSizeFunction systemUsableSize = nullptr;
+        size_t ret = 0;
+        SizeClass * sizeClass = ptr ? findOwner(ptr) : nullptr;
+        if(sizeClass)
+        {
+            ret = sizeClass->usableSize;
+        }
+        else if(ptr)
+        {
+            if(!systemUsableSize)
+            {
+                systemUsableSize = reinterpret_cast<UsableSizeFunction>(dlsym(RTLD_NEXT, "malloc_usable_size"));
+            }
+            ret = systemUsableSize ? systemUsableSize(ptr) : 0;
+        }
+        return ret;
+    }
+
+    void * allocateOrThrow(size_t size)
+    {
+        void * ret = allocate(size);
+        while(!ret)
+        {
+            std::new_handler handler = std::get_new_handler();
+            if(!handler)
+            {
+                throw std::bad_alloc();
+            }
+            handler();
+            ret = allocate(size);
+        }
+        return ret;
+    }
+
+    void * allocateAlignedOrThrow(size_t size, std::align_val_t alignment)
+    {
+        void * ret = allocateAligned(static_cast<size_t>(alignment), size);
+        if(!ret)
+        {
+            throw std::bad_alloc();
+        }
+        return ret;
+    }
+
+    __attribute__((destructor)) void dumpStats()
+    {
+        const char * isEnabled = getenv("SMP_PRELOAD_STATS");
+        if(Ready == g_state.load(std::memory_order_acquire) && !(isEnabled && 0 == strcmp(isEnabled, "0")))
+        {
+            fprintf(stderr, "SimpleMemoryPool preload stats\n");
+            fprintf(stderr, "%10s %12s %12s %14s %14s %14s %12s\n",
+                    "class", "used blocks", "blocks", "peak bytes", "allocations", "frees", "fallbacks");
+            for(SizeClass & sizeClass : g_sizeClasses)
+            {
+                smp::MemoryPoolStats stats;
+                {
+                    ReentryGuard guard;
+                    std::lock_guard<std::mutex> lock(sizeClass.mutex);
+                    stats = sizeClass.pool->getStats();
+                }
+                fprintf(stderr, "%10zu %12zu %12zu %14zu %14zu %14zu %12zu\n",
+                        stats.blockSize, stats.usedBlocksCount, stats.blocksCount, stats.peakUsedSize,
+                        stats.allocationsCount, stats.freesCount, sizeClass.fallbacksCount.load());
+            }
+            fprintf(stderr, "system allocations : %zu\n", g_systemAllocationsCount.load());
+        }
+    }
+}
+
+extern "C"
+{
+    __attribute__((visibility("default"))) void * malloc(size_t size)
+    {
+        return allocate(size);
+    }
+
+    __attribute__((visibility("default"))) void free(void * ptr)
+    {
+        release(ptr);
+    }
+
+    __attribute__((visibility("default"))) void * calloc(size_t count, size_t size)
+    {
+        return allocateZeroed(count, size);
+    }
+
+    __attribute__((visibility("default"))) void * realloc(void * ptr, size_t size)
+    {
+        return reallocate(ptr, size);
+    }
+
+    __attribute__((visibility("default"))) void * aligned_alloc(size_t alignment, size_t size)
+    {
+        return allocateAligned(alignment, size);
+    }
+
+    __attribute__((visibility("default"))) void * memalign(size_t alignment, size_t size)
+    {
+        return allocateAligned(alignment, size);
+    }
+
+    __attribute__((visibility("default"))) int posix_memalign(void ** ptr, size_t alignment, size_t size)
+    {
+        int ret = EINVAL;
+        if(alignment >= sizeof(void *) && 0 == (alignment & (alignment - 1)))
+        {
+            void * memory = allocateAligned(alignment, size);
+            ret = memory ? 0 : ENOMEM;
+            if(memory)
+            {
+                *ptr = memory;
+            }
+        }
+        return ret;
+    }
+
+    __attribute__((visibility("default"))) size_t malloc_usable_size(void * ptr)
+    {
+        return getUsableSize(ptr);
+    }
+}
+
+void * operator new(size_t size)
+{
+    return allocateOrThrow(size);
+}
+
+void * operator new[](size_t size)
+{
+    return allocateOrThrow(size);
+}
+
+void * operator new(size_t size, const std::nothrow_t &) noexcept
+{
+    return allocate(size);
+}
+
+void * operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+    return allocate(size);
+}
+
+void * operator new(size_t size, std::align_val_t alignment)
+{
+    return allocateAlignedOrThrow(size, alignment);
+}
+
+void * operator new[](size_t size, std::align_val_t alignment)
+{
+    return allocateAlignedOrThrow(size, alignment);
+}
+
+void * operator new(size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept
+{
+    return allocateAligned(static_cast<size_t>(alignment), size);
+}
+
+void * operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept
+{
+    return allocateAligned(static_cast<size_t>(alignment), size);
+}
+
+void operator delete(void * ptr) noexcept
+{
+    release(ptr);
+}
+
+void operator delete[](void * ptr) noexcept
+{
+    release(ptr);
+}
+
+void operator delete(void * ptr, size_t) noexcept
+{
+    release(ptr);
+}
+
+void operator delete[](void * ptr, size_t) noexcept
+{
+    release(ptr);
+}
+
+void operator delete(void * ptr, const std::nothrow_t &) noexcept
+{
+    release(ptr);
+}
+
+void operator delete[](void * ptr, const std::nothrow_t &) noexcept
+{
+    release(ptr);
+}
+
+void operator delete(void * ptr, std::align_val_t) noexcept
+{
+    release(ptr);
+}
+
+void operator delete[](void * ptr, std::align_val_t) noexcept
+{
+    release(ptr);
+}
+
+void operator delete(void * ptr, size_t, std::align_val_t) noexcept
+{
+    release(ptr);
+}
+
+void operator delete[](void * ptr, size_t, std::align_val_t) noexcept
+{
+    release(ptr);
+}
+
+void operator delete(void * ptr, std::align_val_t, const std::nothrow_t &) noexcept
+{
+    release(ptr);
+}
+
+void operator delete[](void * ptr, std::align_val_t, const std::nothrow_t &) noexcept
+{
+    release(ptr);
+}
@@ -0,0 +1,159 @@
+#include "AllocationTrace.h"
+
+#include <atomic>
+#include <chrono>
+
+namespace SimpleMemoryPool
+{
+    namespace
+    {
+        uint64_t traceTimestamp()
+        {
+            return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count());
+        }
+
+        uint16_t traceThreadId()
+        {
+            static std::atomic<uint16_t> lastThreadId{0};
+            thread_local uint16_t threadId = ++lastThreadId;
+            return threadId;
+        }
+
+        struct TraceFileHeader
+        {
+            uint32_t magic;
+            uint32_t version;
+        };
+    }
+
+    AllocationTraceRecorder::AllocationTraceRecorder(size_t capacity, const char * filePath)
+        : m_events(capacity > 0 ? capacity : 1), m_head(0), m_count(0), m_droppedCount(0),
+        m_startTime(traceTimestamp()), m_file(nullptr)
+    {
+        if(filePath)
+        {
+            m_file = fopen(filePath, "wb");
+            if(m_file && !writeHeader())
+            {
+                fclose(m_file);
+                m_file = nullptr;
+            }
+            if(!m_file)
+            {
+                printf("COULD NOT OPEN trace file %s\n", filePath);
+            }
+        }
+    }
+
+    AllocationTraceRecorder::~AllocationTraceRecorder()
+    {
+        if(m_file)
+        {
+            flush();
+            fclose(m_file);
+            m_file = nullptr;
+        }
+    }
+
+    bool AllocationTraceRecorder::writeHeader()
+    {
+        TraceFileHeader header = { FileMagic, FileVersion };
+        return 1 == fwrite(&header, sizeof(header), 1, m_file);
+    }
+
+    void AllocationTraceRecorder::flush()
+    {
+        size_t first = (m_head + m_events.size() - m_count) % m_events.size();
+        for(size_t i = 0; i < m_count; ++i)
+        {
+            fwrite(&m_events[(first + i) % m_events.size()], sizeof(TraceEvent), 1, m_file);
+        }
+        m_count = 0;
+    }
+
+    void AllocationTraceRecorder::record(TraceEventType type, uint64_t id, uint64_t size, size_t blocksCount)
+    {
+        if(m_count == m_events.size())
+        {
+            if(m_file)
+            {
+                flush();
+            }
+            else
+            {
+                --m_count;
+                ++m_droppedCount;
+            }
+        }
+        TraceEvent & event = m_events[m_head];
+        event.timestamp = traceTimestamp() - m_startTime;
+        event.id = id;
+        event.size = size;
+        event.blocksCount = static_cast<uint32_t>(blocksCount);
+        event.threadId = traceThreadId();
+        event.type = type;
+        event.reserved = 0;
+        m_head = (m_head + 1) % m_events.size();
+        ++m_count;
+    }
+
+    std::vector<TraceEvent> AllocationTraceRecorder::getEvents() const
+    {
+        std::vector<TraceEvent> ret;
+        ret.reserve(m_count);
+        size_t first = (m_head + m_events.size() - m_count) % m_events.size();
+        for(size_t i = 0; i < m_count; ++i)
+        {
+            ret.push_back(m_events[(first + i) % m_events.size()]);
+        }
+        return ret;
+    }
+
+    size_t AllocationTraceRecorder::getDroppedEventsCount() const
+    {
+        return m_droppedCount;
+    }
+
+    bool AllocationTraceRecorder::isRecordingToFile() const
+    {
+        return nullptr != m_file;
+    }
+
+    bool AllocationTraceRecorder::saveToFile(const char * filePath) const
+    {
+        bool ret = false;
+        FILE * file = fopen(filePath, "wb");
+        if(file)
+        {
+            TraceFileHeader header = { FileMagic, FileVersion };
+            std::vector<TraceEvent> events = getEvents();
+            ret = 1 == fwrite(&header, sizeof(header), 1, file) &&
+                  events.size() == fwrite(events.data(), sizeof(TraceEvent), events.size(), file);
+            fclose(file);
+        }
+        return ret;
+    }
+
+    bool AllocationTraceRecorder::loadFromFile(const char * filePath, std::vector<TraceEvent> & events)
+    {
+        bool ret = false;
+        FILE * file = fopen(filePath, "rb");
+        if(file)
+        {
+            TraceFileHeader header = {};
+            if(1 == fread(&header, sizeof(header), 1, file) && FileMagic == header.magic && FileVersion == header.version)
+            {
+                TraceEvent event;
+                events.clear();
+                while(1 == fread(&event, sizeof(TraceEvent), 1, file))
+                {
+                    events.push_back(event);
+                }
+                ret = true;
+            }
+            fclose(file);
+        }
+        return ret;
+    }
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+namespace SimpleMemoryPool
+{
+    enum class TraceEventType : uint8_t
+    {
+        Allocate,
+        Free,
+        Construct,
+        Destruct,
+        Resize
+    };
+
+    // One pool operation. id is the pool allocation id, 0 when the operation failed.
+    // threadId is a small per-process index assigned to each recording thread.
+    struct TraceEvent
+    {
+        uint64_t        timestamp;
+        uint64_t        id;
+        uint64_t        size;
+        uint32_t        blocksCount;
+        uint16_t        threadId;
+        TraceEventType  type;
+        uint8_t         reserved;
+    };
+
+    static_assert(sizeof(TraceEvent) == 32, "TraceEvent is stored as is in trace files");
+
+    // Records pool events into a fixed ring buffer. Without a file the oldest events
+    // are overwritten once the buffer is full, with a file the buffer is flushed to it
+    // instead so the whole run is kept. A recorder is fed by a single pool at a time.
+    class AllocationTraceRecorder
+    {
+        std::vector<TraceEvent> m_events;
+        size_t                  m_head;
+        size_t                  m_count;
+        size_t                  m_droppedCount;
+        uint64_t                m_startTime;
+        FILE *                  m_file;
+
+        bool writeHeader();
+        void flush();
+
+    public:
+        static constexpr uint32_t FileMagic = 0x54504d53; // "SMPT"
+        static constexpr uint32_t FileVersion = 1;
+
+        explicit AllocationTraceRecorder(size_t capacity, const char * filePath = nullptr);
+        ~AllocationTraceRecorder();
+
+        AllocationTraceRecorder(const AllocationTraceRecorder &) = delete;
+        AllocationTraceRecorder & operator=(const AllocationTraceRecorder &) = delete;
+
+        void record(TraceEventType type, uint64_t id, uint64_t size, size_t blocksCount);
+
+        // Events still held in the ring buffer, oldest first.
+        std::vector<TraceEvent> getEvents() const;
+        size_t getDroppedEventsCount() const;
+        bool isRecordingToFile() const;
+
+        // Writes the buffered events to a trace file readable by loadFromFile.
+        bool saveToFile(const char * filePath) const;
+        static bool loadFromFile(const char * filePath, std::vector<TraceEvent> & events);
+    };
+}
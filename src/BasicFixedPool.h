@@ -0,0 +1,196 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <mutex>
+#include <new>
+#include <utility>
+
+#include "MemoryBlock.h"
+#include "FreeRunTree.h"
+#include "PoolPolicies.h"
+
+namespace SimpleMemoryPool
+{
+    // Fixed block pool configured at compile time. BlockSize has to be a power of two,
+    // so block indexes come from shifts and masks instead of divisions, and every
+    // policy is a type whose unused hooks compile to nothing.
+    // It only allocates, frees and constructs: no resize, arrays, trace recorder, hardening,
+    // trim, quota, sub-pools or OnAllocate zeroing, and its ranges never adapt. Use
+    // SimpleFixedMemoryPool for those or when the configuration is only known at runtime.
+    template<size_t BlockSize,
+             class DistributionPolicy = NoDistribution,
+             class LockPolicy = NoLock,
+             class StatsPolicy = NoStats,
+             class ZeroPolicy = ZeroOnFree>
+    class BasicFixedPool
+    {
+        static_assert(isPowerOfTwo(BlockSize), "BlockSize has to be a power of two");
+
+        static constexpr size_t BlockShift = log2Of(BlockSize);
+        static constexpr size_t BlockMask = BlockSize - 1;
+
+        size_t              m_totalSize;
+        size_t              m_usedSize;
+        size_t              m_blocksCount;
+        size_t              m_freeBlocksCount;
+        unsigned char *     m_startBlockPtr;
+        // Length of the run starting at each block, 0 for blocks that do not start a used run.
+        uint32_t *          m_runLengths;
+        FreeRunTree         m_freeRuns;
+        LockPolicy          m_lock;
+        StatsPolicy         m_stats;
+
+    public:
+        explicit BasicFixedPool(size_t totalSize);
+        ~BasicFixedPool();
+
+        BasicFixedPool(const BasicFixedPool &) = delete;
+        BasicFixedPool & operator=(const BasicFixedPool &) = delete;
+        BasicFixedPool(BasicFixedPool &&) = delete;
+        BasicFixedPool & operator=(BasicFixedPool &&) = delete;
+
+        MemoryBlock allocateMemory();
+        MemoryBlock allocateMemory(size_t size);
+        bool freeMemory(MemoryBlock * memoryBlock);
+
+        template<typename T, class ... Args>
+        T * construct(Args && ... args);
+        template<typename T>
+        bool destruct(T ** ptr);
+
+        static constexpr size_t getMemoryBlockSize() { return BlockSize; }
+        size_t getMemoryTotalSize() const { return m_totalSize; }
+        size_t getMemoryUsedSize() const { return m_usedSize; }
+        size_t getMemoryBlocksCount() const { return m_blocksCount; }
+        size_t getFreeMemoryBlocksCount() const { return m_freeBlocksCount; }
+        size_t getUsedMemoryBlocksCount() const { return m_blocksCount - m_freeBlocksCount; }
+        size_t getLargestFreeRunBlocksCount() const { return m_freeRuns.getLargestFreeRun(); }
+
+        MemoryPoolStats getStats() const;
+    };
+
+    template<size_t BlockSize, class DistributionPolicy, class LockPolicy, class StatsPolicy, class ZeroPolicy>
+    BasicFixedPool<BlockSize, DistributionPolicy, LockPolicy, StatsPolicy, ZeroPolicy>::BasicFixedPool(size_t totalSize)
+        : m_totalSize(totalSize), m_usedSize(0), m_blocksCount(totalSize >> BlockShift), m_freeBlocksCount(totalSize >> BlockShift),
+        m_startBlockPtr(nullptr), m_runLengths(nullptr)
+    {
+        m_startBlockPtr = reinterpret_cast<unsigned char *>(calloc(m_totalSize, sizeof(uint8_t)));
+        m_runLengths = reinterpret_cast<uint32_t *>(calloc(m_blocksCount, sizeof(uint32_t)));
+        if((m_totalSize && !m_startBlockPtr) || (m_blocksCount && !m_runLengths))
+        {
+            printf("COULD NOT ALLOCATE %zu memory\n", m_totalSize);
+            std::terminate();
+        }
+        m_freeRuns.reset(m_blocksCount);
+    }
+
+    template<size_t BlockSize, class DistributionPolicy, class LockPolicy, class StatsPolicy, class ZeroPolicy>
+    BasicFixedPool<BlockSize, DistributionPolicy, LockPolicy, StatsPolicy, ZeroPolicy>::~BasicFixedPool()
+    {
+        free(m_startBlockPtr);
+        free(m_runLengths);
+    }
+
+    template<size_t BlockSize, class DistributionPolicy, class LockPolicy, class StatsPolicy, class ZeroPolicy>
+    MemoryBlock BasicFixedPool<BlockSize, DistributionPolicy, LockPolicy, StatsPolicy, ZeroPolicy>::allocateMemory()
+    {
+        return allocateMemory(BlockSize);
+    }
+
+    template<size_t BlockSize, class DistributionPolicy, class LockPolicy, class StatsPolicy, class ZeroPolicy>
+    MemoryBlock BasicFixedPool<BlockSize, DistributionPolicy, LockPolicy, StatsPolicy, ZeroPolicy>::allocateMemory(size_t size)
+    {
+        MemoryBlock ret;
+        std::lock_guard<LockPolicy> lock(m_lock);
+        uint64_t sampleStart = m_stats.beginSample();
+        size_t requestedBlocksCount = (size + BlockMask) >> BlockShift;
+        size_t from = 0;
+        size_t to = 0;
+        if(m_freeBlocksCount >= requestedBlocksCount &&
+           DistributionPolicy::computeSearchRange(requestedBlocksCount, m_blocksCount, from, to))
+        {
+            size_t i = m_freeRuns.findFirstFit(requestedBlocksCount, from, to);
+            if(FreeRunTree::npos != i && requestedBlocksCount > 0)
+            {
+                ret.ptr = m_startBlockPtr + (i << BlockShift);
+                ret.size = requestedBlocksCount << BlockShift;
+                m_runLengths[i] = static_cast<uint32_t>(requestedBlocksCount);
+                m_freeRuns.markUsed(i, i + requestedBlocksCount);
+                m_usedSize += ret.size;
+                m_freeBlocksCount -= requestedBlocksCount;
+                ZeroPolicy::onAllocate(ret.ptr, ret.size);
+            }
+        }
+        m_stats.recordAllocation(size, requestedBlocksCount, ret.ptr != nullptr, m_usedSize, sampleStart);
+        return ret;
+    }
+
+    template<size_t BlockSize, class DistributionPolicy, class LockPolicy, class StatsPolicy, class ZeroPolicy>
+    bool BasicFixedPool<BlockSize, DistributionPolicy, LockPolicy, StatsPolicy, ZeroPolicy>::freeMemory(MemoryBlock * memoryBlock)
+    {
+        bool ret = false;
+        std::lock_guard<LockPolicy> lock(m_lock);
+        uint64_t sampleStart = m_stats.beginSample();
+        if(memoryBlock && memoryBlock->ptr >= m_startBlockPtr)
+        {
+            size_t offset = static_cast<size_t>(memoryBlock->ptr - m_startBlockPtr);
+            size_t first = offset >> BlockShift;
+            if(0 == (offset & BlockMask) && first < m_blocksCount && m_runLengths[first])
+            {
+                size_t runLength = m_runLengths[first];
+                m_runLengths[first] = 0;
+                m_freeRuns.markFree(first, first + runLength);
+                m_usedSize -= runLength << BlockShift;
+                m_freeBlocksCount += runLength;
+                ZeroPolicy::onFree(memoryBlock->ptr, runLength << BlockShift);
+                memoryBlock->ptr = nullptr;
+                memoryBlock->size = 0;
+                ret = true;
+            }
+        }
+        m_stats.recordFree(ret, m_usedSize, sampleStart);
+        return ret;
+    }
+
+    template<size_t BlockSize, class DistributionPolicy, class LockPolicy, class StatsPolicy, class ZeroPolicy>
+    template<typename T, class ... Args>
+    T * BasicFixedPool<BlockSize, DistributionPolicy, LockPolicy, StatsPolicy, ZeroPolicy>::construct(Args && ... args)
+    {
+        T * ret = nullptr;
+        MemoryBlock mem = allocateMemory(sizeof(T));
+        if(mem.ptr)
+        {
+            ret = new (mem.ptr) T(std::forward<Args>(args)...);
+        }
+        return ret;
+    }
+
+    template<size_t BlockSize, class DistributionPolicy, class LockPolicy, class StatsPolicy, class ZeroPolicy>
+    template<typename T>
+    bool BasicFixedPool<BlockSize, DistributionPolicy, LockPolicy, StatsPolicy, ZeroPolicy>::destruct(T ** ptr)
+    {
+        bool ret = false;
+        if(*ptr)
+        {
+            (*ptr)->~T();
+            MemoryBlock memoryBlock((unsigned char *)(*ptr), sizeof(T));
+            ret = freeMemory(&memoryBlock);
+            *ptr = reinterpret_cast<T *>(memoryBlock.ptr);
+        }
+        return ret;
+    }
+
+    template<size_t BlockSize, class DistributionPolicy, class LockPolicy, class StatsPolicy, class ZeroPolicy>
+    MemoryPoolStats BasicFixedPool<BlockSize, DistributionPolicy, LockPolicy, StatsPolicy, ZeroPolicy>::getStats() const
+    {
+        MemoryPoolStats ret;
+        ret.totalSize = m_totalSize;
+        ret.blockSize = BlockSize;
+        ret.blocksCount = m_blocksCount;
+        m_stats.fill(ret);
+        ret.usedBlocksCount = ret.usedSize >> BlockShift;
+        return ret;
+    }
+}
@@ -0,0 +1,281 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "MemoryBlock.h"
+#include "PoolPolicies.h"
+#include "SimpleFixedMemoryPool.h"
+
+namespace SimpleMemoryPool
+{
+    // Epoch based reclamation on top of a pool, for structures that readers walk without locks.
+    // A reader holds a ReadGuard for the whole traversal, a writer unlinks a block and
+    // retires it instead of freeing it. Retired blocks go back to the pool in batches, once
+    // every reader that could still see them has left.
+    // Blocks are freed from the threads calling retire or reclaim, so those have to be allowed
+    // to use the pool: a single writer, or a pool taking its own lock. LockPolicy only guards
+    // the retired list between writers.
+    template<class Pool = SimpleFixedMemoryPool, class LockPolicy = MutexLock>
+    class EpochReclaimer
+    {
+        // 0 when free, otherwise the epoch read by the reader on entry.
+        struct alignas(64) ReaderSlot
+        {
+            std::atomic<uint64_t> epoch { 0 };
+        };
+
+        struct RetiredBlock
+        {
+            MemoryBlock memoryBlock;
+            void     (* destroy)(void *);
+            uint64_t    epoch;
+        };
+
+        Pool *                          m_memoryPool;
+        std::atomic<uint64_t>           m_epoch;
+        std::unique_ptr<ReaderSlot[]>   m_readerSlots;
+        size_t                          m_readerSlotsCount;
+        std::unique_ptr<RetiredBlock[]> m_retiredBlocks;
+        size_t                          m_retiredCapacity;
+        size_t                          m_retiredHead;
+        size_t                          m_retiredCount;
+        size_t                          m_batchSize;
+        LockPolicy                      m_lock;
+
+        size_t enter();
+        void exit(size_t slot);
+        void push(const MemoryBlock & memoryBlock, void (* destroy)(void *));
+        uint64_t computeSafeEpoch();
+        void waitForReaders();
+        size_t reclaimBefore(uint64_t epoch);
+        void growRetiredBlocks();
+
+        template<typename T>
+        static void destroyObject(void * object) { static_cast<T *>(object)->~T(); }
+
+    public :
+        static constexpr size_t DefaultReaderSlotsCount = 64;
+        static constexpr size_t DefaultRetiredCapacity = 1024;
+        static constexpr size_t DefaultBatchSize = 64;
+
+        // Keeps the reader inside the current epoch for its lifetime.
+        class ReadGuard
+        {
+            EpochReclaimer &    m_reclaimer;
+            size_t              m_slot;
+
+        public :
+            explicit ReadGuard(EpochReclaimer & reclaimer) : m_reclaimer(reclaimer), m_slot(reclaimer.enter()) {}
+            ~ReadGuard() { m_reclaimer.exit(m_slot); }
+
+            ReadGuard(const ReadGuard &) = delete;
+            ReadGuard & operator=(const ReadGuard &) = delete;
+        };
+
+        // readerSlotsCount bounds the readers inside at the same time, more of them wait for a slot.
+        // A full retired list is reclaimed, and doubled when readers still hold all of it: waiting
+        // instead would never end for a writer retiring inside its own ReadGuard.
+        EpochReclaimer(Pool * memoryPool, size_t readerSlotsCount = DefaultReaderSlotsCount,
+                       size_t retiredCapacity = DefaultRetiredCapacity, size_t batchSize = DefaultBatchSize);
+        // Frees every retired block, no reader may still be inside.
+        ~EpochReclaimer();
+
+        EpochReclaimer(const EpochReclaimer &) = delete;
+        EpochReclaimer & operator=(const EpochReclaimer &) = delete;
+
+        // The block has to be unlinked already, it is freed once no reader can reach it.
+        void retire(MemoryBlock memoryBlock);
+        // Same for an object built in a pool block, its destructor runs right before the free.
+        template<typename T>
+        void retire(T * object);
+
+        // Frees the retired blocks no reader can see anymore and returns how many.
+        size_t reclaim();
+        // Waits for the readers inside now to leave, then frees every retired block.
+        size_t reclaimAll();
+
+        size_t getRetiredCount() const { return m_retiredCount; }
+        size_t getRetiredCapacity() const { return m_retiredCapacity; }
+        uint64_t getEpoch() const { return m_epoch.load(std::memory_order_relaxed); }
+        Pool * getMemoryPool() const { return m_memoryPool; }
+    };
+
+    template<class Pool, class LockPolicy>
+    EpochReclaimer<Pool, LockPolicy>::EpochReclaimer(Pool * memoryPool, size_t readerSlotsCount,
+                                                     size_t retiredCapacity, size_t batchSize)
+        : m_memoryPool(memoryPool), m_epoch(1),
+        m_readerSlots(new ReaderSlot[readerSlotsCount ? readerSlotsCount : 1]),
+        m_readerSlotsCount(readerSlotsCount ? readerSlotsCount : 1),
+        m_retiredBlocks(new RetiredBlock[retiredCapacity ? retiredCapacity : 1]),
+        m_retiredCapacity(retiredCapacity ? retiredCapacity : 1), m_retiredHead(0), m_retiredCount(0),
+        m_batchSize(batchSize ? batchSize : 1)
+    {
+    }
+
+    template<class Pool, class LockPolicy>
+    EpochReclaimer<Pool, LockPolicy>::~EpochReclaimer()
+    {
+        reclaimBefore(UINT64_MAX);
+    }
+
+    // Claims a free slot, starting from the one this thread used last.
+    template<class Pool, class LockPolicy>
+    size_t EpochReclaimer<Pool, LockPolicy>::enter()
+    {
+        thread_local size_t hint = 0;
+        size_t ret = hint % m_readerSlotsCount;
+        uint64_t expected = 0;
+        uint64_t epoch = m_epoch.load(std::memory_order_seq_cst);
+        size_t triesCount = 0;
+        while(!m_readerSlots[ret].epoch.compare_exchange_weak(expected, epoch, std::memory_order_seq_cst))
+        {
+            expected = 0;
+            ret = (ret + 1) % m_readerSlotsCount;
+            if(++triesCount % m_readerSlotsCount == 0)
+            {
+                std::this_thread::yield();
+                epoch = m_epoch.load(std::memory_order_seq_cst);
+            }
+        }
+        // Orders the announcement before the traversal loads, against the fence in computeSafeEpoch.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        hint = ret;
+        return ret;
+    }
+
+    template<class Pool, class LockPolicy>
+    void EpochReclaimer<Pool, LockPolicy>::exit(size_t slot)
+    {
+        m_readerSlots[slot].epoch.store(0, std::memory_order_release);
+    }
+
+    // A block retired at epoch r is safe once every reader inside entered at an epoch after r:
+    // the epoch only moves past r after the retire, which comes after the unlink. Readers that
+    // announce after the scan below start their traversal after the unlink too.
+    template<class Pool, class LockPolicy>
+    uint64_t EpochReclaimer<Pool, LockPolicy>::computeSafeEpoch()
+    {
+        uint64_t ret = m_epoch.fetch_add(1, std::memory_order_seq_cst) + 1;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        for(size_t i = 0; i < m_readerSlotsCount; ++i)
+        {
+            uint64_t epoch = m_readerSlots[i].epoch.load(std::memory_order_acquire);
+            if(epoch && epoch < ret)
+            {
+                ret = epoch;
+            }
+        }
+        return ret;
+    }
+
+    template<class Pool, class LockPolicy>
+    void EpochReclaimer<Pool, LockPolicy>::waitForReaders()
+    {
+        uint64_t epoch = m_epoch.fetch_add(1, std::memory_order_seq_cst) + 1;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        for(size_t i = 0; i < m_readerSlotsCount; ++i)
+        {
+            uint64_t slotEpoch = m_readerSlots[i].epoch.load(std::memory_order_acquire);
+            while(slotEpoch && slotEpoch < epoch)
+            {
+                std::this_thread::yield();
+                slotEpoch = m_readerSlots[i].epoch.load(std::memory_order_acquire);
+            }
+        }
+    }
+
+    // Retired blocks are kept in epoch order, so the reclaimable ones are always at the head.
+    template<class Pool, class LockPolicy>
+    size_t EpochReclaimer<Pool, LockPolicy>::reclaimBefore(uint64_t epoch)
+    {
+        size_t ret = 0;
+        while(m_retiredCount && m_retiredBlocks[m_retiredHead].epoch < epoch)
+        {
+            RetiredBlock & retired = m_retiredBlocks[m_retiredHead];
+            if(retired.destroy)
+            {
+                retired.destroy(retired.memoryBlock.ptr);
+            }
+            if(m_memoryPool)
+            {
+                m_memoryPool->freeMemory(&retired.memoryBlock);
+            }
+            m_retiredHead = (m_retiredHead + 1) % m_retiredCapacity;
+            --m_retiredCount;
+            ++ret;
+        }
+        return ret;
+    }
+
+    // Keeps the retired blocks in epoch order, the head moves back to the first entry.
+    template<class Pool, class LockPolicy>
+    void EpochReclaimer<Pool, LockPolicy>::growRetiredBlocks()
+    {
+        size_t capacity = 2 * m_retiredCapacity;
+        std::unique_ptr<RetiredBlock[]> retiredBlocks(new RetiredBlock[capacity]);
+        for(size_t i = 0; i < m_retiredCount; ++i)
+        {
+            retiredBlocks[i] = m_retiredBlocks[(m_retiredHead + i) % m_retiredCapacity];
+        }
+        m_retiredBlocks = std::move(retiredBlocks);
+        m_retiredCapacity = capacity;
+        m_retiredHead = 0;
+    }
+
+    template<class Pool, class LockPolicy>
+    void EpochReclaimer<Pool, LockPolicy>::push(const MemoryBlock & memoryBlock, void (* destroy)(void *))
+    {
+        // Orders the caller's unlink before the epoch read below.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::lock_guard<LockPolicy> lock(m_lock);
+        if(m_retiredCount == m_retiredCapacity && 0 == reclaimBefore(computeSafeEpoch()))
+        {
+            growRetiredBlocks();
+        }
+        size_t tail = (m_retiredHead + m_retiredCount) % m_retiredCapacity;
+        m_retiredBlocks[tail] = RetiredBlock{ memoryBlock, destroy, m_epoch.load(std::memory_order_seq_cst) };
+        ++m_retiredCount;
+        if(m_retiredCount % m_batchSize == 0)
+        {
+            reclaimBefore(computeSafeEpoch());
+        }
+    }
+
+    template<class Pool, class LockPolicy>
+    void EpochReclaimer<Pool, LockPolicy>::retire(MemoryBlock memoryBlock)
+    {
+        if(memoryBlock.ptr)
+        {
+            push(memoryBlock, nullptr);
+        }
+    }
+
+    template<class Pool, class LockPolicy>
+    template<typename T>
+    void EpochReclaimer<Pool, LockPolicy>::retire(T * object)
+    {
+        if(object)
+        {
+            push(MemoryBlock(reinterpret_cast<unsigned char *>(object), sizeof(T)), &destroyObject<T>);
+        }
+    }
+
+    template<class Pool, class LockPolicy>
+    size_t EpochReclaimer<Pool, LockPolicy>::reclaim()
+    {
+        std::lock_guard<LockPolicy> lock(m_lock);
+        return m_retiredCount ? reclaimBefore(computeSafeEpoch()) : 0;
+    }
+
+    template<class Pool, class LockPolicy>
+    size_t EpochReclaimer<Pool, LockPolicy>::reclaimAll()
+    {
+        std::lock_guard<LockPolicy> lock(m_lock);
+        waitForReaders();
+        return reclaimBefore(UINT64_MAX);
+    }
+}
@@ -0,0 +1,208 @@
+#include "FreeRunTree.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+
+namespace SimpleMemoryPool
+{
+    namespace
+    {
+        enum : uint8_t
+        {
+            FreeState = 1,
+            UsedState = 2
+        };
+    }
+
+    FreeRunTree::FreeRunTree() : m_nodes(nullptr), m_size(0), m_isOwningNodes(false)
+    {
+    }
+
+    FreeRunTree::~FreeRunTree()
+    {
+        release();
+    }
+
+    void FreeRunTree::release()
+    {
+        if(m_nodes && m_isOwningNodes)
+        {
+            free(m_nodes);
+        }
+        m_nodes = nullptr;
+        m_isOwningNodes = false;
+    }
+
+    // An empty tree still gets its root, a used node spanning no block.
+    size_t FreeRunTree::computeNodesCount(size_t size)
+    {
+        if(size > MaxBlocksCount)
+        {
+            printf("COULD NOT TRACK %zu blocks\n", size);
+            std::terminate();
+        }
+        return size > 0 ? 2 * size - 1 : 1;
+    }
+
+    size_t FreeRunTree::getStorageSize(size_t size)
+    {
+        return computeNodesCount(size) * sizeof(Node);
+    }
+
+    void FreeRunTree::reset(size_t size)
+    {
+        release();
+        m_size = size;
+        size_t nodesCount = computeNodesCount(m_size);
+        // Zeroed nodes describe used blocks, so only the real blocks need marking.
+        m_nodes = reinterpret_cast<Node *>(calloc(nodesCount, sizeof(Node)));
+        if(!m_nodes)
+        {
+            printf("COULD NOT ALLOCATE %zu memory\n", nodesCount * sizeof(Node));
+            std::terminate();
+        }
+        m_isOwningNodes = true;
+        markFree(0, m_size);
+    }
+
+    void FreeRunTree::reset(size_t size, void * storage)
+    {
+        release();
+        m_size = size;
+        m_nodes = reinterpret_cast<Node *>(storage);
+        memset(static_cast<void *>(m_nodes), 0, computeNodesCount(m_size) * sizeof(Node));
+        markFree(0, m_size);
+    }
+
+    void FreeRunTree::apply(size_t node, size_t length, uint8_t state)
+    {
+        uint32_t freeLength = FreeState == state ? static_cast<uint32_t>(length) : 0;
+        // One store for the whole node, the bit fields would each read it back first.
+        m_nodes[node] = Node{ freeLength, freeLength, freeLength, freeLength ? 1u : 0u, 1u };
+    }
+
+    void FreeRunTree::push(size_t node, size_t left, size_t middle, size_t right)
+    {
+        if(m_nodes[node].isPending)
+        {
+            uint8_t state = m_nodes[node].longest > 0 ? FreeState : UsedState;
+            apply(node + 1, middle - left, state);
+            apply(getRightChild(node, left, middle), right - middle, state);
+            m_nodes[node].isPending = 0;
+        }
+    }
+
+    void FreeRunTree::pull(size_t node, size_t left, size_t middle, size_t right)
+    {
+        const Node & leftNode = m_nodes[node + 1];
+        const Node & rightNode = m_nodes[getRightChild(node, left, middle)];
+        Node & parent = m_nodes[node];
+        parent.prefix = leftNode.prefix == middle - left ? leftNode.prefix + rightNode.prefix : leftNode.prefix;
+        parent.suffix = rightNode.suffix == right - middle ? rightNode.suffix + leftNode.suffix : rightNode.suffix;
+        parent.longest = std::max({ leftNode.longest, rightNode.longest, leftNode.suffix + rightNode.prefix });
+        parent.runs = leftNode.runs + rightNode.runs - ((leftNode.suffix && rightNode.prefix) ? 1 : 0);
+    }
+
+    void FreeRunTree::assign(size_t node, size_t left, size_t right, size_t from, size_t to, uint8_t state)
+    {
+        if(to <= left || right <= from)
+        {
+            return;
+        }
+        if(from <= left && right <= to)
+        {
+            apply(node, right - left, state);
+            return;
+        }
+        size_t middle = left + (right - left) / 2;
+        push(node, left, middle, right);
+        assign(node + 1, left, middle, from, to, state);
+        assign(getRightChild(node, left, middle), middle, right, from, to, state);
+        pull(node, left, middle, right);
+    }
+
+    size_t FreeRunTree::find(size_t node, size_t left, size_t right, size_t from, size_t to, size_t count, size_t & run)
+    {
+        if(to <= left || right <= from)
+        {
+            return npos;
+        }
+        const Node & current = m_nodes[node];
+        if(from <= left && right <= to)
+        {
+            if(run + current.prefix >= count)
+            {
+                return left - run;
+            }
+            if(current.longest < count)
+            {
+                run = current.prefix == right - left ? run + current.prefix : current.suffix;
+                return npos;
+            }
+        }
+        size_t middle = left + (right - left) / 2;
+        push(node, left, middle, right);
+        size_t ret = find(node + 1, left, middle, from, to, count, run);
+        if(npos == ret)
+        {
+            ret = find(getRightChild(node, left, middle), middle, right, from, to, count, run);
+        }
+        return ret;
+    }
+
+    void FreeRunTree::markUsed(size_t from, size_t to)
+    {
+        assign(0, 0, m_size, from, std::min(to, m_size), UsedState);
+    }
+
+    void FreeRunTree::markFree(size_t from, size_t to)
+    {
+        assign(0, 0, m_size, from, std::min(to, m_size), FreeState);
+    }
+
+    size_t FreeRunTree::findFirstFit(size_t count, size_t from, size_t to)
+    {
+        size_t run = 0;
+        to = std::min(to, m_size);
+        if(!m_nodes || from >= to || count > to - from || count > m_nodes[0].longest)
+        {
+            return npos;
+        }
+        return find(0, 0, m_size, from, to, count, run);
+    }
+
+    bool FreeRunTree::isFree(size_t i) const
+    {
+        size_t node = 0;
+        size_t left = 0;
+        size_t right = m_size;
+        while(!m_nodes[node].isPending && right - left > 1)
+        {
+            size_t middle = left + (right - left) / 2;
+            if(i < middle)
+            {
+                node = node + 1;
+                right = middle;
+            }
+            else
+            {
+                node = getRightChild(node, left, middle);
+                left = middle;
+            }
+        }
+        return m_nodes[node].longest > 0;
+    }
+
+    size_t FreeRunTree::getLargestFreeRun() const
+    {
+        return m_nodes ? m_nodes[0].longest : 0;
+    }
+
+    size_t FreeRunTree::getFreeRunsCount() const
+    {
+        return m_nodes ? m_nodes[0].runs : 0;
+    }
+}
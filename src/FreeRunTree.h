@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace SimpleMemoryPool
+{
+    // Segment tree over the pool blocks that keeps, for every node, the free run
+    // touching each end, the longest free run inside and the number of free runs.
+    // Marking a range is O(log n) thanks to lazy assignment, the longest free run
+    // and the free runs count of the whole pool are read from the root in O(1).
+    // Nodes are laid out depth first, the left child right after its parent and the right
+    // one after the whole left subtree, so n blocks take exactly 2n - 1 nodes of 16 bytes,
+    // 32 bytes per block whatever n is. A pending node spans blocks marked all at once, free
+    // when its longest run is not 0, so one bit next to the runs count is enough. Block counts
+    // stay below 2^32 - 1 for the runs count, at most half of them rounded up, to fit 31 bits.
+    class FreeRunTree
+    {
+        struct Node
+        {
+            uint32_t prefix;
+            uint32_t suffix;
+            uint32_t longest;
+            uint32_t runs : 31;
+            uint32_t isPending : 1;
+        };
+        static_assert(sizeof(Node) == 16, "A node is expected to take 16 bytes");
+
+        Node *  m_nodes;
+        size_t  m_size;
+        bool    m_isOwningNodes;
+
+        static size_t computeNodesCount(size_t size);
+        static size_t getRightChild(size_t node, size_t left, size_t middle) { return node + 2 * (middle - left); }
+        void release();
+
+        void apply(size_t node, size_t length, uint8_t state);
+        void push(size_t node, size_t left, size_t middle, size_t right);
+        void pull(size_t node, size_t left, size_t middle, size_t right);
+        void assign(size_t node, size_t left, size_t right, size_t from, size_t to, uint8_t state);
+        size_t find(size_t node, size_t left, size_t right, size_t from, size_t to, size_t count, size_t & run);
+
+    public:
+        static constexpr size_t npos = static_cast<size_t>(-1);
+        static constexpr size_t MaxBlocksCount = size_t(UINT32_MAX) - 1;
+
+        FreeRunTree();
+        ~FreeRunTree();
+
+        FreeRunTree(const FreeRunTree &) = delete;
+        FreeRunTree & operator=(const FreeRunTree &) = delete;
+
+        // Tracks size blocks, all of them free.
+        void reset(size_t size);
+        // Same with the nodes kept in storage, getStorageSize(size) bytes aligned for a uint32_t
+        // that have to outlive the tree.
+        void reset(size_t size, void * storage);
+        static size_t getStorageSize(size_t size);
+
+        void markUsed(size_t from, size_t to);
+        void markFree(size_t from, size_t to);
+
+        // Leftmost index p in [from, to) such that [p, p + count) is free and ends before to.
+        size_t findFirstFit(size_t count, size_t from, size_t to);
+        // O(log n), stops at the first node whose whole span was marked at once.
+        bool isFree(size_t i) const;
+
+        size_t getLargestFreeRun() const;
+        size_t getFreeRunsCount() const;
+    };
+}
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstddef>
+
 namespace SimpleMemoryPool
 {
     struct MemoryBlock
@@ -18,7 +20,7 @@ namespace SimpleMemoryPool
         size_t count;
 
         ArrayBlock() : ptr(nullptr), count(0) {}
-        ArrayBlock(T * _ptr, size_t _size) : ptr(_ptr), size(_size) {}
+        ArrayBlock(T * _ptr, size_t _size) : ptr(_ptr), count(_size) {}
 
         T & operator [] (size_t index)
         {
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// Debug hardening of the pool: red-zone canaries after every allocation, freed
+// blocks filled with a poison pattern, ASan poisoning and leak reports on destruction.
+// Build with -DSMP_HARDENING_ENABLED=1 to turn it on, otherwise none of it is compiled.
+#ifndef SMP_HARDENING_ENABLED
+#define SMP_HARDENING_ENABLED 0
+#endif
+
+#if SMP_HARDENING_ENABLED
+
+#if defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define SMP_HAS_ASAN 1
+#endif
+#endif
+#if defined(__SANITIZE_ADDRESS__)
+#define SMP_HAS_ASAN 1
+#endif
+
+#ifdef SMP_HAS_ASAN
+#include <sanitizer/asan_interface.h>
+#define SMP_POISON_MEMORY(ptr, size) ASAN_POISON_MEMORY_REGION((ptr), (size))
+#define SMP_UNPOISON_MEMORY(ptr, size) ASAN_UNPOISON_MEMORY_REGION((ptr), (size))
+#else
+#define SMP_POISON_MEMORY(ptr, size) ((void)(ptr), (void)(size))
+#define SMP_UNPOISON_MEMORY(ptr, size) ((void)(ptr), (void)(size))
+#endif
+
+namespace SimpleMemoryPool
+{
+    namespace Hardening
+    {
+        // Every allocation keeps at least this many canary bytes before the next run.
+        constexpr size_t RedZoneSize = 16;
+        constexpr unsigned char CanaryPattern = 0xCA;
+        constexpr unsigned char FreedPattern = 0xDD;
+
+        inline bool hasPattern(const unsigned char * ptr, size_t size, unsigned char pattern)
+        {
+            for(size_t i = 0; i < size; ++i)
+            {
+                if(ptr[i] != pattern)
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        [[noreturn]] inline void reportCorruption(const char * what, long long id, const void * ptr)
+        {
+            fprintf(stderr, "SimpleMemoryPool : %s, allocation id %lld at %p\n", what, id, ptr);
+            abort();
+        }
+    }
+}
+
+#endif
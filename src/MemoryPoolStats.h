@@ -0,0 +1,298 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(SMP_STATS_USE_RDTSC) && (defined(__x86_64__) || defined(_M_X64))
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+// Statistics are compiled in by default, build with -DSMP_STATS_ENABLED=0 to remove them.
+#ifndef SMP_STATS_ENABLED
+#define SMP_STATS_ENABLED 1
+#endif
+
+namespace SimpleMemoryPool
+{
+    // Plain snapshot of the pool statistics, safe to take from another thread.
+    // Histogram bucket 0 counts zero values, bucket i counts values in [2^(i-1), 2^i).
+    // Latencies are in nanoseconds, or in TSC ticks when built with SMP_STATS_USE_RDTSC.
+    struct MemoryPoolStats
+    {
+        static constexpr size_t HistogramBucketsCount = 32;
+
+        size_t totalSize = 0;
+        size_t blockSize = 0;
+        size_t blocksCount = 0;
+        size_t usedSize = 0;
+        size_t peakUsedSize = 0;
+        size_t usedBlocksCount = 0;
+        // Bytes taken from the system, and the part of them below the high water mark
+        // that trim() has not given back.
+        size_t reservedSize = 0;
+        size_t residentSize = 0;
+
+        size_t allocationsCount = 0;
+        size_t allocationFailuresCount = 0;
+        // Allocation and resize failures caused by the quota, already counted with the failures.
+        size_t quotaFailuresCount = 0;
+        size_t freesCount = 0;
+        size_t freeFailuresCount = 0;
+        size_t resizesCount = 0;
+        size_t resizeFailuresCount = 0;
+        size_t trimsCount = 0;
+        size_t releasedSize = 0;
+
+        size_t requestedSizeHistogram[HistogramBucketsCount] = {};
+        size_t blocksCountHistogram[HistogramBucketsCount] = {};
+
+        size_t allocateLatencySamplesCount = 0;
+        uint64_t allocateLatencyTotal = 0;
+        uint64_t allocateLatencyMax = 0;
+        size_t freeLatencySamplesCount = 0;
+        uint64_t freeLatencyTotal = 0;
+        uint64_t freeLatencyMax = 0;
+    };
+
+    // Free space layout of the pool. The fragmentation index is 1 - largest free run / free blocks,
+    // 0 when all free blocks are contiguous. Bucket i of the histogram counts free runs of [2^i, 2^(i+1)) blocks.
+    struct MemoryFragmentationStats
+    {
+        static constexpr size_t HistogramBucketsCount = 32;
+
+        size_t freeBlocksCount = 0;
+        size_t largestFreeRunBlocksCount = 0;
+        size_t freeRunsCount = 0;
+        double fragmentationIndex = 0.0;
+        size_t freeRunsHistogram[HistogramBucketsCount] = {};
+    };
+
+    // One distribution range of a pool: the blocks it spans now, how many of them are used, and
+    // the requests of its size class. A miss is a request that did not fit in the range as it was,
+    // a spill one that was served outside of it, a growth a boundary moved to make room.
+    struct MemoryRangeStats
+    {
+        size_t firstBlock = 0;
+        size_t blocksCount = 0;
+        size_t usedBlocksCount = 0;
+        size_t allocationsCount = 0;
+        size_t missesCount = 0;
+        size_t spillsCount = 0;
+        size_t growthsCount = 0;
+    };
+
+#if SMP_STATS_ENABLED
+    // Written only by the thread that owns the pool, so every update is a relaxed
+    // load and store instead of a locked read-modify-write.
+    class MemoryPoolStatsCollector
+    {
+        using Counter = std::atomic<uint64_t>;
+
+        Counter     m_usedSize{0};
+        Counter     m_peakUsedSize{0};
+        Counter     m_allocationsCount{0};
+        Counter     m_allocationFailuresCount{0};
+        Counter     m_quotaFailuresCount{0};
+        Counter     m_freesCount{0};
+        Counter     m_freeFailuresCount{0};
+        Counter     m_resizesCount{0};
+        Counter     m_resizeFailuresCount{0};
+        Counter     m_trimsCount{0};
+        Counter     m_releasedSize{0};
+        Counter     m_requestedSizeHistogram[MemoryPoolStats::HistogramBucketsCount] = {};
+        Counter     m_blocksCountHistogram[MemoryPoolStats::HistogramBucketsCount] = {};
+        Counter     m_allocateLatencySamplesCount{0};
+        Counter     m_allocateLatencyTotal{0};
+        Counter     m_allocateLatencyMax{0};
+        Counter     m_freeLatencySamplesCount{0};
+        Counter     m_freeLatencyTotal{0};
+        Counter     m_freeLatencyMax{0};
+        size_t      m_samplingRate = 0;
+        size_t      m_samplingCounter = 0;
+
+        static void increment(Counter & counter, uint64_t value = 1)
+        {
+            counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+        }
+
+        static size_t bucketIndex(size_t value)
+        {
+            size_t index = 0;
+            while(value && index < MemoryPoolStats::HistogramBucketsCount - 1)
+            {
+                value >>= 1;
+                ++index;
+            }
+            return index;
+        }
+
+        static uint64_t now()
+        {
+#if defined(SMP_STATS_USE_RDTSC) && (defined(__x86_64__) || defined(_M_X64))
+            return __rdtsc();
+#else
+            return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+        }
+
+        static void recordLatency(uint64_t sampleStart, Counter & samples, Counter & total, Counter & max)
+        {
+            if(sampleStart)
+            {
+                uint64_t latency = now() - sampleStart;
+                increment(samples);
+                increment(total, latency);
+                if(latency > max.load(std::memory_order_relaxed))
+                {
+                    max.store(latency, std::memory_order_relaxed);
+                }
+            }
+        }
+
+    public:
+        // Samples one call out of every samplingRate calls, 0 disables latency sampling.
+        void setLatencySamplingRate(size_t samplingRate)
+        {
+            m_samplingRate = samplingRate;
+            m_samplingCounter = 0;
+        }
+
+        uint64_t beginSample()
+        {
+            uint64_t ret = 0;
+            if(m_samplingRate && ++m_samplingCounter >= m_samplingRate)
+            {
+                m_samplingCounter = 0;
+                ret = now();
+            }
+            return ret;
+        }
+
+        void recordAllocation(size_t requestedSize, size_t blocksCount, bool isSuccessful, size_t usedSize, uint64_t sampleStart)
+        {
+            increment(m_requestedSizeHistogram[bucketIndex(requestedSize)]);
+            increment(m_blocksCountHistogram[bucketIndex(blocksCount)]);
+            if(isSuccessful)
+            {
+                increment(m_allocationsCount);
+                m_usedSize.store(usedSize, std::memory_order_relaxed);
+                if(usedSize > m_peakUsedSize.load(std::memory_order_relaxed))
+                {
+                    m_peakUsedSize.store(usedSize, std::memory_order_relaxed);
+                }
+            }
+            else
+            {
+                increment(m_allocationFailuresCount);
+            }
+            recordLatency(sampleStart, m_allocateLatencySamplesCount, m_allocateLatencyTotal, m_allocateLatencyMax);
+        }
+
+        void recordFree(bool isSuccessful, size_t usedSize, uint64_t sampleStart)
+        {
+            if(isSuccessful)
+            {
+                increment(m_freesCount);
+                m_usedSize.store(usedSize, std::memory_order_relaxed);
+            }
+            else
+            {
+                increment(m_freeFailuresCount);
+            }
+            recordLatency(sampleStart, m_freeLatencySamplesCount, m_freeLatencyTotal, m_freeLatencyMax);
+        }
+
+        void recordResize(bool isSuccessful, size_t usedSize)
+        {
+            if(isSuccessful)
+            {
+                increment(m_resizesCount);
+                m_usedSize.store(usedSize, std::memory_order_relaxed);
+                if(usedSize > m_peakUsedSize.load(std::memory_order_relaxed))
+                {
+                    m_peakUsedSize.store(usedSize, std::memory_order_relaxed);
+                }
+            }
+            else
+            {
+                increment(m_resizeFailuresCount);
+            }
+        }
+
+        void recordQuotaFailure()
+        {
+            increment(m_quotaFailuresCount);
+        }
+
+        void recordTrim(size_t releasedSize)
+        {
+            increment(m_trimsCount);
+            increment(m_releasedSize, releasedSize);
+        }
+
+        void reset()
+        {
+            m_peakUsedSize.store(m_usedSize.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            for(Counter * counter : { &m_allocationsCount, &m_allocationFailuresCount, &m_quotaFailuresCount, &m_freesCount, &m_freeFailuresCount,
+                                      &m_resizesCount, &m_resizeFailuresCount, &m_trimsCount, &m_releasedSize,
+                                      &m_allocateLatencySamplesCount, &m_allocateLatencyTotal, &m_allocateLatencyMax,
+                                      &m_freeLatencySamplesCount, &m_freeLatencyTotal, &m_freeLatencyMax })
+            {
+                counter->store(0, std::memory_order_relaxed);
+            }
+            for(size_t i = 0; i < MemoryPoolStats::HistogramBucketsCount; ++i)
+            {
+                m_requestedSizeHistogram[i].store(0, std::memory_order_relaxed);
+                m_blocksCountHistogram[i].store(0, std::memory_order_relaxed);
+            }
+        }
+
+        void fill(MemoryPoolStats & stats) const
+        {
+            stats.usedSize = m_usedSize.load(std::memory_order_relaxed);
+            stats.peakUsedSize = m_peakUsedSize.load(std::memory_order_relaxed);
+            stats.allocationsCount = m_allocationsCount.load(std::memory_order_relaxed);
+            stats.allocationFailuresCount = m_allocationFailuresCount.load(std::memory_order_relaxed);
+            stats.quotaFailuresCount = m_quotaFailuresCount.load(std::memory_order_relaxed);
+            stats.freesCount = m_freesCount.load(std::memory_order_relaxed);
+            stats.freeFailuresCount = m_freeFailuresCount.load(std::memory_order_relaxed);
+            stats.resizesCount = m_resizesCount.load(std::memory_order_relaxed);
+            stats.resizeFailuresCount = m_resizeFailuresCount.load(std::memory_order_relaxed);
+            stats.trimsCount = m_trimsCount.load(std::memory_order_relaxed);
+            stats.releasedSize = m_releasedSize.load(std::memory_order_relaxed);
+            for(size_t i = 0; i < MemoryPoolStats::HistogramBucketsCount; ++i)
+            {
+                stats.requestedSizeHistogram[i] = m_requestedSizeHistogram[i].load(std::memory_order_relaxed);
+                stats.blocksCountHistogram[i] = m_blocksCountHistogram[i].load(std::memory_order_relaxed);
+            }
+            stats.allocateLatencySamplesCount = m_allocateLatencySamplesCount.load(std::memory_order_relaxed);
+            stats.allocateLatencyTotal = m_allocateLatencyTotal.load(std::memory_order_relaxed);
+            stats.allocateLatencyMax = m_allocateLatencyMax.load(std::memory_order_relaxed);
+            stats.freeLatencySamplesCount = m_freeLatencySamplesCount.load(std::memory_order_relaxed);
+            stats.freeLatencyTotal = m_freeLatencyTotal.load(std::memory_order_relaxed);
+            stats.freeLatencyMax = m_freeLatencyMax.load(std::memory_order_relaxed);
+        }
+    };
+#else
+    class MemoryPoolStatsCollector
+    {
+    public:
+        void setLatencySamplingRate(size_t) {}
+        uint64_t beginSample() { return 0; }
+        void recordAllocation(size_t, size_t, bool, size_t, uint64_t) {}
+        void recordFree(bool, size_t, uint64_t) {}
+        void recordResize(bool, size_t) {}
+        void recordQuotaFailure() {}
+        void recordTrim(size_t) {}
+        void reset() {}
+        void fill(MemoryPoolStats &) const {}
+    };
+#endif
+}
@@ -0,0 +1,135 @@
+#include "MemoryZeroing.h"
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <unistd.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SMP_HAS_SSE2 1
+#endif
+
+namespace SimpleMemoryPool
+{
+    namespace
+    {
+        const size_t DefaultPageSize = 4096;
+
+        unsigned char * alignUp(unsigned char * ptr, size_t alignment)
+        {
+            uintptr_t value = reinterpret_cast<uintptr_t>(ptr);
+            return reinterpret_cast<unsigned char *>((value + alignment - 1) & ~(uintptr_t)(alignment - 1));
+        }
+
+        unsigned char * alignDown(unsigned char * ptr, size_t alignment)
+        {
+            uintptr_t value = reinterpret_cast<uintptr_t>(ptr);
+            return reinterpret_cast<unsigned char *>(value & ~(uintptr_t)(alignment - 1));
+        }
+
+        void zeroMemoryStreaming(unsigned char * ptr, size_t size)
+        {
+#if SMP_HAS_SSE2
+            unsigned char * end = ptr + size;
+            unsigned char * alignedBegin = alignUp(ptr, sizeof(__m128i));
+            unsigned char * alignedEnd = alignDown(end, sizeof(__m128i));
+            if(alignedBegin < alignedEnd)
+            {
+                const __m128i zero = _mm_setzero_si128();
+                memset(ptr, 0, alignedBegin - ptr);
+                for(unsigned char * current = alignedBegin; current < alignedEnd; current += sizeof(__m128i))
+                {
+                    _mm_stream_si128(reinterpret_cast<__m128i *>(current), zero);
+                }
+                _mm_sfence();
+                memset(alignedEnd, 0, end - alignedEnd);
+            }
+            else
+            {
+                memset(ptr, 0, size);
+            }
+#else
+            memset(ptr, 0, size);
+#endif
+        }
+    }
+
+    size_t getSystemPageSize()
+    {
+        static const size_t pageSize = []() {
+            size_t ret = DefaultPageSize;
+#if defined(__linux__)
+            long value = sysconf(_SC_PAGESIZE);
+            if(value > 0)
+            {
+                ret = static_cast<size_t>(value);
+            }
+#elif defined(_WIN32)
+            SYSTEM_INFO info;
+            GetSystemInfo(&info);
+            ret = info.dwPageSize;
+#endif
+            return ret;
+        }();
+        return pageSize;
+    }
+
+    bool releaseMemoryPages(unsigned char * ptr, size_t size, MemoryTrimMode trimMode)
+    {
+        bool ret = false;
+#if defined(__linux__)
+#ifdef MADV_FREE
+        if(MemoryTrimMode::Lazy == trimMode)
+        {
+            ret = 0 == madvise(ptr, size, MADV_FREE);
+        }
+#endif
+        if(!ret)
+        {
+            ret = 0 == madvise(ptr, size, MADV_DONTNEED);
+        }
+#else
+        (void)ptr;
+        (void)size;
+        (void)trimMode;
+#endif
+        return ret;
+    }
+
+    size_t zeroMemoryInBulk(unsigned char * ptr, size_t size)
+    {
+        size_t ret = 0;
+        size_t pageSize = getSystemPageSize();
+        bool isCleared = false;
+#if defined(__linux__)
+        unsigned char * end = ptr + size;
+        unsigned char * pagesBegin = alignUp(ptr, pageSize);
+        unsigned char * pagesEnd = alignDown(end, pageSize);
+        if(size >= pageSize && pagesBegin < pagesEnd && 0 == madvise(pagesBegin, pagesEnd - pagesBegin, MADV_DONTNEED))
+        {
+            memset(ptr, 0, pagesBegin - ptr);
+            memset(pagesEnd, 0, end - pagesEnd);
+            ret = pagesEnd - pagesBegin;
+            isCleared = true;
+        }
+#endif
+        if(!isCleared)
+        {
+            if(size < pageSize)
+            {
+                memset(ptr, 0, size);
+            }
+            else
+            {
+                zeroMemoryStreaming(ptr, size);
+            }
+        }
+        return ret;
+    }
+}
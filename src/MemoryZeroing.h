@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+
+namespace SimpleMemoryPool
+{
+    // When the pool clears the memory it hands out.
+    //  Never      : nothing is cleared, allocations come back with whatever the last owner left.
+    //  OnFree     : every freed run is cleared, so every allocation starts zeroed (default).
+    //  OnAllocate : frees only mark blocks dirty, allocateZeroed clears the dirty ones,
+    //               allocateMemory gives no guarantee.
+    //  OnFreeBulk : like OnFree, but runs of a page or more are released to the OS with
+    //               MADV_DONTNEED (or cleared with non-temporal stores) instead of memset,
+    //               so freeing big runs does not pull them through the cache.
+    enum class MemoryZeroingPolicy
+    {
+        Never,
+        OnFree,
+        OnAllocate,
+        OnFreeBulk
+    };
+
+    // How SimpleFixedMemoryPool::trim gives free pages back to the OS.
+    //  Release : MADV_DONTNEED, the pages leave the resident set at once and read back as zeros.
+    //  Lazy    : MADV_FREE, the kernel takes them only under memory pressure, until then they
+    //            keep their content. Falls back to Release on kernels without it.
+    enum class MemoryTrimMode
+    {
+        Release,
+        Lazy
+    };
+
+    size_t getSystemPageSize();
+
+    // Gives whole pages back to the OS, ptr and size have to be page aligned.
+    // Returns false when the platform has no way to do it.
+    bool releaseMemoryPages(unsigned char * ptr, size_t size, MemoryTrimMode trimMode);
+
+    // Zeroes [ptr, ptr + size) without going through the cache when it is worth it:
+    // whole pages are dropped with MADV_DONTNEED on Linux and read back as zeros,
+    // otherwise streamed with SSE2 non-temporal stores, small sizes fall back to memset.
+    // Returns the size of the dropped pages, they start at the first page boundary at or after ptr.
+    size_t zeroMemoryInBulk(unsigned char * ptr, size_t size);
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+
+#include "SimpleFixedMemoryPool.h"
+
+namespace SimpleMemoryPool
+{
+    // Standard allocator that takes its memory from a SimpleFixedMemoryPool.
+    // Every allocate() call is one pool allocation of n * sizeof(T) bytes.
+    template<typename T>
+    class PoolAllocator
+    {
+        SimpleFixedMemoryPool * m_memoryPool;
+
+        template<typename U>
+        friend class PoolAllocator;
+
+    public:
+        using value_type = T;
+
+        explicit PoolAllocator(SimpleFixedMemoryPool * memoryPool) noexcept : m_memoryPool(memoryPool) {}
+
+        template<typename U>
+        PoolAllocator(const PoolAllocator<U> & that) noexcept : m_memoryPool(that.m_memoryPool) {}
+
+        T * allocate(size_t count)
+        {
+            MemoryBlock mem = m_memoryPool->allocateMemory(count * sizeof(T));
+            if(!mem.ptr)
+            {
+                throw std::bad_alloc();
+            }
+            return reinterpret_cast<T *>(mem.ptr);
+        }
+
+        void deallocate(T * ptr, size_t count) noexcept
+        {
+            MemoryBlock memoryBlock(reinterpret_cast<unsigned char *>(ptr), count * sizeof(T));
+            m_memoryPool->freeMemory(&memoryBlock);
+        }
+
+        SimpleFixedMemoryPool * getMemoryPool() const noexcept
+        {
+            return m_memoryPool;
+        }
+
+        template<typename U>
+        bool operator==(const PoolAllocator<U> & that) const noexcept
+        {
+            return m_memoryPool == that.m_memoryPool;
+        }
+
+        template<typename U>
+        bool operator!=(const PoolAllocator<U> & that) const noexcept
+        {
+            return m_memoryPool != that.m_memoryPool;
+        }
+    };
+}
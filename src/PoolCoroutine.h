@@ -0,0 +1,444 @@
+#pragma once
+
+// Coroutine support needs C++20, configure with -DSMP_CXX20=ON. Under C++17 this header is empty.
+#if defined(__cpp_impl_coroutine)
+
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <new>
+#include <utility>
+
+#include "MemoryBlock.h"
+#include "SimpleFixedMemoryPool.h"
+
+namespace SimpleMemoryPool
+{
+    // Base for a promise type, it takes the coroutine frames from a pool. A coroutine whose
+    // parameters start with (std::allocator_arg_t, Pool *) uses that pool, member coroutines
+    // included, the others use the thread default pool. Without a pool, or when the pool is
+    // full, the frame comes from the global operator new.
+    // Pool is any pool with allocateMemory(size) and freeMemory(MemoryBlock *), like
+    // SimpleFixedMemoryPool, BasicFixedPool or a PoolFrameCache in front of one of them.
+    template<class Pool = SimpleFixedMemoryPool>
+    class PoolPromise
+    {
+        // In front of the frame, it keeps the pool the frame has to go back to.
+        struct alignas(__STDCPP_DEFAULT_NEW_ALIGNMENT__) FrameHeader
+        {
+            Pool * memoryPool;
+        };
+
+        static Pool *& threadPool()
+        {
+            thread_local Pool * memoryPool = nullptr;
+            return memoryPool;
+        }
+
+        static void * allocateFrame(size_t size, Pool * memoryPool);
+
+    public :
+        // Pool used by the coroutines started from this thread without an explicit one,
+        // returns the previous one. nullptr goes back to the global operator new.
+        static Pool * setThreadPool(Pool * memoryPool);
+        static Pool * getThreadPool() { return threadPool(); }
+
+        static void * operator new(size_t size) { return allocateFrame(size, threadPool()); }
+        template<class ... Args>
+        static void * operator new(size_t size, std::allocator_arg_t, Pool * memoryPool, Args && ...)
+        {
+            return allocateFrame(size, memoryPool);
+        }
+        template<class This, class ... Args>
+        static void * operator new(size_t size, This &&, std::allocator_arg_t, Pool * memoryPool, Args && ...)
+        {
+            return allocateFrame(size, memoryPool);
+        }
+        static void operator delete(void * ptr, size_t size);
+    };
+
+    template<class Pool>
+    Pool * PoolPromise<Pool>::setThreadPool(Pool * memoryPool)
+    {
+        Pool * ret = threadPool();
+        threadPool() = memoryPool;
+        return ret;
+    }
+
+    template<class Pool>
+    void * PoolPromise<Pool>::allocateFrame(size_t size, Pool * memoryPool)
+    {
+        MemoryBlock mem = memoryPool ? memoryPool->allocateMemory(sizeof(FrameHeader) + size) : MemoryBlock();
+        if(!mem.ptr)
+        {
+            memoryPool = nullptr;
+            mem.ptr = static_cast<unsigned char *>(::operator new(sizeof(FrameHeader) + size));
+        }
+        new (mem.ptr) FrameHeader{ memoryPool };
+        return mem.ptr + sizeof(FrameHeader);
+    }
+
+    template<class Pool>
+    void PoolPromise<Pool>::operator delete(void * ptr, size_t size)
+    {
+        auto header = reinterpret_cast<FrameHeader *>(static_cast<unsigned char *>(ptr) - sizeof(FrameHeader));
+        if(header->memoryPool)
+        {
+            MemoryBlock memoryBlock(reinterpret_cast<unsigned char *>(header), sizeof(FrameHeader) + size);
+            header->memoryPool->freeMemory(&memoryBlock);
+        }
+        else
+        {
+            ::operator delete(header, sizeof(FrameHeader) + size);
+        }
+    }
+
+    // Size classed pool for coroutine frames: the frames of a coroutine all have the same size,
+    // so freed frames are kept in a list per size class and handed out again without going
+    // through the pool. Bigger frames go straight to the pool. Like the pool it is not thread
+    // safe, frames must be freed on the thread that allocates them.
+    template<class Pool = SimpleFixedMemoryPool, size_t SizeClassesCount = 64, size_t Granularity = 16>
+    class PoolFrameCache
+    {
+        struct FreeFrame
+        {
+            FreeFrame * next;
+        };
+
+        Pool *      m_memoryPool;
+        FreeFrame * m_freeFrames[SizeClassesCount] = {};
+        size_t      m_cachedCount;
+
+        static size_t findSizeClass(size_t size) { return size > 0 ? (size - 1) / Granularity : 0; }
+
+    public :
+        explicit PoolFrameCache(Pool * memoryPool) : m_memoryPool(memoryPool), m_cachedCount(0) {}
+        // Gives the cached frames back, the frames still in use have to be freed before.
+        ~PoolFrameCache() { release(); }
+
+        PoolFrameCache(const PoolFrameCache &) = delete;
+        PoolFrameCache & operator=(const PoolFrameCache &) = delete;
+
+        MemoryBlock allocateMemory(size_t size);
+        // memoryBlock->size has to be the size asked for at allocation.
+        bool freeMemory(MemoryBlock * memoryBlock);
+        // Gives every cached frame back to the pool and returns how many.
+        size_t release();
+
+        size_t getCachedCount() const { return m_cachedCount; }
+        Pool * getMemoryPool() const { return m_memoryPool; }
+    };
+
+    template<class Pool, size_t SizeClassesCount, size_t Granularity>
+    MemoryBlock PoolFrameCache<Pool, SizeClassesCount, Granularity>::allocateMemory(size_t size)
+    {
+        MemoryBlock ret;
+        size_t sizeClass = findSizeClass(size);
+        if(sizeClass < SizeClassesCount && m_freeFrames[sizeClass])
+        {
+            FreeFrame * frame = m_freeFrames[sizeClass];
+            m_freeFrames[sizeClass] = frame->next;
+            --m_cachedCount;
+            ret = MemoryBlock(reinterpret_cast<unsigned char *>(frame), size);
+        }
+        else if(sizeClass < SizeClassesCount)
+        {
+            ret = m_memoryPool->allocateMemory((sizeClass + 1) * Granularity);
+        }
+        else
+        {
+            ret = m_memoryPool->allocateMemory(size);
+        }
+        return ret;
+    }
+
+    template<class Pool, size_t SizeClassesCount, size_t Granularity>
+    bool PoolFrameCache<Pool, SizeClassesCount, Granularity>::freeMemory(MemoryBlock * memoryBlock)
+    {
+        bool ret = false;
+        if(memoryBlock && memoryBlock->ptr)
+        {
+            size_t sizeClass = findSizeClass(memoryBlock->size);
+            if(sizeClass < SizeClassesCount)
+            {
+                FreeFrame * frame = reinterpret_cast<FreeFrame *>(memoryBlock->ptr);
+                frame->next = m_freeFrames[sizeClass];
+                m_freeFrames[sizeClass] = frame;
+                ++m_cachedCount;
+                memoryBlock->ptr = nullptr;
+                memoryBlock->size = 0;
+                ret = true;
+            }
+            else
+            {
+                ret = m_memoryPool->freeMemory(memoryBlock);
+            }
+        }
+        return ret;
+    }
+
+    template<class Pool, size_t SizeClassesCount, size_t Granularity>
+    size_t PoolFrameCache<Pool, SizeClassesCount, Granularity>::release()
+    {
+        size_t ret = 0;
+        for(size_t i = 0; i < SizeClassesCount; ++i)
+        {
+            while(m_freeFrames[i])
+            {
+                FreeFrame * frame = m_freeFrames[i];
+                m_freeFrames[i] = frame->next;
+                MemoryBlock memoryBlock(reinterpret_cast<unsigned char *>(frame), (i + 1) * Granularity);
+                m_memoryPool->freeMemory(&memoryBlock);
+                ++ret;
+            }
+        }
+        m_cachedCount = 0;
+        return ret;
+    }
+
+    namespace Detail
+    {
+        // Keeps what a task returns, the void specialization only keeps its exception.
+        template<typename T>
+        class TaskResult
+        {
+            alignas(T) unsigned char    m_value[sizeof(T)];
+            bool                        m_hasValue = false;
+
+        protected :
+            std::exception_ptr          m_exception;
+
+        public :
+            TaskResult() = default;
+            TaskResult(const TaskResult &) = delete;
+            TaskResult & operator=(const TaskResult &) = delete;
+            ~TaskResult()
+            {
+                if(m_hasValue)
+                {
+                    reinterpret_cast<T *>(m_value)->~T();
+                }
+            }
+
+            template<typename U>
+            void return_value(U && value)
+            {
+                new (m_value) T(std::forward<U>(value));
+                m_hasValue = true;
+            }
+
+            void unhandled_exception() { m_exception = std::current_exception(); }
+
+            T takeResult()
+            {
+                if(m_exception)
+                {
+                    std::rethrow_exception(m_exception);
+                }
+                return std::move(*reinterpret_cast<T *>(m_value));
+            }
+        };
+
+        template<>
+        class TaskResult<void>
+        {
+        protected :
+            std::exception_ptr m_exception;
+
+        public :
+            void return_void() {}
+            void unhandled_exception() { m_exception = std::current_exception(); }
+
+            void takeResult()
+            {
+                if(m_exception)
+                {
+                    std::rethrow_exception(m_exception);
+                }
+            }
+        };
+    }
+
+    // Lazy task: it starts when awaited, or when resume() is called on a top level task, and
+    // resumes its awaiter when it ends. Frames are allocated as in PoolPromise.
+    template<typename T, class Pool = SimpleFixedMemoryPool>
+    class PoolTask
+    {
+    public :
+        class promise_type : public PoolPromise<Pool>, public Detail::TaskResult<T>
+        {
+            std::coroutine_handle<> m_continuation;
+
+            friend class PoolTask;
+
+            struct FinalAwaiter
+            {
+                bool await_ready() const noexcept { return false; }
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept
+                {
+                    std::coroutine_handle<> continuation = handle.promise().m_continuation;
+                    return continuation ? continuation : std::noop_coroutine();
+                }
+                void await_resume() const noexcept {}
+            };
+
+        public :
+            PoolTask get_return_object() { return PoolTask(std::coroutine_handle<promise_type>::from_promise(*this)); }
+            std::suspend_always initial_suspend() const noexcept { return {}; }
+            FinalAwaiter final_suspend() const noexcept { return {}; }
+        };
+
+        struct Awaiter
+        {
+            std::coroutine_handle<promise_type> m_handle;
+
+            bool await_ready() const noexcept { return !m_handle || m_handle.done(); }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+            {
+                m_handle.promise().m_continuation = awaiting;
+                return m_handle;
+            }
+            T await_resume() { return m_handle.promise().takeResult(); }
+        };
+
+    private :
+        std::coroutine_handle<promise_type> m_handle;
+
+        explicit PoolTask(std::coroutine_handle<promise_type> handle) : m_handle(handle) {}
+
+    public :
+        PoolTask(PoolTask && that) noexcept : m_handle(std::exchange(that.m_handle, nullptr)) {}
+        PoolTask & operator=(PoolTask && that) noexcept
+        {
+            if(this != &that)
+            {
+                if(m_handle)
+                {
+                    m_handle.destroy();
+                }
+                m_handle = std::exchange(that.m_handle, nullptr);
+            }
+            return *this;
+        }
+        ~PoolTask()
+        {
+            if(m_handle)
+            {
+                m_handle.destroy();
+            }
+        }
+
+        Awaiter operator co_await() && noexcept { return Awaiter{ m_handle }; }
+
+        // Runs the task until it ends or waits on something, returns true once it has ended.
+        bool resume()
+        {
+            if(m_handle && !m_handle.done())
+            {
+                m_handle.resume();
+            }
+            return isDone();
+        }
+        bool isDone() const { return !m_handle || m_handle.done(); }
+        // Only once the task is done, rethrows what escaped it.
+        T getResult() { return m_handle.promise().takeResult(); }
+    };
+
+    // Lazy generator for range for loops, each co_yield hands out one value without copying it.
+    // Exceptions escaping the body are rethrown from begin() or ++.
+    template<typename T, class Pool = SimpleFixedMemoryPool>
+    class PoolGenerator
+    {
+    public :
+        class promise_type : public PoolPromise<Pool>
+        {
+            const T *           m_value = nullptr;
+            std::exception_ptr  m_exception;
+
+            friend class PoolGenerator;
+
+        public :
+            PoolGenerator get_return_object() { return PoolGenerator(std::coroutine_handle<promise_type>::from_promise(*this)); }
+            std::suspend_always initial_suspend() const noexcept { return {}; }
+            std::suspend_always final_suspend() const noexcept { return {}; }
+            std::suspend_always yield_value(const T & value) noexcept
+            {
+                m_value = std::addressof(value);
+                return {};
+            }
+            void return_void() {}
+            void unhandled_exception() { m_exception = std::current_exception(); }
+            void await_transform() = delete;
+        };
+
+        struct Sentinel {};
+
+        class Iterator
+        {
+            std::coroutine_handle<promise_type> m_handle;
+
+        public :
+            explicit Iterator(std::coroutine_handle<promise_type> handle) : m_handle(handle) {}
+
+            const T & operator*() const { return *m_handle.promise().m_value; }
+            const T * operator->() const { return m_handle.promise().m_value; }
+            Iterator & operator++()
+            {
+                advance(m_handle);
+                return *this;
+            }
+            bool operator==(Sentinel) const { return !m_handle || m_handle.done(); }
+            bool operator!=(Sentinel sentinel) const { return !(*this == sentinel); }
+        };
+
+    private :
+        std::coroutine_handle<promise_type> m_handle;
+
+        explicit PoolGenerator(std::coroutine_handle<promise_type> handle) : m_handle(handle) {}
+
+        static void advance(std::coroutine_handle<promise_type> handle)
+        {
+            handle.resume();
+            if(handle.promise().m_exception)
+            {
+                std::rethrow_exception(std::exchange(handle.promise().m_exception, nullptr));
+            }
+        }
+
+    public :
+        PoolGenerator(PoolGenerator && that) noexcept : m_handle(std::exchange(that.m_handle, nullptr)) {}
+        PoolGenerator & operator=(PoolGenerator && that) noexcept
+        {
+            if(this != &that)
+            {
+                if(m_handle)
+                {
+                    m_handle.destroy();
+                }
+                m_handle = std::exchange(that.m_handle, nullptr);
+            }
+            return *this;
+        }
+        ~PoolGenerator()
+        {
+            if(m_handle)
+            {
+                m_handle.destroy();
+            }
+        }
+
+        // Starts the generator, call it once.
+        Iterator begin()
+        {
+            if(m_handle)
+            {
+                advance(m_handle);
+            }
+            return Iterator(m_handle);
+        }
+        Sentinel end() const { return {}; }
+    };
+}
+
+#endif
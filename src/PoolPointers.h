@@ -0,0 +1,78 @@
+#pragma once
+
+#include <memory>
+#include <utility>
+
+#include "SimpleFixedMemoryPool.h"
+#include "PoolAllocator.h"
+
+namespace SimpleMemoryPool
+{
+    // Deleter bound at compile time to a pool with static storage duration.
+    // It is stateless, so PoolUniquePtr<T, &pool> is as small as a raw pointer.
+    template<typename T, SimpleFixedMemoryPool * Pool = nullptr>
+    struct PoolDeleter
+    {
+        void operator()(T * ptr) const
+        {
+            Pool->destruct(&ptr);
+        }
+    };
+
+    // Deleter for pools only known at runtime, it carries the pool pointer.
+    template<typename T>
+    struct PoolDeleter<T, nullptr>
+    {
+        SimpleFixedMemoryPool * m_memoryPool = nullptr;
+
+        PoolDeleter() = default;
+        explicit PoolDeleter(SimpleFixedMemoryPool * memoryPool) : m_memoryPool(memoryPool) {}
+
+        void operator()(T * ptr) const
+        {
+            if(m_memoryPool)
+            {
+                m_memoryPool->destruct(&ptr);
+            }
+        }
+    };
+
+    template<typename T, SimpleFixedMemoryPool * Pool = nullptr>
+    using PoolUniquePtr = std::unique_ptr<T, PoolDeleter<T, Pool>>;
+
+    // The refcount lives in the same pool allocation as the object.
+    template<typename T>
+    using PoolSharedPtr = std::shared_ptr<T>;
+
+    template<typename T, class ... Args>
+    PoolUniquePtr<T> makePoolUnique(SimpleFixedMemoryPool * memoryPool, Args && ... args)
+    {
+        T * ptr = memoryPool ? memoryPool->construct<T>(std::forward<Args>(args)...) : nullptr;
+        return PoolUniquePtr<T>(ptr, PoolDeleter<T>(memoryPool));
+    }
+
+    template<SimpleFixedMemoryPool * Pool, typename T, class ... Args>
+    PoolUniquePtr<T, Pool> makePoolUnique(Args && ... args)
+    {
+        return PoolUniquePtr<T, Pool>(Pool->construct<T>(std::forward<Args>(args)...));
+    }
+
+    // Returns an empty pointer when the pool has no room for the object and its refcount.
+    template<typename T, class ... Args>
+    PoolSharedPtr<T> makePoolShared(SimpleFixedMemoryPool * memoryPool, Args && ... args)
+    {
+        PoolSharedPtr<T> ret;
+        if(memoryPool)
+        {
+            try
+            {
+                ret = std::allocate_shared<T>(PoolAllocator<T>(memoryPool), std::forward<Args>(args)...);
+            }
+            catch(const std::bad_alloc &)
+            {
+                ret.reset();
+            }
+        }
+        return ret;
+    }
+}
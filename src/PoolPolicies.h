@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+
+#include "MemoryPoolStats.h"
+#include "MemoryZeroing.h"
+
+namespace SimpleMemoryPool
+{
+    // Policies plugged into BasicFixedPool. Each one is resolved at compile time,
+    // so the unused ones leave no code behind in the allocation path.
+
+    constexpr bool isPowerOfTwo(size_t value)
+    {
+        return value && 0 == (value & (value - 1));
+    }
+
+    constexpr size_t log2Of(size_t value)
+    {
+        return value > 1 ? 1 + log2Of(value >> 1) : 0;
+    }
+
+    // Distribution policies give the [from, to) block range searched for a request.
+    struct NoDistribution
+    {
+        static bool computeSearchRange(size_t, size_t blocksCount, size_t & from, size_t & to)
+        {
+            from = 0;
+            to = blocksCount;
+            return true;
+        }
+    };
+
+    // Splits the pool in RangesCount ranges and starts bigger requests in later ranges,
+    // like MemoryDistributionPolicy::CloseRanges/OpenRanges. A closed range never
+    // spills into the next one, an open one searches up to the end of the pool.
+    template<size_t RangesCount, bool IsClosed>
+    struct RangesDistribution
+    {
+        static_assert(isPowerOfTwo(RangesCount), "RangesCount has to be a power of two");
+        static constexpr size_t RangesShift = log2Of(RangesCount);
+
+        static bool computeSearchRange(size_t requestedBlocksCount, size_t blocksCount, size_t & from, size_t & to)
+        {
+            size_t rangeSize = blocksCount >> RangesShift;
+            size_t rangeStep = rangeSize >> RangesShift;
+            bool ret = requestedBlocksCount > 0 && requestedBlocksCount <= rangeSize && rangeStep > 0;
+            if(ret)
+            {
+                from = rangeSize * ((requestedBlocksCount - 1) / rangeStep);
+                to = IsClosed ? from + rangeSize : blocksCount;
+            }
+            return ret;
+        }
+    };
+
+    template<size_t RangesCount>
+    using CloseRangesDistribution = RangesDistribution<RangesCount, true>;
+
+    template<size_t RangesCount>
+    using OpenRangesDistribution = RangesDistribution<RangesCount, false>;
+
+    // Lock policies follow the standard Lockable interface.
+    struct NoLock
+    {
+        void lock() {}
+        void unlock() {}
+    };
+
+    using MutexLock = std::mutex;
+
+    // Stats policies receive the same hooks as SimpleFixedMemoryPool's collector.
+    struct NoStats
+    {
+        uint64_t beginSample() { return 0; }
+        void recordAllocation(size_t, size_t, bool, size_t, uint64_t) {}
+        void recordFree(bool, size_t, uint64_t) {}
+        void recordResize(bool, size_t) {}
+        void fill(MemoryPoolStats &) const {}
+    };
+
+    using CollectStats = MemoryPoolStatsCollector;
+
+    // Zero policies decide when released memory is cleared.
+    struct ZeroOnFree
+    {
+        static void onAllocate(unsigned char *, size_t) {}
+        static void onFree(unsigned char * ptr, size_t size)
+        {
+            memset(ptr, 0, size);
+        }
+    };
+
+    // Same guarantee as ZeroOnFree, page sized runs are released instead of written,
+    // see MemoryZeroingPolicy::OnFreeBulk.
+    struct ZeroInBulkOnFree
+    {
+        static void onAllocate(unsigned char *, size_t) {}
+        static void onFree(unsigned char * ptr, size_t size)
+        {
+            zeroMemoryInBulk(ptr, size);
+        }
+    };
+
+    // Allocations come back with whatever the previous owner left.
+    struct NoZeroing
+    {
+        static void onAllocate(unsigned char *, size_t) {}
+        static void onFree(unsigned char *, size_t) {}
+    };
+}
@@ -0,0 +1,339 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <utility>
+
+#include "SMPVector.h"
+
+namespace SimpleMemoryPool
+{
+    // Open addressing hash map whose storage all comes from a SimpleFixedMemoryPool. Like
+    // SMPStringTable it keeps two arrays: buckets of { hash, entry index + 1 } probed
+    // linearly, 8 bytes each so a probe sequence stays within a cache line, and a dense
+    // SMPVector of entries that iteration walks in order. Erasing moves the last entry into
+    // the hole and shifts the following buckets back, so there are no tombstones.
+    // Calls that need memory return nullptr or false when the pool is out of it.
+    template<typename K, typename V, class Hash = std::hash<K>, class KeyEqual = std::equal_to<K>>
+    class SMPHashMap
+    {
+    public :
+        struct Entry
+        {
+            K key;
+            V value;
+
+            template<class Key, class ... Args>
+            Entry(Key && _key, Args && ... args) : key(std::forward<Key>(_key)), value(std::forward<Args>(args)...) {}
+        };
+
+    private :
+        struct Bucket
+        {
+            uint32_t hash;
+            // Entry index + 1, 0 for an empty bucket.
+            uint32_t index;
+        };
+
+        static constexpr size_t MinBucketsCount = 16;
+
+        SimpleFixedMemoryPool * m_memoryPool;
+        MemoryBlock             m_bucketsBuffer;
+        size_t                  m_bucketsCount;
+        SMPVector<Entry>        m_entries;
+        Hash                    m_hash;
+        KeyEqual                m_keyEqual;
+
+        Bucket * getBuckets() const { return reinterpret_cast<Bucket *>(m_bucketsBuffer.ptr); }
+        uint32_t computeHash(const K & key) const;
+        size_t findBucket(const K & key, uint32_t hash) const;
+        size_t findBucketOfEntry(size_t index, uint32_t hash) const;
+        bool growBuckets(size_t bucketsCount);
+
+    public :
+        explicit SMPHashMap(SimpleFixedMemoryPool * memoryPool, size_t expectedCount = 0);
+        ~SMPHashMap();
+
+        SMPHashMap(const SMPHashMap &) = delete;
+        SMPHashMap & operator=(const SMPHashMap &) = delete;
+        SMPHashMap(SMPHashMap && that) noexcept;
+        SMPHashMap & operator=(SMPHashMap && that) noexcept;
+
+        // Builds the value from args only when the key is missing, returns the stored value.
+        template<class Key, class ... Args>
+        V * tryEmplace(Key && key, Args && ... args);
+        template<class Key, class Value>
+        V * insertOrAssign(Key && key, Value && value);
+        V * find(const K & key);
+        const V * find(const K & key) const;
+        bool contains(const K & key) const;
+        bool erase(const K & key);
+        void clear();
+
+        // Room for count entries without growing either array.
+        bool reserve(size_t count);
+
+        Entry * begin() { return m_entries.begin(); }
+        Entry * end() { return m_entries.end(); }
+        const Entry * begin() const { return m_entries.begin(); }
+        const Entry * end() const { return m_entries.end(); }
+
+        size_t getSize() const { return m_entries.getSize(); }
+        bool isEmpty() const { return m_entries.isEmpty(); }
+        size_t getBucketsCount() const { return m_bucketsCount; }
+    };
+
+    template<typename K, typename V, class Hash, class KeyEqual>
+    SMPHashMap<K, V, Hash, KeyEqual>::SMPHashMap(SimpleFixedMemoryPool * memoryPool, size_t expectedCount)
+        : m_memoryPool(memoryPool), m_bucketsBuffer(), m_bucketsCount(0), m_entries(memoryPool), m_hash(), m_keyEqual()
+    {
+        if(expectedCount)
+        {
+            reserve(expectedCount);
+        }
+    }
+
+    template<typename K, typename V, class Hash, class KeyEqual>
+    SMPHashMap<K, V, Hash, KeyEqual>::~SMPHashMap()
+    {
+        if(m_memoryPool && m_bucketsBuffer.ptr)
+        {
+            m_memoryPool->freeMemory(&m_bucketsBuffer);
+        }
+    }
+
+    template<typename K, typename V, class Hash, class KeyEqual>
+    SMPHashMap<K, V, Hash, KeyEqual>::SMPHashMap(SMPHashMap && that) noexcept
+        : m_memoryPool(that.m_memoryPool), m_bucketsBuffer(that.m_bucketsBuffer), m_bucketsCount(that.m_bucketsCount),
+        m_entries(std::move(that.m_entries)), m_hash(that.m_hash), m_keyEqual(that.m_keyEqual)
+    {
+        that.m_bucketsBuffer = MemoryBlock();
+        that.m_bucketsCount = 0;
+    }
+
+    template<typename K, typename V, class Hash, class KeyEqual>
+    SMPHashMap<K, V, Hash, KeyEqual> & SMPHashMap<K, V, Hash, KeyEqual>::operator=(SMPHashMap && that) noexcept
+    {
+        if(this != &that)
+        {
+            if(m_memoryPool && m_bucketsBuffer.ptr)
+            {
+                m_memoryPool->freeMemory(&m_bucketsBuffer);
+            }
+            m_memoryPool = that.m_memoryPool;
+            m_bucketsBuffer = that.m_bucketsBuffer;
+            m_bucketsCount = that.m_bucketsCount;
+            m_entries = std::move(that.m_entries);
+            m_hash = that.m_hash;
+            m_keyEqual = that.m_keyEqual;
+            that.m_bucketsBuffer = MemoryBlock();
+            that.m_bucketsCount = 0;
+        }
+        return *this;
+    }
+
+    // Fibonacci mixing, so that identity hashes of small integers spread over the buckets.
+    template<typename K, typename V, class Hash, class KeyEqual>
+    uint32_t SMPHashMap<K, V, Hash, KeyEqual>::computeHash(const K & key) const
+    {
+        uint64_t hash = static_cast<uint64_t>(m_hash(key)) * 0x9E3779B97F4A7C15ULL;
+        return static_cast<uint32_t>(hash >> 32);
+    }
+
+    // Linear probing, stops on the matching bucket or on the first empty one.
+    template<typename K, typename V, class Hash, class KeyEqual>
+    size_t SMPHashMap<K, V, Hash, KeyEqual>::findBucket(const K & key, uint32_t hash) const
+    {
+        const Bucket * buckets = getBuckets();
+        size_t mask = m_bucketsCount - 1;
+        size_t ret = hash & mask;
+        while(buckets[ret].index &&
+              (buckets[ret].hash != hash || !m_keyEqual(m_entries[buckets[ret].index - 1].key, key)))
+        {
+            ret = (ret + 1) & mask;
+        }
+        return ret;
+    }
+
+    template<typename K, typename V, class Hash, class KeyEqual>
+    size_t SMPHashMap<K, V, Hash, KeyEqual>::findBucketOfEntry(size_t index, uint32_t hash) const
+    {
+        const Bucket * buckets = getBuckets();
+        size_t mask = m_bucketsCount - 1;
+        size_t ret = hash & mask;
+        while(buckets[ret].index != index + 1)
+        {
+            ret = (ret + 1) & mask;
+        }
+        return ret;
+    }
+
+    // Rehashes from the cached hashes, the keys themselves are never hashed again.
+    template<typename K, typename V, class Hash, class KeyEqual>
+    bool SMPHashMap<K, V, Hash, KeyEqual>::growBuckets(size_t bucketsCount)
+    {
+        bool ret = false;
+        if(m_memoryPool)
+        {
+            MemoryBlock buffer = m_memoryPool->allocateZeroed(bucketsCount * sizeof(Bucket));
+            if(buffer.ptr)
+            {
+                Bucket * buckets = reinterpret_cast<Bucket *>(buffer.ptr);
+                const Bucket * oldBuckets = getBuckets();
+                size_t mask = bucketsCount - 1;
+                for(size_t i = 0; i < m_bucketsCount; ++i)
+                {
+                    if(oldBuckets[i].index)
+                    {
+                        size_t bucket = oldBuckets[i].hash & mask;
+                        while(buckets[bucket].index)
+                        {
+                            bucket = (bucket + 1) & mask;
+                        }
+                        buckets[bucket] = oldBuckets[i];
+                    }
+                }
+                if(m_bucketsBuffer.ptr)
+                {
+                    m_memoryPool->freeMemory(&m_bucketsBuffer);
+                }
+                m_bucketsBuffer = buffer;
+                m_bucketsCount = bucketsCount;
+                ret = true;
+            }
+        }
+        return ret;
+    }
+
+    template<typename K, typename V, class Hash, class KeyEqual>
+    template<class Key, class ... Args>
+    V * SMPHashMap<K, V, Hash, KeyEqual>::tryEmplace(Key && key, Args && ... args)
+    {
+        V * ret = nullptr;
+        size_t size = m_entries.getSize();
+        // Keeps the load factor under one half.
+        if(size + 1 < UINT32_MAX && (2 * (size + 1) <= m_bucketsCount || growBuckets(std::max(MinBucketsCount, 2 * m_bucketsCount))))
+        {
+            uint32_t hash = computeHash(key);
+            size_t bucket = findBucket(key, hash);
+            Bucket & found = getBuckets()[bucket];
+            if(found.index)
+            {
+                ret = &m_entries[found.index - 1].value;
+            }
+            else
+            {
+                Entry * entry = m_entries.emplaceBack(std::forward<Key>(key), std::forward<Args>(args)...);
+                if(entry)
+                {
+                    found = Bucket{ hash, static_cast<uint32_t>(size + 1) };
+                    ret = &entry->value;
+                }
+            }
+        }
+        return ret;
+    }
+
+    template<typename K, typename V, class Hash, class KeyEqual>
+    template<class Key, class Value>
+    V * SMPHashMap<K, V, Hash, KeyEqual>::insertOrAssign(Key && key, Value && value)
+    {
+        size_t size = m_entries.getSize();
+        V * ret = tryEmplace(std::forward<Key>(key), std::forward<Value>(value));
+        if(ret && size == m_entries.getSize())
+        {
+            *ret = std::forward<Value>(value);
+        }
+        return ret;
+    }
+
+    template<typename K, typename V, class Hash, class KeyEqual>
+    V * SMPHashMap<K, V, Hash, KeyEqual>::find(const K & key)
+    {
+        return const_cast<V *>(static_cast<const SMPHashMap *>(this)->find(key));
+    }
+
+    template<typename K, typename V, class Hash, class KeyEqual>
+    const V * SMPHashMap<K, V, Hash, KeyEqual>::find(const K & key) const
+    {
+        const V * ret = nullptr;
+        if(m_bucketsCount)
+        {
+            const Bucket & found = getBuckets()[findBucket(key, computeHash(key))];
+            if(found.index)
+            {
+                ret = &m_entries[found.index - 1].value;
+            }
+        }
+        return ret;
+    }
+
+    template<typename K, typename V, class Hash, class KeyEqual>
+    bool SMPHashMap<K, V, Hash, KeyEqual>::contains(const K & key) const
+    {
+        return nullptr != find(key);
+    }
+
+    template<typename K, typename V, class Hash, class KeyEqual>
+    bool SMPHashMap<K, V, Hash, KeyEqual>::erase(const K & key)
+    {
+        bool ret = false;
+        if(m_bucketsCount)
+        {
+            Bucket * buckets = getBuckets();
+            size_t mask = m_bucketsCount - 1;
+            size_t bucket = findBucket(key, computeHash(key));
+            if(buckets[bucket].index)
+            {
+                size_t index = buckets[bucket].index - 1;
+                size_t last = m_entries.getSize() - 1;
+                if(index != last)
+                {
+                    // The last entry takes the freed index.
+                    buckets[findBucketOfEntry(last, computeHash(m_entries[last].key))].index = static_cast<uint32_t>(index + 1);
+                }
+                m_entries.swapRemove(index);
+
+                // Backward shift: pulls the following buckets of the probe sequence into the hole.
+                size_t hole = bucket;
+                size_t next = (hole + 1) & mask;
+                while(buckets[next].index)
+                {
+                    size_t home = buckets[next].hash & mask;
+                    if(((next - home) & mask) >= ((next - hole) & mask))
+                    {
+                        buckets[hole] = buckets[next];
+                        hole = next;
+                    }
+                    next = (next + 1) & mask;
+                }
+                buckets[hole] = Bucket{ 0, 0 };
+                ret = true;
+            }
+        }
+        return ret;
+    }
+
+    template<typename K, typename V, class Hash, class KeyEqual>
+    void SMPHashMap<K, V, Hash, KeyEqual>::clear()
+    {
+        m_entries.clear();
+        if(m_bucketsBuffer.ptr)
+        {
+            memset(m_bucketsBuffer.ptr, 0, m_bucketsCount * sizeof(Bucket));
+        }
+    }
+
+    template<typename K, typename V, class Hash, class KeyEqual>
+    bool SMPHashMap<K, V, Hash, KeyEqual>::reserve(size_t count)
+    {
+        size_t bucketsCount = MinBucketsCount;
+        while(bucketsCount < 2 * count)
+        {
+            bucketsCount <<= 1;
+        }
+        bool ret = bucketsCount <= m_bucketsCount || growBuckets(bucketsCount);
+        return m_entries.reserve(count) && ret;
+    }
+}
@@ -1,177 +1,556 @@
 #include "SMPString.h"
 #include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <new>
 
 namespace SimpleMemoryPool
 {
-    SMPString::SMPString(SimpleFixedMemoryPool * memoryPool) : m_buffer(), m_memoryPool(memoryPool)
+    static_assert(sizeof(SMPString) <= 32, "SMPString has to stay within 32 bytes");
+
+    namespace
     {
-        if(m_memoryPool)
+        // The flag has to land in the last byte of the object, which is the most
+        // significant byte of the capacity word on little endian targets.
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        size_t encodeCapacity(size_t capacity)
         {
-            m_buffer = m_memoryPool->allocateMemory(m_defaultBufferSize);
+            return (capacity << 8) | 0x80;
         }
-    }
 
-    SMPString::SMPString(SimpleFixedMemoryPool * memoryPool, const char * str) : m_buffer(), m_memoryPool(memoryPool)
-    {
-        if(m_memoryPool && str)
+        size_t decodeCapacity(size_t capacityWord)
+        {
+            return capacityWord >> 8;
+        }
+#else
+        const size_t HeapFlag = (size_t)0x80 << ((sizeof(size_t) - 1) * 8);
+
+        size_t encodeCapacity(size_t capacity)
+        {
+            return capacity | HeapFlag;
+        }
+
+        size_t decodeCapacity(size_t capacityWord)
+        {
+            return capacityWord & ~HeapFlag;
+        }
+#endif
+
+#if SMP_STRING_SHARED_BUFFERS
+        // The top bit of the count marks a buffer whose chars were handed out by reference.
+        const size_t UnshareableFlag = ~(~(size_t)0 >> 1);
+
+#if SMP_STRING_ATOMIC_REFCOUNT
+        using RefCount = std::atomic<size_t>;
+
+        size_t loadRefCount(const RefCount & refCount)
+        {
+            return refCount.load(std::memory_order_acquire);
+        }
+
+        void addReference(RefCount & refCount)
+        {
+            refCount.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // True when the last reference was dropped.
+        bool dropReference(RefCount & refCount)
+        {
+            return 1 == (refCount.fetch_sub(1, std::memory_order_acq_rel) & ~UnshareableFlag);
+        }
+#else
+        using RefCount = size_t;
+
+        size_t loadRefCount(const RefCount & refCount)
+        {
+            return refCount;
+        }
+
+        void addReference(RefCount & refCount)
+        {
+            ++refCount;
+        }
+
+        bool dropReference(RefCount & refCount)
         {
-            m_stringSize = strlen(str);
-            m_buffer = m_memoryPool->allocateMemory(m_stringSize);
-            std::strcpy(reinterpret_cast<char *>(m_buffer.ptr), str);
+            return 0 == (--refCount & ~UnshareableFlag);
         }
+#endif
+
+        static_assert(sizeof(RefCount) == SMPString::BufferHeaderSize, "The reference count has to fill the buffer header");
+
+        RefCount & getRefCount(unsigned char * run)
+        {
+            return *reinterpret_cast<RefCount *>(run);
+        }
+#endif
+    }
+
+    SMPString::SMPString(SimpleFixedMemoryPool * memoryPool) : m_memoryPool(memoryPool)
+    {
+        setLocalSize(0);
     }
 
-    SMPString::SMPString(SimpleFixedMemoryPool * memoryPool, size_t strSize) : m_buffer(), m_memoryPool(memoryPool)
+    SMPString::SMPString(SimpleFixedMemoryPool * memoryPool, const char * str) : m_memoryPool(memoryPool)
     {
-        if(m_memoryPool)
+        setLocalSize(0);
+        if(str)
         {
-            m_stringSize = strSize;
-            m_buffer = m_memoryPool->allocateMemory(m_stringSize);
-            m_buffer.ptr[0] = '\0';
+            assign(str, strlen(str));
         }
     }
 
+    SMPString::SMPString(SimpleFixedMemoryPool * memoryPool, std::string_view str) : m_memoryPool(memoryPool)
+    {
+        setLocalSize(0);
+        assign(str.data(), str.size());
+    }
+
+    SMPString::SMPString(SimpleFixedMemoryPool * memoryPool, size_t strSize) : m_memoryPool(memoryPool)
+    {
+        setLocalSize(0);
+        prepareCapacity(strSize, false);
+    }
+
     SMPString::~SMPString()
     {
-        if(m_memoryPool)
-        {
-            m_memoryPool->freeMemory(&m_buffer);
-        }
+        releaseBuffer();
     }
 
-    SMPString::SMPString(const SMPString & that) : m_buffer(), m_memoryPool(that.m_memoryPool)
+    SMPString::SMPString(const SMPString & that) : m_memoryPool(that.m_memoryPool)
     {
-        if(m_memoryPool)
+        setLocalSize(0);
+        if(!shareFrom(that))
         {
-            m_stringSize = that.m_stringSize;
-            m_buffer = m_memoryPool->allocateMemory(m_stringSize);
-            std::memcpy(m_buffer.ptr, that.m_buffer.ptr, that.m_buffer.size);
+            assign(that.getBuffer(), that.getStringSize());
         }
     }
 
     SMPString & SMPString::operator=(const SMPString & that)
     {
-        if(that.m_memoryPool && m_buffer.ptr != that.m_buffer.ptr)
+        if(this != &that && !shareFrom(that))
         {
-            if(m_memoryPool)
+            if(m_memoryPool != that.m_memoryPool)
             {
-                m_memoryPool->freeMemory(&m_buffer);
+                releaseBuffer();
+                m_memoryPool = that.m_memoryPool;
             }
-
-            m_memoryPool = that.m_memoryPool;
-            m_stringSize = that.m_stringSize;
-            m_buffer = m_memoryPool->allocateMemory(m_stringSize);
-            std::memcpy(m_buffer.ptr, that.m_buffer.ptr, that.m_buffer.size);
+            assign(that.getBuffer(), that.getStringSize());
         }
         return *this;
     }
 
-    SMPString::SMPString(const SMPString && that) noexcept : m_buffer(that.m_buffer), m_stringSize(that.m_stringSize), m_memoryPool(that.m_memoryPool)
+    SMPString::SMPString(SMPString && that) noexcept : m_memoryPool(that.m_memoryPool)
     {
+        setLocalSize(0);
+        moveFrom(that);
     }
 
-    SMPString & SMPString::operator=(const SMPString && that) noexcept
+    SMPString & SMPString::operator=(SMPString && that) noexcept
     {
-        m_buffer = that.m_buffer;
-        m_stringSize = that.m_stringSize;
-        m_memoryPool = that.m_memoryPool;
+        if(this != &that)
+        {
+            releaseBuffer();
+            m_memoryPool = that.m_memoryPool;
+            moveFrom(that);
+        }
         return *this;
     }
 
     SMPString & SMPString::operator=(const char * str)
     {
-        if(m_memoryPool && str)
+        if(str)
         {
-            if(strlen(str) > m_buffer.size)
-            {
-                m_memoryPool->freeMemory(&m_buffer);
-                m_buffer = m_memoryPool->allocateMemory(strlen(str));
-            }
-            m_stringSize = strlen(str);
-            std::strcpy(reinterpret_cast<char *>(m_buffer.ptr), str);
+            assign(str, strlen(str));
         }
         return * this;
     }
 
+    SMPString & SMPString::operator=(std::string_view str)
+    {
+        assign(str.data(), str.size());
+        return *this;
+    }
+
     char & SMPString::operator[](size_t index)
     {
-        return reinterpret_cast<char *>(m_buffer.ptr)[index];
+        // The returned reference may be written through at any time, so the buffer
+        // can be neither shared now nor later.
+        if(!makeUnique())
+        {
+            printf("COULD NOT COPY shared string buffer of %zu chars\n", getStringSize());
+            std::terminate();
+        }
+        markUnshareable();
+        return getData()[index];
+    }
+
+    bool SMPString::setChar(size_t index, char c)
+    {
+        bool ret = makeUnique();
+        if(ret)
+        {
+            getData()[index] = c;
+        }
+        return ret;
     }
 
     const char & SMPString::operator[](size_t index) const
     {
-        return m_buffer.ptr[index];
+        return getBuffer()[index];
+    }
+
+    bool SMPString::operator==(const SMPString & that) const
+    {
+        return *this == std::string_view(that);
+    }
+
+    bool SMPString::operator==(const char * str) const
+    {
+        // Stops at the NUL of str, so a shorter str is never read past its end.
+        size_t size = getStringSize();
+        return str && 0 == strncmp(getBuffer(), str, size) && '\0' == str[size];
+    }
+
+    bool SMPString::operator==(std::string_view str) const
+    {
+        return getStringSize() == str.size() && findMismatch(getBuffer(), str.data(), str.size()) == str.size();
+    }
+
+    bool SMPString::operator!=(const SMPString & that) const
+    {
+        return !(*this == that);
     }
 
-    bool SMPString::operator==(const SMPString & that)
+    bool SMPString::operator!=(const char * str) const
     {
-        return (0 == strcmp(this->getBuffer(), that.getBuffer()));
+        return !(*this == str);
     }
 
-    bool SMPString::operator==(const char * str)
+    bool SMPString::operator!=(std::string_view str) const
     {
-        return (0 == strcmp(this->getBuffer(), str));
+        return !(*this == str);
     }
 
     SMPString SMPString::operator+(const SMPString & that) const
-    {        
-        SMPString ret(m_memoryPool, this->getStringSize() + that.getStringSize());
-        std::strcpy(reinterpret_cast<char *>(ret.m_buffer.ptr), reinterpret_cast<char *>(m_buffer.ptr)); 
-        std::strcpy(reinterpret_cast<char *>(ret.m_buffer.ptr + m_stringSize), reinterpret_cast<char *>(that.m_buffer.ptr));
+    {
+        SMPString ret(m_memoryPool, getStringSize() + that.getStringSize());
+        ret.append(getBuffer(), getStringSize());
+        ret.append(that.getBuffer(), that.getStringSize());
         return ret;
     }
 
     SMPString SMPString::operator+(const char * str) const
     {
-        SMPString ret(m_memoryPool, this->getStringSize() + strlen(str));
-        std::strcpy(reinterpret_cast<char *>(ret.m_buffer.ptr), reinterpret_cast<char *>(m_buffer.ptr));
-        std::strcpy(reinterpret_cast<char *>(ret.m_buffer.ptr + m_stringSize), str);
+        size_t strSize = str ? strlen(str) : 0;
+        SMPString ret(m_memoryPool, getStringSize() + strSize);
+        ret.append(getBuffer(), getStringSize());
+        ret.append(str, strSize);
+        return ret;
+    }
+
+    SMPString SMPString::operator+(std::string_view str) const
+    {
+        SMPString ret(m_memoryPool, getStringSize() + str.size());
+        ret.append(getBuffer(), getStringSize());
+        ret.append(str.data(), str.size());
         return ret;
     }
 
     SMPString & SMPString::operator+=(const char * str)
     {
-        size_t newStringSize = strlen(str) + getStringSize();
-        if(newStringSize > getBufferSize())
+        if(str)
         {
-            auto newBuffer = m_memoryPool->allocateMemory(newStringSize);
-            std::strcpy(reinterpret_cast<char *>(newBuffer.ptr), reinterpret_cast<char *>(m_buffer.ptr));
-            m_memoryPool->freeMemory(&m_buffer);
-            m_buffer = newBuffer;
+            append(str, strlen(str));
         }
-        std::strcpy(reinterpret_cast<char *>(m_buffer.ptr + m_stringSize), str);
-        m_stringSize = newStringSize;
         return *this;
     }
 
     SMPString & SMPString::operator+=(const SMPString & that)
     {
-        size_t newStringSize = that.getStringSize() + getStringSize();
-        if(newStringSize > getBufferSize())
-        {
-            auto newBuffer = m_memoryPool->allocateMemory(newStringSize);
-            std::strcpy(reinterpret_cast<char *>(newBuffer.ptr), reinterpret_cast<char *>(m_buffer.ptr));
-            m_memoryPool->freeMemory(&m_buffer);
-            m_buffer = newBuffer;
-        }
-        std::strcpy(reinterpret_cast<char *>(m_buffer.ptr + m_stringSize), that.getBuffer());
-        m_stringSize = newStringSize;
+        append(that.getBuffer(), that.getStringSize());
         return *this;
     }
 
+    SMPString & SMPString::operator+=(std::string_view str)
+    {
+        append(str.data(), str.size());
+        return *this;
+    }
+
+    SMPString::operator std::string_view() const
+    {
+        return std::string_view(getBuffer(), getStringSize());
+    }
+
+    int SMPString::compare(std::string_view str) const
+    {
+        return compareStrings(getBuffer(), getStringSize(), str.data(), str.size());
+    }
+
+    size_t SMPString::find(std::string_view str, size_t from) const
+    {
+        return findString(getBuffer(), getStringSize(), str.data(), str.size(), from);
+    }
+
+    size_t SMPString::find(char c, size_t from) const
+    {
+        return findString(getBuffer(), getStringSize(), &c, 1, from);
+    }
+
+    size_t SMPString::rfind(std::string_view str, size_t from) const
+    {
+        return findLastString(getBuffer(), getStringSize(), str.data(), str.size(), from);
+    }
+
+    size_t SMPString::rfind(char c, size_t from) const
+    {
+        return findLastString(getBuffer(), getStringSize(), &c, 1, from);
+    }
+
+    bool SMPString::startsWith(std::string_view str) const
+    {
+        return str.size() <= getStringSize() && findMismatch(getBuffer(), str.data(), str.size()) == str.size();
+    }
+
+    bool SMPString::endsWith(std::string_view str) const
+    {
+        size_t size = getStringSize();
+        return str.size() <= size && findMismatch(getBuffer() + size - str.size(), str.data(), str.size()) == str.size();
+    }
+
     const char * SMPString::getBuffer() const
     {
-        return reinterpret_cast<const char *>(m_buffer.ptr);
+        return isLocal() ? m_storage.local : m_storage.heap.ptr;
     }
 
     size_t SMPString::getBufferSize() const
     {
-        return m_buffer.size;
+        return getCapacity() + 1;
     }
 
     size_t SMPString::getStringSize() const
     {
-        return m_stringSize;
+        return isLocal() ? InlineCapacity - static_cast<unsigned char>(m_storage.local[InlineCapacity]) : m_storage.heap.size;
+    }
+
+    bool SMPString::isInline() const
+    {
+        return isLocal();
+    }
+
+    bool SMPString::isShared() const
+    {
+        bool ret = false;
+#if SMP_STRING_SHARED_BUFFERS
+        ret = !isLocal() && (loadRefCount(getRefCount(getRun())) & ~UnshareableFlag) > 1;
+#endif
+        return ret;
+    }
+
+    size_t SMPString::getCapacity() const
+    {
+        return isLocal() ? InlineCapacity : decodeCapacity(m_storage.heap.capacityWord);
+    }
+
+    bool SMPString::reserve(size_t capacity)
+    {
+        return prepareCapacity(capacity, true);
+    }
+
+    void SMPString::shrinkToFit()
+    {
+        if(!isLocal())
+        {
+            size_t size = getStringSize();
+            if(size <= InlineCapacity)
+            {
+                char local[InlineCapacity + 1];
+                memcpy(local, m_storage.heap.ptr, size);
+                releaseBuffer();
+                memcpy(m_storage.local, local, size);
+                setLocalSize(size);
+            }
+            else if(m_memoryPool && !isShared())
+            {
+                MemoryBlock buffer(getRun(), BufferHeaderSize + getCapacity() + 1);
+                if(m_memoryPool->resizeMemory(&buffer, BufferHeaderSize + size + 1))
+                {
+                    m_storage.heap.capacityWord = encodeCapacity(buffer.size - BufferHeaderSize - 1);
+                }
+            }
+        }
+    }
+
+    bool SMPString::isLocal() const
+    {
+        return 0 == (static_cast<unsigned char>(m_storage.local[InlineCapacity]) & 0x80);
+    }
+
+    char * SMPString::getData()
+    {
+        return isLocal() ? m_storage.local : m_storage.heap.ptr;
     }
 
-}
\ No newline at end of file
+    unsigned char * SMPString::getRun() const
+    {
+        return reinterpret_cast<unsigned char *>(m_storage.heap.ptr) - BufferHeaderSize;
+    }
+
+    // Takes a reference on that pool buffer instead of copying it, releasing the current one.
+    bool SMPString::shareFrom(const SMPString & that)
+    {
+        bool ret = false;
+#if SMP_STRING_SHARED_BUFFERS
+        ret = !that.isLocal() && that.m_memoryPool && 0 == (loadRefCount(getRefCount(that.getRun())) & UnshareableFlag);
+        if(ret)
+        {
+            addReference(getRefCount(that.getRun()));
+            releaseBuffer();
+            m_memoryPool = that.m_memoryPool;
+            m_storage = that.m_storage;
+        }
+#else
+        (void)that;
+#endif
+        return ret;
+    }
+
+    // Gives the string a private copy of a shared buffer before it gets written.
+    bool SMPString::makeUnique()
+    {
+        return !isShared() || prepareCapacity(getStringSize(), true);
+    }
+
+    void SMPString::markUnshareable()
+    {
+#if SMP_STRING_SHARED_BUFFERS
+        if(!isLocal() && !isShared())
+        {
+            getRefCount(getRun()) = 1 | UnshareableFlag;
+        }
+#endif
+    }
+
+    void SMPString::setLocalSize(size_t size)
+    {
+        assert(size <= InlineCapacity);
+        m_storage.local[size] = '\0';
+        m_storage.local[InlineCapacity] = static_cast<char>(InlineCapacity - size);
+    }
+
+    void SMPString::setStringSize(size_t size)
+    {
+        if(isLocal())
+        {
+            setLocalSize(size);
+        }
+        else
+        {
+            m_storage.heap.size = size;
+            m_storage.heap.ptr[size] = '\0';
+        }
+    }
+
+    void SMPString::moveFrom(SMPString & that)
+    {
+        m_storage = that.m_storage;
+        that.setLocalSize(0);
+    }
+
+    // Makes room for capacity chars, extending the pool run in place when possible and
+    // otherwise moving the content to a new run if asked. A shared buffer is never written,
+    // the string moves to a private one instead. On failure the string is left untouched.
+    bool SMPString::prepareCapacity(size_t capacity, bool keepContent)
+    {
+        size_t keptSize = keepContent ? getStringSize() : 0;
+        bool isBufferShared = isShared();
+        bool ret = capacity <= getCapacity() && !isBufferShared;
+        if(!ret && isBufferShared && std::max(capacity, keptSize) <= InlineCapacity)
+        {
+            char local[InlineCapacity + 1];
+            memcpy(local, m_storage.heap.ptr, keptSize);
+            releaseBuffer();
+            memcpy(m_storage.local, local, keptSize);
+            setLocalSize(keptSize);
+            ret = true;
+        }
+        if(!ret && m_memoryPool && !isLocal() && !isBufferShared)
+        {
+            MemoryBlock buffer(getRun(), BufferHeaderSize + getCapacity() + 1);
+            ret = m_memoryPool->resizeMemory(&buffer, BufferHeaderSize + capacity + 1);
+            if(ret)
+            {
+                m_storage.heap.capacityWord = encodeCapacity(buffer.size - BufferHeaderSize - 1);
+            }
+        }
+        if(!ret && m_memoryPool)
+        {
+            MemoryBlock buffer = m_memoryPool->allocateMemory(BufferHeaderSize + std::max(capacity, keptSize) + 1);
+            if(buffer.ptr)
+            {
+#if SMP_STRING_SHARED_BUFFERS
+                new (buffer.ptr) RefCount(1);
+#endif
+                char * ptr = reinterpret_cast<char *>(buffer.ptr + BufferHeaderSize);
+                memcpy(ptr, getBuffer(), keptSize);
+                releaseBuffer();
+                // The string is on the heap now, its size is set there directly.
+                m_storage.heap.ptr = ptr;
+                m_storage.heap.size = keptSize;
+                m_storage.heap.capacityWord = encodeCapacity(buffer.size - BufferHeaderSize - 1);
+                ptr[keptSize] = '\0';
+                ret = true;
+            }
+        }
+        return ret;
+    }
+
+    void SMPString::releaseBuffer()
+    {
+        if(!isLocal())
+        {
+#if SMP_STRING_SHARED_BUFFERS
+            bool isLastReference = dropReference(getRefCount(getRun()));
+#else
+            bool isLastReference = true;
+#endif
+            if(m_memoryPool && isLastReference)
+            {
+                MemoryBlock buffer(getRun(), BufferHeaderSize + getCapacity() + 1);
+                m_memoryPool->freeMemory(&buffer);
+            }
+            setLocalSize(0);
+        }
+    }
+
+    void SMPString::assign(const char * str, size_t size)
+    {
+        if(prepareCapacity(size, false))
+        {
+            memmove(getData(), str, size);
+            setStringSize(size);
+        }
+    }
+
+    void SMPString::append(const char * str, size_t size)
+    {
+        size_t stringSize = getStringSize();
+        // Appending a part of itself, the source moves along with the content.
+        const char * buffer = getBuffer();
+        bool isAliased = str >= buffer && str < buffer + stringSize;
+        size_t offset = isAliased ? static_cast<size_t>(str - buffer) : 0;
+        size_t capacity = getCapacity();
+        // Heap strings double so that appending in a loop stays linear, a string
+        // leaving the inline storage gets an exact run since the pool rounds it to blocks anyway.
+        size_t grownCapacity = isLocal() ? stringSize + size : std::max(stringSize + size, 2 * capacity);
+        if((stringSize + size <= capacity && !isShared()) || prepareCapacity(grownCapacity, true) || prepareCapacity(stringSize + size, true))
+        {
+            memmove(getData() + stringSize, isAliased ? getBuffer() + offset : str, size);
+            setStringSize(stringSize + size);
+        }
+    }
+}
@@ -1,38 +1,135 @@
+#pragma once
+
+#include <string_view>
+
 #include "SimpleFixedMemoryPool.h"
+#include "StringSearch.h"
+
+// Pool strings share their buffer between copies and make a private copy on the first
+// mutation. Build with -DSMP_STRING_SHARED_BUFFERS=0 to always copy instead, and with
+// -DSMP_STRING_ATOMIC_REFCOUNT=1 when copies of a string are dropped from several threads.
+#ifndef SMP_STRING_SHARED_BUFFERS
+#define SMP_STRING_SHARED_BUFFERS 1
+#endif
+
+#ifndef SMP_STRING_ATOMIC_REFCOUNT
+#define SMP_STRING_ATOMIC_REFCOUNT 0
+#endif
 
 namespace SimpleMemoryPool
 {
     // TODO : Maybe changing class name.
+    // Strings up to InlineCapacity chars live inside the object and never touch the pool,
+    // longer ones spill to a pool run. The last inline byte holds InlineCapacity - size,
+    // so it doubles as the terminating NUL of a full inline string, and its top bit,
+    // shared with the heap capacity word, tells the two layouts apart.
+    // A pool run starts with a BufferHeaderSize reference count followed by the chars, so
+    // copying a pool string is O(1). Handing out a char & through operator[] marks the
+    // buffer as unshareable, later copies of that string get their own buffer.
     class SMPString
     {
-        MemoryBlock             m_buffer;
-        const size_t            m_defaultBufferSize = 32;
-        size_t                  m_stringSize = 0;
+    public :
+        static constexpr size_t InlineCapacity = 23;
+        static constexpr size_t BufferHeaderSize = SMP_STRING_SHARED_BUFFERS ? sizeof(size_t) : 0;
+        static constexpr size_t NotFound = StringNotFound;
+
+    private :
+        struct HeapStorage
+        {
+            char *  ptr;
+            size_t  size;
+            size_t  capacityWord;
+        };
+
+        union Storage
+        {
+            HeapStorage heap;
+            char        local[InlineCapacity + 1];
+        };
+
         SimpleFixedMemoryPool * m_memoryPool = nullptr;
+        Storage                 m_storage;
+
+        bool isLocal() const;
+        char * getData();
+        unsigned char * getRun() const;
+        bool shareFrom(const SMPString & that);
+        bool makeUnique();
+        void markUnshareable();
+        void setLocalSize(size_t size);
+        void setStringSize(size_t size);
+        void moveFrom(SMPString & that);
+        bool prepareCapacity(size_t capacity, bool keepContent);
+        void releaseBuffer();
+        void assign(const char * str, size_t size);
+        void append(const char * str, size_t size);
+
+        friend class SMPStringBuilder;
 
     public :
         SMPString(SimpleFixedMemoryPool * memoryPool);
         SMPString(SimpleFixedMemoryPool * memoryPool, const char * str);
+        SMPString(SimpleFixedMemoryPool * memoryPool, std::string_view str);
+        // Empty string with room for strSize chars.
         SMPString(SimpleFixedMemoryPool * memoryPool, size_t strSize);
         ~SMPString();
 
         SMPString(const SMPString & that);
         SMPString & operator=(const SMPString & that);
-        SMPString(const SMPString && that) noexcept;
-        SMPString & operator=(const SMPString && that) noexcept;
+        // The moved from string is left empty and inline, still bound to its pool.
+        SMPString(SMPString && that) noexcept;
+        SMPString & operator=(SMPString && that) noexcept;
 
         SMPString & operator=(const char * str);
+        SMPString & operator=(std::string_view str);
+        // Gives the string a private buffer first and terminates when the pool cannot supply it,
+        // setChar() reports that failure instead.
         char & operator[](size_t index);
         const char & operator[](size_t index) const;
-        bool operator==(const SMPString & that);
-        bool operator==(const char * str);
+        // Sizes are compared first, the chars only when they match.
+        bool operator==(const SMPString & that) const;
+        bool operator==(const char * str) const;
+        bool operator==(std::string_view str) const;
+        bool operator!=(const SMPString & that) const;
+        bool operator!=(const char * str) const;
+        bool operator!=(std::string_view str) const;
         SMPString operator+(const SMPString & that) const;
         SMPString operator+(const char * str) const;
+        SMPString operator+(std::string_view str) const;
         SMPString & operator+=(const char * str);
         SMPString & operator+=(const SMPString & that);
+        SMPString & operator+=(std::string_view str);
+        operator std::string_view() const;
+
+        // Negative, zero or positive like memcmp, a prefix comes before the longer string.
+        int compare(std::string_view str) const;
+        // Position of the first occurrence at or after from, NotFound when there is none.
+        size_t find(std::string_view str, size_t from = 0) const;
+        size_t find(char c, size_t from = 0) const;
+        // Position of the last occurrence starting at or before from, NotFound when there is none.
+        size_t rfind(std::string_view str, size_t from = NotFound) const;
+        size_t rfind(char c, size_t from = NotFound) const;
+        bool startsWith(std::string_view str) const;
+        bool endsWith(std::string_view str) const;
+
+        // Writes one char, false and the string untouched when a shared buffer cannot be copied.
+        // Unlike operator[] it leaves the buffer shareable.
+        bool setChar(size_t index, char c);
+
         // TODO : Maybe changing method name.
         const char * getBuffer() const;
+        // Bytes available for chars and the NUL, inline or in the pool.
         size_t getBufferSize() const;
         size_t getStringSize() const;
+        bool isInline() const;
+        // True when another string holds the same pool buffer.
+        bool isShared() const;
+
+        // Chars the string holds without reallocating. Appends grow it geometrically, first
+        // by extending the pool run in place when the blocks after it are free.
+        size_t getCapacity() const;
+        bool reserve(size_t capacity);
+        // Moves a short string back inline or gives the unused tail blocks back to the pool.
+        void shrinkToFit();
     };
-}
\ No newline at end of file
+}
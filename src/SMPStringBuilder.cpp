@@ -0,0 +1,119 @@
+#include "SMPStringBuilder.h"
+
+#include <cstring>
+
+namespace SimpleMemoryPool
+{
+    SMPStringBuilder::SMPStringBuilder(SimpleFixedMemoryPool * memoryPool)
+        : m_memoryPool(memoryPool), m_piecesBuffer(), m_pieces(m_inlinePieces), m_piecesCount(0),
+        m_piecesCapacity(InlinePiecesCount), m_stringSize(0), m_hasFailed(false)
+    {
+    }
+
+    SMPStringBuilder::~SMPStringBuilder()
+    {
+        if(m_memoryPool && m_piecesBuffer.ptr)
+        {
+            m_memoryPool->freeMemory(&m_piecesBuffer);
+        }
+    }
+
+    // Doubles the pieces storage, in place when the pool run can grow.
+    bool SMPStringBuilder::growPieces()
+    {
+        bool ret = false;
+        size_t capacity = 2 * m_piecesCapacity;
+        if(m_memoryPool)
+        {
+            if(m_piecesBuffer.ptr && m_memoryPool->resizeMemory(&m_piecesBuffer, capacity * sizeof(std::string_view)))
+            {
+                ret = true;
+            }
+            else
+            {
+                MemoryBlock buffer = m_memoryPool->allocateMemory(capacity * sizeof(std::string_view));
+                if(buffer.ptr)
+                {
+                    memcpy(buffer.ptr, m_pieces, m_piecesCount * sizeof(std::string_view));
+                    if(m_piecesBuffer.ptr)
+                    {
+                        m_memoryPool->freeMemory(&m_piecesBuffer);
+                    }
+                    m_piecesBuffer = buffer;
+                    m_pieces = reinterpret_cast<std::string_view *>(buffer.ptr);
+                    ret = true;
+                }
+            }
+        }
+        if(ret)
+        {
+            m_piecesCapacity = capacity;
+        }
+        return ret;
+    }
+
+    SMPStringBuilder & SMPStringBuilder::append(std::string_view str)
+    {
+        if(!m_hasFailed && !str.empty())
+        {
+            if(m_piecesCount < m_piecesCapacity || growPieces())
+            {
+                m_pieces[m_piecesCount++] = str;
+                m_stringSize += str.size();
+            }
+            else
+            {
+                m_hasFailed = true;
+            }
+        }
+        return *this;
+    }
+
+    SMPStringBuilder & SMPStringBuilder::append(const char * str)
+    {
+        return str ? append(std::string_view(str)) : *this;
+    }
+
+    SMPStringBuilder & SMPStringBuilder::append(const SMPString & str)
+    {
+        return append(std::string_view(str.getBuffer(), str.getStringSize()));
+    }
+
+    SMPString SMPStringBuilder::build() const
+    {
+        SMPString ret(m_memoryPool, m_stringSize);
+        if(!m_hasFailed && ret.getCapacity() >= m_stringSize)
+        {
+            char * ptr = ret.getData();
+            for(size_t i = 0; i < m_piecesCount; ++i)
+            {
+                memcpy(ptr, m_pieces[i].data(), m_pieces[i].size());
+                ptr += m_pieces[i].size();
+            }
+            ret.setStringSize(m_stringSize);
+        }
+        return ret;
+    }
+
+    void SMPStringBuilder::clear()
+    {
+        m_piecesCount = 0;
+        m_stringSize = 0;
+        m_hasFailed = false;
+    }
+
+    size_t SMPStringBuilder::getStringSize() const
+    {
+        return m_stringSize;
+    }
+
+    size_t SMPStringBuilder::getPiecesCount() const
+    {
+        return m_piecesCount;
+    }
+
+    bool SMPStringBuilder::hasFailed() const
+    {
+        return m_hasFailed;
+    }
+}
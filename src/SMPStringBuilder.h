@@ -0,0 +1,64 @@
+#pragma once
+
+#include <string_view>
+
+#include "SMPString.h"
+
+namespace SimpleMemoryPool
+{
+    // Collects pieces and builds the result with a single pool allocation and one copy
+    // per piece, where a + b + c + d makes a pool string for every +. Pieces are kept
+    // as views, so they have to outlive the build() call. The first InlinePiecesCount
+    // pieces are kept inside the builder, more pieces are kept in a pool run.
+    class SMPStringBuilder
+    {
+    public :
+        static constexpr size_t InlinePiecesCount = 8;
+
+    private :
+        SimpleFixedMemoryPool * m_memoryPool;
+        std::string_view        m_inlinePieces[InlinePiecesCount];
+        MemoryBlock             m_piecesBuffer;
+        std::string_view *      m_pieces;
+        size_t                  m_piecesCount;
+        size_t                  m_piecesCapacity;
+        size_t                  m_stringSize;
+        bool                    m_hasFailed;
+
+        bool growPieces();
+
+    public :
+        explicit SMPStringBuilder(SimpleFixedMemoryPool * memoryPool);
+        ~SMPStringBuilder();
+
+        SMPStringBuilder(const SMPStringBuilder &) = delete;
+        SMPStringBuilder & operator=(const SMPStringBuilder &) = delete;
+
+        SMPStringBuilder & append(std::string_view str);
+        SMPStringBuilder & append(const char * str);
+        SMPStringBuilder & append(const SMPString & str);
+
+        template<typename Piece>
+        SMPStringBuilder & operator<<(const Piece & piece)
+        {
+            return append(piece);
+        }
+
+        // Empty when a piece could not be stored or the pool could not hold the result.
+        SMPString build() const;
+        void clear();
+
+        size_t getStringSize() const;
+        size_t getPiecesCount() const;
+        bool hasFailed() const;
+    };
+
+    // N-way concatenation with one allocation, e.g. concatenate(&pool, symbol, ".", venue).
+    template<class ... Pieces>
+    SMPString concatenate(SimpleFixedMemoryPool * memoryPool, const Pieces & ... pieces)
+    {
+        SMPStringBuilder builder(memoryPool);
+        (builder.append(pieces), ...);
+        return builder.build();
+    }
+}
@@ -0,0 +1,342 @@
+#include "SMPStringTable.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace SimpleMemoryPool
+{
+    namespace
+    {
+        const size_t MinSlotsCount = 16;
+        const size_t MinEntriesCount = 16;
+        const size_t BatchGroupSize = 64;
+
+        size_t roundUpToPowerOfTwo(size_t value)
+        {
+            size_t ret = 1;
+            while(ret < value)
+            {
+                ret <<= 1;
+            }
+            return ret;
+        }
+
+        unsigned char *& previousChunk(unsigned char * chunk)
+        {
+            return *reinterpret_cast<unsigned char **>(chunk);
+        }
+
+        inline void prefetch(const void * ptr)
+        {
+#if defined(__GNUC__) || defined(__clang__)
+            __builtin_prefetch(ptr);
+#else
+            (void)ptr;
+#endif
+        }
+    }
+
+    uint32_t SMPStringTable::computeHash(std::string_view str)
+    {
+        // FNV-1a folded to 32 bits.
+        uint64_t hash = 14695981039346656037ULL;
+        for(char c : str)
+        {
+            hash ^= static_cast<unsigned char>(c);
+            hash *= 1099511628211ULL;
+        }
+        return static_cast<uint32_t>(hash ^ (hash >> 32));
+    }
+
+    SMPStringTable::SMPStringTable(SimpleFixedMemoryPool * memoryPool, size_t expectedCount)
+        : m_memoryPool(memoryPool), m_slotsBuffer(), m_entriesBuffer(), m_slotsCount(0), m_entriesCount(0),
+        m_lastChunk(nullptr), m_chunkUsedSize(0), m_chunkSize(0)
+    {
+        if(expectedCount)
+        {
+            reserve(expectedCount);
+        }
+    }
+
+    SMPStringTable::~SMPStringTable()
+    {
+        if(m_memoryPool)
+        {
+            while(m_lastChunk)
+            {
+                MemoryBlock chunk(m_lastChunk, 0);
+                m_lastChunk = previousChunk(m_lastChunk);
+                m_memoryPool->freeMemory(&chunk);
+            }
+            if(m_slotsBuffer.ptr)
+            {
+                m_memoryPool->freeMemory(&m_slotsBuffer);
+            }
+            if(m_entriesBuffer.ptr)
+            {
+                m_memoryPool->freeMemory(&m_entriesBuffer);
+            }
+        }
+    }
+
+    SMPStringTable::Slot * SMPStringTable::getSlots() const
+    {
+        return reinterpret_cast<Slot *>(m_slotsBuffer.ptr);
+    }
+
+    SMPStringTable::Entry * SMPStringTable::getEntries() const
+    {
+        return reinterpret_cast<Entry *>(m_entriesBuffer.ptr);
+    }
+
+    // Linear probing, stops on the matching slot or on the first empty one.
+    size_t SMPStringTable::findSlot(std::string_view str, uint32_t hash) const
+    {
+        const Slot * slots = getSlots();
+        const Entry * entries = getEntries();
+        size_t mask = m_slotsCount - 1;
+        size_t ret = hash & mask;
+        while(slots[ret].index)
+        {
+            if(slots[ret].hash == hash)
+            {
+                const Entry & entry = entries[slots[ret].index - 1];
+                if(entry.size == str.size() && 0 == memcmp(entry.ptr, str.data(), str.size()))
+                {
+                    break;
+                }
+            }
+            ret = (ret + 1) & mask;
+        }
+        return ret;
+    }
+
+    // Rehashes from the cached hashes, the strings themselves are never read again.
+    bool SMPStringTable::growSlots(size_t slotsCount)
+    {
+        bool ret = false;
+        if(m_memoryPool)
+        {
+            MemoryBlock buffer = m_memoryPool->allocateZeroed(slotsCount * sizeof(Slot));
+            if(buffer.ptr)
+            {
+                Slot * slots = reinterpret_cast<Slot *>(buffer.ptr);
+                const Slot * oldSlots = getSlots();
+                size_t mask = slotsCount - 1;
+                for(size_t i = 0; i < m_slotsCount; ++i)
+                {
+                    if(oldSlots[i].index)
+                    {
+                        size_t slot = oldSlots[i].hash & mask;
+                        while(slots[slot].index)
+                        {
+                            slot = (slot + 1) & mask;
+                        }
+                        slots[slot] = oldSlots[i];
+                    }
+                }
+                if(m_slotsBuffer.ptr)
+                {
+                    m_memoryPool->freeMemory(&m_slotsBuffer);
+                }
+                m_slotsBuffer = buffer;
+                m_slotsCount = slotsCount;
+                ret = true;
+            }
+        }
+        return ret;
+    }
+
+    bool SMPStringTable::growEntries(size_t entriesCount)
+    {
+        bool ret = entriesCount * sizeof(Entry) <= m_entriesBuffer.size;
+        if(!ret && m_memoryPool)
+        {
+            ret = m_entriesBuffer.ptr && m_memoryPool->resizeMemory(&m_entriesBuffer, entriesCount * sizeof(Entry));
+            if(!ret)
+            {
+                MemoryBlock buffer = m_memoryPool->allocateMemory(entriesCount * sizeof(Entry));
+                if(buffer.ptr)
+                {
+                    if(m_entriesBuffer.ptr)
+                    {
+                        memcpy(buffer.ptr, m_entriesBuffer.ptr, m_entriesCount * sizeof(Entry));
+                        m_memoryPool->freeMemory(&m_entriesBuffer);
+                    }
+                    m_entriesBuffer = buffer;
+                    ret = true;
+                }
+            }
+        }
+        return ret;
+    }
+
+    // Chars are packed in chunks, each one starting with a pointer to the previous chunk.
+    // Strings longer than a quarter of a chunk get a chunk of their own, linked behind the
+    // current one so that its free space is not lost.
+    const char * SMPStringTable::storeChars(std::string_view str)
+    {
+        char * ret = nullptr;
+        size_t size = str.size() + 1;
+        if(m_lastChunk && m_chunkUsedSize + size <= m_chunkSize)
+        {
+            ret = reinterpret_cast<char *>(m_lastChunk + m_chunkUsedSize);
+            m_chunkUsedSize += size;
+        }
+        else if(m_memoryPool)
+        {
+            bool isDedicated = size > ChunkSize / 4;
+            MemoryBlock chunk = m_memoryPool->allocateMemory(sizeof(unsigned char *) + (isDedicated ? size : ChunkSize));
+            if(chunk.ptr)
+            {
+                ret = reinterpret_cast<char *>(chunk.ptr + sizeof(unsigned char *));
+                if(isDedicated && m_lastChunk)
+                {
+                    previousChunk(chunk.ptr) = previousChunk(m_lastChunk);
+                    previousChunk(m_lastChunk) = chunk.ptr;
+                }
+                else
+                {
+                    previousChunk(chunk.ptr) = m_lastChunk;
+                    m_lastChunk = chunk.ptr;
+                    m_chunkSize = chunk.size;
+                    m_chunkUsedSize = sizeof(unsigned char *) + size;
+                }
+            }
+        }
+        if(ret)
+        {
+            memcpy(ret, str.data(), str.size());
+            ret[str.size()] = '\0';
+        }
+        return ret;
+    }
+
+    InternedString SMPStringTable::insert(std::string_view str, uint32_t hash, size_t slot)
+    {
+        InternedString ret;
+        size_t entriesCapacity = m_entriesBuffer.size / sizeof(Entry);
+        if(m_entriesCount < entriesCapacity || growEntries(std::max(MinEntriesCount, 2 * entriesCapacity)))
+        {
+            const char * ptr = storeChars(str);
+            if(ptr)
+            {
+                getEntries()[m_entriesCount] = Entry{ ptr, static_cast<uint32_t>(str.size()), hash };
+                getSlots()[slot] = Slot{ hash, static_cast<uint32_t>(m_entriesCount + 1) };
+                ret = InternedString(static_cast<uint32_t>(m_entriesCount));
+                ++m_entriesCount;
+            }
+        }
+        return ret;
+    }
+
+    InternedString SMPStringTable::intern(std::string_view str)
+    {
+        InternedString ret;
+        if(str.size() < UINT32_MAX && m_entriesCount + 1 < InternedString::InvalidId)
+        {
+            uint32_t hash = computeHash(str);
+            // Keeps the load factor under one half.
+            if(2 * (m_entriesCount + 1) > m_slotsCount)
+            {
+                growSlots(std::max(MinSlotsCount, 2 * m_slotsCount));
+            }
+            if(m_entriesCount + 1 < m_slotsCount)
+            {
+                size_t slot = findSlot(str, hash);
+                const Slot & found = getSlots()[slot];
+                ret = found.index ? InternedString(found.index - 1) : insert(str, hash, slot);
+            }
+        }
+        return ret;
+    }
+
+    InternedString SMPStringTable::intern(const char * str)
+    {
+        return str ? intern(std::string_view(str)) : InternedString();
+    }
+
+    InternedString SMPStringTable::intern(const SMPString & str)
+    {
+        return intern(std::string_view(str.getBuffer(), str.getStringSize()));
+    }
+
+    size_t SMPStringTable::internBatch(const std::string_view * strs, size_t count, InternedString * handles)
+    {
+        size_t ret = 0;
+        reserve(m_entriesCount + count);
+        uint32_t hashes[BatchGroupSize];
+        for(size_t group = 0; group < count; group += BatchGroupSize)
+        {
+            size_t groupSize = std::min(BatchGroupSize, count - group);
+            for(size_t i = 0; i < groupSize; ++i)
+            {
+                hashes[i] = computeHash(strs[group + i]);
+                if(m_slotsCount)
+                {
+                    prefetch(getSlots() + (hashes[i] & (m_slotsCount - 1)));
+                }
+            }
+            for(size_t i = 0; i < groupSize; ++i)
+            {
+                const std::string_view & str = strs[group + i];
+                InternedString handle;
+                if(m_entriesCount + 1 < m_slotsCount && 2 * (m_entriesCount + 1) <= m_slotsCount)
+                {
+                    size_t slot = findSlot(str, hashes[i]);
+                    const Slot & found = getSlots()[slot];
+                    handle = found.index ? InternedString(found.index - 1) : insert(str, hashes[i], slot);
+                }
+                else
+                {
+                    handle = intern(str);
+                }
+                handles[group + i] = handle;
+                ret += handle.isValid() ? 1 : 0;
+            }
+        }
+        return ret;
+    }
+
+    InternedString SMPStringTable::find(std::string_view str) const
+    {
+        InternedString ret;
+        if(m_slotsCount)
+        {
+            const Slot & found = getSlots()[findSlot(str, computeHash(str))];
+            if(found.index)
+            {
+                ret = InternedString(found.index - 1);
+            }
+        }
+        return ret;
+    }
+
+    std::string_view SMPStringTable::getString(InternedString handle) const
+    {
+        std::string_view ret;
+        if(handle.getId() < m_entriesCount)
+        {
+            const Entry & entry = getEntries()[handle.getId()];
+            ret = std::string_view(entry.ptr, entry.size);
+        }
+        return ret;
+    }
+
+    const char * SMPStringTable::getBuffer(InternedString handle) const
+    {
+        return handle.getId() < m_entriesCount ? getEntries()[handle.getId()].ptr : nullptr;
+    }
+
+    bool SMPStringTable::reserve(size_t count)
+    {
+        size_t slotsCount = std::max(MinSlotsCount, roundUpToPowerOfTwo(2 * count + 1));
+        bool ret = slotsCount <= m_slotsCount || growSlots(slotsCount);
+        return growEntries(std::max(MinEntriesCount, count)) && ret;
+    }
+
+    size_t SMPStringTable::getSize() const
+    {
+        return m_entriesCount;
+    }
+}
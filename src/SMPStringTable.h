@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string_view>
+
+#include "SMPString.h"
+
+namespace SimpleMemoryPool
+{
+    // Handle to a string interned in an SMPStringTable. Equality and hashing compare the
+    // id only, so they are O(1), and handles are only comparable within the same table.
+    class InternedString
+    {
+        uint32_t m_id;
+
+    public :
+        static constexpr uint32_t InvalidId = UINT32_MAX;
+
+        InternedString() : m_id(InvalidId) {}
+        explicit InternedString(uint32_t id) : m_id(id) {}
+
+        uint32_t getId() const { return m_id; }
+        bool isValid() const { return InvalidId != m_id; }
+
+        bool operator==(const InternedString & that) const { return m_id == that.m_id; }
+        bool operator!=(const InternedString & that) const { return m_id != that.m_id; }
+        bool operator<(const InternedString & that) const { return m_id < that.m_id; }
+    };
+
+    // Interning table whose storage all comes from a SimpleFixedMemoryPool: an open addressing
+    // slot array with the hash cached next to every id, an id indexed array of entries and
+    // chunks holding the interned chars back to back. Ids are dense and given in interning order.
+    class SMPStringTable
+    {
+        struct Slot
+        {
+            uint32_t hash;
+            // Id + 1, 0 for an empty slot.
+            uint32_t index;
+        };
+
+        struct Entry
+        {
+            const char *    ptr;
+            uint32_t        size;
+            uint32_t        hash;
+        };
+
+        SimpleFixedMemoryPool * m_memoryPool;
+        MemoryBlock             m_slotsBuffer;
+        MemoryBlock             m_entriesBuffer;
+        size_t                  m_slotsCount;
+        size_t                  m_entriesCount;
+        unsigned char *         m_lastChunk;
+        size_t                  m_chunkUsedSize;
+        size_t                  m_chunkSize;
+
+        Slot * getSlots() const;
+        Entry * getEntries() const;
+        size_t findSlot(std::string_view str, uint32_t hash) const;
+        bool growSlots(size_t slotsCount);
+        bool growEntries(size_t entriesCount);
+        const char * storeChars(std::string_view str);
+        InternedString insert(std::string_view str, uint32_t hash, size_t slot);
+
+    public :
+        static constexpr size_t ChunkSize = 4096;
+
+        static uint32_t computeHash(std::string_view str);
+
+        explicit SMPStringTable(SimpleFixedMemoryPool * memoryPool, size_t expectedCount = 0);
+        ~SMPStringTable();
+
+        SMPStringTable(const SMPStringTable &) = delete;
+        SMPStringTable & operator=(const SMPStringTable &) = delete;
+
+        // Invalid handle when the pool is out of memory.
+        InternedString intern(std::string_view str);
+        InternedString intern(const char * str);
+        InternedString intern(const SMPString & str);
+        // Interns a batch of tokens: the table is grown once for the whole batch and the
+        // hashes are computed before probing. Returns how many tokens got a valid handle.
+        size_t internBatch(const std::string_view * strs, size_t count, InternedString * handles);
+        // Invalid handle when the string was never interned.
+        InternedString find(std::string_view str) const;
+
+        std::string_view getString(InternedString handle) const;
+        // NUL terminated, nullptr for an invalid handle.
+        const char * getBuffer(InternedString handle) const;
+
+        bool reserve(size_t count);
+        size_t getSize() const;
+    };
+}
+
+namespace std
+{
+    template<>
+    struct hash<SimpleMemoryPool::InternedString>
+    {
+        size_t operator()(const SimpleMemoryPool::InternedString & handle) const noexcept
+        {
+            return handle.getId();
+        }
+    };
+}
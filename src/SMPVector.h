@@ -0,0 +1,358 @@
+#pragma once
+
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "SimpleFixedMemoryPool.h"
+
+namespace SimpleMemoryPool
+{
+    // Growable array kept in a single pool run. Growing first tries to extend the run in
+    // place over the free blocks after it, so the elements only move when that fails, and
+    // then with one memcpy for trivially copyable types. Works with move only types.
+    // Calls that need memory return false or nullptr when the pool is out of it.
+    template<typename T>
+    class SMPVector
+    {
+        SimpleFixedMemoryPool * m_memoryPool;
+        MemoryBlock             m_buffer;
+        size_t                  m_size;
+        size_t                  m_capacity;
+
+        static constexpr size_t MinCapacity = 4;
+
+        static void relocate(T * destination, T * source, size_t count);
+        bool grow(size_t capacity);
+        template<class ... Args>
+        T * emplaceBackGrowing(Args && ... args);
+        void truncate(size_t size);
+        void release();
+
+    public :
+        explicit SMPVector(SimpleFixedMemoryPool * memoryPool);
+        ~SMPVector();
+
+        SMPVector(const SMPVector & that);
+        SMPVector & operator=(const SMPVector & that);
+        // The moved from vector is left empty, still bound to its pool.
+        SMPVector(SMPVector && that) noexcept;
+        SMPVector & operator=(SMPVector && that) noexcept;
+
+        template<class ... Args>
+        T * emplaceBack(Args && ... args);
+        bool pushBack(const T & value);
+        bool pushBack(T && value);
+        void popBack();
+        // Moves the last element into the hole, O(1) but does not keep the order.
+        void swapRemove(size_t index);
+        // New elements are value initialized.
+        bool resize(size_t size);
+        void clear();
+
+        bool reserve(size_t capacity);
+        // Gives the unused tail blocks back to the pool, the elements never move.
+        void shrinkToFit();
+
+        T & operator[](size_t index) { return getData()[index]; }
+        const T & operator[](size_t index) const { return getData()[index]; }
+        T & back() { return getData()[m_size - 1]; }
+        const T & back() const { return getData()[m_size - 1]; }
+        T * begin() { return getData(); }
+        T * end() { return getData() + m_size; }
+        const T * begin() const { return getData(); }
+        const T * end() const { return getData() + m_size; }
+
+        T * getData() { return reinterpret_cast<T *>(m_buffer.ptr); }
+        const T * getData() const { return reinterpret_cast<const T *>(m_buffer.ptr); }
+        size_t getSize() const { return m_size; }
+        size_t getCapacity() const { return m_capacity; }
+        bool isEmpty() const { return 0 == m_size; }
+        SimpleFixedMemoryPool * getMemoryPool() const { return m_memoryPool; }
+    };
+
+    template<typename T>
+    SMPVector<T>::SMPVector(SimpleFixedMemoryPool * memoryPool)
+        : m_memoryPool(memoryPool), m_buffer(), m_size(0), m_capacity(0)
+    {
+    }
+
+    template<typename T>
+    SMPVector<T>::~SMPVector()
+    {
+        release();
+    }
+
+    template<typename T>
+    SMPVector<T>::SMPVector(const SMPVector & that) : SMPVector(that.m_memoryPool)
+    {
+        *this = that;
+    }
+
+    template<typename T>
+    SMPVector<T> & SMPVector<T>::operator=(const SMPVector & that)
+    {
+        if(this != &that)
+        {
+            clear();
+            if(reserve(that.m_size))
+            {
+                if constexpr(std::is_trivially_copyable<T>::value)
+                {
+                    memcpy(m_buffer.ptr, that.m_buffer.ptr, that.m_size * sizeof(T));
+                    m_size = that.m_size;
+                }
+                else
+                {
+                    for(const T & value : that)
+                    {
+                        new (getData() + m_size) T(value);
+                        ++m_size;
+                    }
+                }
+            }
+        }
+        return *this;
+    }
+
+    template<typename T>
+    SMPVector<T>::SMPVector(SMPVector && that) noexcept
+        : m_memoryPool(that.m_memoryPool), m_buffer(that.m_buffer), m_size(that.m_size), m_capacity(that.m_capacity)
+    {
+        that.m_buffer = MemoryBlock();
+        that.m_size = 0;
+        that.m_capacity = 0;
+    }
+
+    template<typename T>
+    SMPVector<T> & SMPVector<T>::operator=(SMPVector && that) noexcept
+    {
+        if(this != &that)
+        {
+            release();
+            m_memoryPool = that.m_memoryPool;
+            m_buffer = that.m_buffer;
+            m_size = that.m_size;
+            m_capacity = that.m_capacity;
+            that.m_buffer = MemoryBlock();
+            that.m_size = 0;
+            that.m_capacity = 0;
+        }
+        return *this;
+    }
+
+    // Moves count elements to uninitialized memory and ends the source ones.
+    template<typename T>
+    void SMPVector<T>::relocate(T * destination, T * source, size_t count)
+    {
+        if constexpr(std::is_trivially_copyable<T>::value)
+        {
+            memcpy(static_cast<void *>(destination), static_cast<const void *>(source), count * sizeof(T));
+        }
+        else
+        {
+            for(size_t i = 0; i < count; ++i)
+            {
+                new (destination + i) T(std::move_if_noexcept(source[i]));
+                source[i].~T();
+            }
+        }
+    }
+
+    template<typename T>
+    bool SMPVector<T>::grow(size_t capacity)
+    {
+        bool ret = m_memoryPool && m_buffer.ptr && m_memoryPool->resizeMemory(&m_buffer, capacity * sizeof(T));
+        if(!ret && m_memoryPool)
+        {
+            MemoryBlock buffer = m_memoryPool->allocateMemory(capacity * sizeof(T));
+            if(buffer.ptr)
+            {
+                if(m_buffer.ptr)
+                {
+                    relocate(reinterpret_cast<T *>(buffer.ptr), getData(), m_size);
+                    m_memoryPool->freeMemory(&m_buffer);
+                }
+                m_buffer = buffer;
+                ret = true;
+            }
+        }
+        if(ret)
+        {
+            // The pool rounds the run up to whole blocks, all of it is usable.
+            m_capacity = m_buffer.size / sizeof(T);
+        }
+        return ret;
+    }
+
+    // The new element is built before the old ones move, so args may refer to one of them.
+    template<typename T>
+    template<class ... Args>
+    T * SMPVector<T>::emplaceBackGrowing(Args && ... args)
+    {
+        T * ret = nullptr;
+        size_t capacity = m_capacity > MinCapacity / 2 ? 2 * m_capacity : MinCapacity;
+        if(m_memoryPool && m_buffer.ptr && m_memoryPool->resizeMemory(&m_buffer, capacity * sizeof(T)))
+        {
+            m_capacity = m_buffer.size / sizeof(T);
+            ret = new (getData() + m_size) T(std::forward<Args>(args)...);
+            ++m_size;
+        }
+        else if(m_memoryPool)
+        {
+            MemoryBlock buffer = m_memoryPool->allocateMemory(capacity * sizeof(T));
+            if(buffer.ptr)
+            {
+                T * data = reinterpret_cast<T *>(buffer.ptr);
+                try
+                {
+                    ret = new (data + m_size) T(std::forward<Args>(args)...);
+                }
+                catch(...)
+                {
+                    m_memoryPool->freeMemory(&buffer);
+                    throw;
+                }
+                if(m_buffer.ptr)
+                {
+                    relocate(data, getData(), m_size);
+                    m_memoryPool->freeMemory(&m_buffer);
+                }
+                m_buffer = buffer;
+                m_capacity = m_buffer.size / sizeof(T);
+                ++m_size;
+            }
+        }
+        return ret;
+    }
+
+    template<typename T>
+    template<class ... Args>
+    T * SMPVector<T>::emplaceBack(Args && ... args)
+    {
+        T * ret = nullptr;
+        if(m_size < m_capacity)
+        {
+            ret = new (getData() + m_size) T(std::forward<Args>(args)...);
+            ++m_size;
+        }
+        else
+        {
+            ret = emplaceBackGrowing(std::forward<Args>(args)...);
+        }
+        return ret;
+    }
+
+    template<typename T>
+    bool SMPVector<T>::pushBack(const T & value)
+    {
+        return nullptr != emplaceBack(value);
+    }
+
+    template<typename T>
+    bool SMPVector<T>::pushBack(T && value)
+    {
+        return nullptr != emplaceBack(std::move(value));
+    }
+
+    template<typename T>
+    void SMPVector<T>::popBack()
+    {
+        --m_size;
+        getData()[m_size].~T();
+    }
+
+    template<typename T>
+    void SMPVector<T>::swapRemove(size_t index)
+    {
+        if(index + 1 < m_size)
+        {
+            getData()[index] = std::move(back());
+        }
+        popBack();
+    }
+
+    template<typename T>
+    bool SMPVector<T>::resize(size_t size)
+    {
+        bool ret = true;
+        if(size < m_size)
+        {
+            truncate(size);
+        }
+        else if(size > m_size)
+        {
+            ret = reserve(size);
+            if(ret)
+            {
+                if constexpr(std::is_trivially_default_constructible<T>::value && std::is_trivially_copyable<T>::value)
+                {
+                    memset(static_cast<void *>(getData() + m_size), 0, (size - m_size) * sizeof(T));
+                    m_size = size;
+                }
+                else
+                {
+                    for(; m_size < size; ++m_size)
+                    {
+                        new (getData() + m_size) T();
+                    }
+                }
+            }
+        }
+        return ret;
+    }
+
+    template<typename T>
+    void SMPVector<T>::clear()
+    {
+        truncate(0);
+    }
+
+    template<typename T>
+    bool SMPVector<T>::reserve(size_t capacity)
+    {
+        return capacity <= m_capacity || grow(capacity);
+    }
+
+    template<typename T>
+    void SMPVector<T>::shrinkToFit()
+    {
+        if(m_memoryPool && m_buffer.ptr)
+        {
+            if(0 == m_size)
+            {
+                release();
+            }
+            else if(m_memoryPool->resizeMemory(&m_buffer, m_size * sizeof(T)))
+            {
+                m_capacity = m_buffer.size / sizeof(T);
+            }
+        }
+    }
+
+    template<typename T>
+    void SMPVector<T>::truncate(size_t size)
+    {
+        if constexpr(!std::is_trivially_destructible<T>::value)
+        {
+            for(size_t i = size; i < m_size; ++i)
+            {
+                getData()[i].~T();
+            }
+        }
+        m_size = size;
+    }
+
+    template<typename T>
+    void SMPVector<T>::release()
+    {
+        clear();
+        if(m_memoryPool && m_buffer.ptr)
+        {
+            m_memoryPool->freeMemory(&m_buffer);
+        }
+        m_buffer = MemoryBlock();
+        m_capacity = 0;
+    }
+}
@@ -1,65 +1,201 @@
 #include "SimpleFixedMemoryPool.h"
 
 #include <algorithm>
+#include <cstdint>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
 
 namespace SimpleMemoryPool
 {
+    // All zeros is a free and clean block, so the array comes straight from calloc and
+    // its pages are only touched as the high water mark moves up.
+    // Blocks of a run handed back by releaseRun() keep isUsed set while the free runs tree has
+    // them free, they are reset, and cleaned as the zeroing policy asks, by claimRun().
     struct SimpleFixedMemoryPool::MemoryBlockInfo
     {
-        MemoryBlock memoryBlock;
         bool        isUsed;
+        // Written since it was last zeroed, only tracked by the OnAllocate zeroing policy.
+        bool        isDirty;
         long long   id;
-
-        MemoryBlockInfo() : memoryBlock(), isUsed(false), id(0)
-        {}
+#if SMP_HARDENING_ENABLED
+        size_t      requestedSize;
+#endif
     };
 
     SimpleFixedMemoryPool::SimpleFixedMemoryPool(size_t totalSize, size_t blockSize,
-                                                 size_t distributedCount, MemoryDistributionPolicy distributionPolicy)
-        : m_totalSize(totalSize), m_usedSize(0), m_blockSize(blockSize),
-        m_blocksInfo(nullptr), m_startBlockPtr(nullptr), m_lastBlockId(0),
-        m_distributedBlocksCount(distributedCount), m_distributionPolicy(distributionPolicy)
+                                                 size_t distributedCount, MemoryDistributionPolicy distributionPolicy,
+                                                 MemoryZeroingPolicy zeroingPolicy, MemoryColoringPolicy coloringPolicy)
+        : m_totalSize(totalSize), m_usedSize(0), m_blockSize(blockSize), m_blockStride(blockSize),
+        m_lastBlockId(0), m_startBlockPtr(nullptr),
+        m_distributedBlocksCount(distributedCount), m_distributionPolicy(distributionPolicy),
+        m_zeroingPolicy(zeroingPolicy), m_blocksInfo(nullptr), m_traceRecorder(nullptr), m_trimmedPages(nullptr), m_firstPagePtr(nullptr),
+        m_trimmedSize(0), m_autoTrimThreshold(0), m_autoTrimTrigger(0), m_highWaterBlocksCount(0),
+        m_ranges(nullptr), m_rangeGrowthBlocksCount(0), m_rangeMinBlocksCount(0),
+        m_parentPool(nullptr), m_parentRun(), m_quotaSize(0)
     {
+        if(m_blockSize > m_totalSize)
+        {
+            m_blockSize = m_totalSize;
+        }
+        if(0 == m_distributedBlocksCount)
+        {
+            m_distributedBlocksCount = 1;
+        }
+        m_blockStride = m_blockSize;
+        // An odd number of cache lines between block starts walks through every cache set.
+        if(MemoryColoringPolicy::Colored == coloringPolicy && m_blockSize > 0 && 0 == m_blockSize % (2 * CacheLineSize) &&
+           m_blockSize + CacheLineSize <= m_totalSize)
+        {
+            m_blockStride = m_blockSize + CacheLineSize;
+        }
+        m_blocksCount = m_blockStride > 0 ? m_totalSize / m_blockStride : 0;
+        // Too many blocks for the free runs tree leave an empty pool, as a sub-pool without room does.
+        if(m_blocksCount > FreeRunTree::MaxBlocksCount)
+        {
+            printf("COULD NOT TRACK %zu blocks\n", m_blocksCount);
+            m_totalSize = m_blocksCount = 0;
+        }
+        m_freeBlocksCount = m_blocksCount;
         try
         {
-            m_startBlockPtr = calloc(m_totalSize, sizeof(uint8_t));
+            // Only the Never policy may start from uninitialized memory.
+            m_startBlockPtr = MemoryZeroingPolicy::Never == m_zeroingPolicy ?
+                malloc(m_totalSize) : calloc(m_totalSize, sizeof(uint8_t));
         }
         catch(...)
         {
             printf("COULD NOT ALLOCATE %zu memory\n", m_totalSize);
             std::terminate();
         }
+        // Neither the blocks nor their metadata are walked: both come zeroed from calloc,
+        // and the free runs tree marks the whole pool free in O(log n).
+        m_blocksInfo = reinterpret_cast<MemoryBlockInfo *>(calloc(m_blocksCount ? m_blocksCount : 1, sizeof(MemoryBlockInfo)));
+        if(!m_blocksInfo)
+        {
+            printf("COULD NOT ALLOCATE %zu memory\n", m_blocksCount * sizeof(MemoryBlockInfo));
+            std::terminate();
+        }
+        m_freeRuns.reset(m_blocksCount);
+        if(MemoryDistributionPolicy::None != m_distributionPolicy)
+        {
+            m_ranges = new (std::nothrow) MemoryRangeStats[m_distributedBlocksCount];
+            if(!m_ranges)
+            {
+                printf("COULD NOT ALLOCATE %zu memory\n", m_distributedBlocksCount * sizeof(MemoryRangeStats));
+                std::terminate();
+            }
+            // The last range also gets the blocks left over by the division.
+            size_t rangeBlocksCount = m_blocksCount / m_distributedBlocksCount;
+            for(size_t i = 0; i < m_distributedBlocksCount; ++i)
+            {
+                m_ranges[i].firstBlock = i * rangeBlocksCount;
+                m_ranges[i].blocksCount = i + 1 < m_distributedBlocksCount ? rangeBlocksCount : m_blocksCount - i * rangeBlocksCount;
+            }
+            m_rangeGrowthBlocksCount = std::max<size_t>(rangeBlocksCount / 4, 1);
+            m_rangeMinBlocksCount = std::max<size_t>(rangeBlocksCount / 8, 1);
+        }
+#if SMP_HARDENING_ENABLED
+        if(m_startBlockPtr)
+        {
+            memset(m_startBlockPtr, Hardening::FreedPattern, m_totalSize);
+            SMP_POISON_MEMORY(m_startBlockPtr, m_totalSize);
+        }
+#endif
+    }
+
+    // The run holds the blocks first, so they keep the alignment of the parent blocks, then the
+    // blocks metadata and the free runs tree nodes right after it.
+    SimpleFixedMemoryPool::SimpleFixedMemoryPool(SimpleFixedMemoryPool * parentPool, size_t totalSize, size_t blockSize,
+                                                 MemoryZeroingPolicy zeroingPolicy)
+        : m_totalSize(totalSize), m_usedSize(0), m_blockSize(blockSize), m_blockStride(blockSize),
+        m_lastBlockId(0), m_startBlockPtr(nullptr),
+        m_distributedBlocksCount(1), m_distributionPolicy(MemoryDistributionPolicy::None),
+        m_zeroingPolicy(zeroingPolicy), m_blocksInfo(nullptr), m_traceRecorder(nullptr), m_trimmedPages(nullptr), m_firstPagePtr(nullptr),
+        m_trimmedSize(0), m_autoTrimThreshold(0), m_autoTrimTrigger(0), m_highWaterBlocksCount(0),
+        m_ranges(nullptr), m_rangeGrowthBlocksCount(0), m_rangeMinBlocksCount(0),
+        m_parentPool(parentPool), m_parentRun(), m_quotaSize(0)
+    {
         if(m_blockSize > m_totalSize)
         {
             m_blockSize = m_totalSize;
         }
-        if(0 == m_distributedBlocksCount)
+        m_blockStride = m_blockSize;
+        m_blocksCount = m_blockSize > 0 ? m_totalSize / m_blockSize : 0;
+        if(m_blocksCount > FreeRunTree::MaxBlocksCount)
         {
-            m_distributedBlocksCount = 1;
+            printf("COULD NOT TRACK %zu blocks\n", m_blocksCount);
+        }
+        else if(m_parentPool && m_blocksCount > 0)
+        {
+            // The metadata has to start zeroed, and so do the blocks unless the policy is Never.
+            m_parentRun = m_parentPool->allocateZeroed(m_totalSize + alignof(MemoryBlockInfo) - 1 +
+                                                       m_blocksCount * sizeof(MemoryBlockInfo) + FreeRunTree::getStorageSize(m_blocksCount));
+        }
+        if(m_parentRun.ptr)
+        {
+            auto infoPtr = reinterpret_cast<uintptr_t>(m_parentRun.ptr) + m_totalSize;
+            infoPtr = (infoPtr + alignof(MemoryBlockInfo) - 1) & ~(uintptr_t)(alignof(MemoryBlockInfo) - 1);
+            m_startBlockPtr = m_parentRun.ptr;
+            m_blocksInfo = reinterpret_cast<MemoryBlockInfo *>(infoPtr);
+            m_freeRuns.reset(m_blocksCount, m_blocksInfo + m_blocksCount);
         }
-        m_blocksCount = m_freeBlocksCount = m_blockSize > 0 ? m_totalSize / m_blockSize : 0;
-        m_blocksInfo = new MemoryBlockInfo[m_blocksCount];
-        for(int i = 0; i < m_blocksCount; ++i)
+        else
         {
-            m_blocksInfo[i].memoryBlock.ptr = reinterpret_cast<unsigned char *>(m_startBlockPtr) + i * m_blockSize;
-            m_blocksInfo[i].memoryBlock.size = m_blockSize;
-            m_blocksInfo[i].isUsed = false;
+            m_totalSize = m_blocksCount = 0;
+            m_freeRuns.reset(0);
         }
+        m_freeBlocksCount = m_blocksCount;
+#if SMP_HARDENING_ENABLED
+        if(m_startBlockPtr)
+        {
+            memset(m_startBlockPtr, Hardening::FreedPattern, m_totalSize);
+            SMP_POISON_MEMORY(m_startBlockPtr, m_totalSize);
+        }
+#endif
     }
 
     SimpleFixedMemoryPool::~SimpleFixedMemoryPool()
     {
+#if SMP_HARDENING_ENABLED
+        // Releasing a sub-pool with live allocations is how it is meant to be used.
+        if(!m_parentPool)
+        {
+            reportLeaks();
+        }
         if(m_startBlockPtr)
         {
-            free(m_startBlockPtr);
-            m_startBlockPtr = nullptr;
+            SMP_UNPOISON_MEMORY(m_startBlockPtr, m_totalSize);
+        }
+#endif
+        if(m_parentPool)
+        {
+            if(m_parentRun.ptr)
+            {
+                m_parentPool->releaseRun(&m_parentRun);
+            }
         }
-        if(m_blocksInfo)
+        else
         {
-            delete[] m_blocksInfo;
-            m_blocksInfo = nullptr;
+            if(m_startBlockPtr)
+            {
+                free(m_startBlockPtr);
+            }
+            if(m_blocksInfo)
+            {
+                free(m_blocksInfo);
+            }
         }
+        m_startBlockPtr = nullptr;
+        m_blocksInfo = nullptr;
+        if(m_trimmedPages)
+        {
+            free(m_trimmedPages);
+            m_trimmedPages = nullptr;
+        }
+        delete[] m_ranges;
+        m_ranges = nullptr;
     }
 
     size_t SimpleFixedMemoryPool::computeStartingAllocationIndex(size_t requestedBlocksCount) const
@@ -68,109 +204,819 @@ namespace SimpleMemoryPool
         return distributedBlocksSize * ((requestedBlocksCount - 1) / (distributedBlocksSize / m_distributedBlocksCount));
     }
 
+    // Ranges are contiguous and sorted, so the first one ending after i holds it.
+    size_t SimpleFixedMemoryPool::findBlockRange(size_t i) const
+    {
+        size_t first = 0;
+        size_t count = m_distributedBlocksCount;
+        while(count > 0)
+        {
+            size_t half = count / 2;
+            if(m_ranges[first + half].firstBlock + m_ranges[first + half].blocksCount <= i)
+            {
+                first += half + 1;
+                count -= half + 1;
+            }
+            else
+            {
+                count = half;
+            }
+        }
+        return first;
+    }
+
+    // Requests keep the size classes of CloseRanges, the range of a class is searched first and
+    // grown when it misses. Only then the whole pool is searched, trading isolation for success.
+    size_t SimpleFixedMemoryPool::findAdaptiveRun(size_t requestedBlocksCount)
+    {
+        size_t step = std::max<size_t>(m_blocksCount / m_distributedBlocksCount / m_distributedBlocksCount, 1);
+        size_t rangeIndex = std::min((requestedBlocksCount - 1) / step, m_distributedBlocksCount - 1);
+        MemoryRangeStats & range = m_ranges[rangeIndex];
+        size_t ret = m_freeRuns.findFirstFit(requestedBlocksCount, range.firstBlock, range.firstBlock + range.blocksCount);
+        if(FreeRunTree::npos == ret)
+        {
+            ++range.missesCount;
+            if(growRange(rangeIndex, requestedBlocksCount))
+            {
+                ret = m_freeRuns.findFirstFit(requestedBlocksCount, range.firstBlock, range.firstBlock + range.blocksCount);
+            }
+        }
+        if(FreeRunTree::npos == ret)
+        {
+            ret = m_freeRuns.findFirstFit(requestedBlocksCount, 0, m_blocksCount);
+            if(FreeRunTree::npos != ret)
+            {
+                ++range.spillsCount;
+            }
+        }
+        if(FreeRunTree::npos != ret)
+        {
+            ++range.allocationsCount;
+        }
+        return ret;
+    }
+
+    // Moves a boundary over free blocks at the edge of a neighbour, trying the neighbour with
+    // the most free blocks first. A growth step is taken when it is free, else just the request.
+    bool SimpleFixedMemoryPool::growRange(size_t rangeIndex, size_t requestedBlocksCount)
+    {
+        bool ret = false;
+        MemoryRangeStats & range = m_ranges[rangeIndex];
+        MemoryRangeStats * left = rangeIndex > 0 ? &m_ranges[rangeIndex - 1] : nullptr;
+        MemoryRangeStats * right = rangeIndex + 1 < m_distributedBlocksCount ? &m_ranges[rangeIndex + 1] : nullptr;
+        auto freeBlocks = [](const MemoryRangeStats * neighbour) {
+            return neighbour ? neighbour->blocksCount - neighbour->usedBlocksCount : 0;
+        };
+        bool isLeftFirst = freeBlocks(left) > freeBlocks(right);
+        size_t growthsCount[2] = { std::max(requestedBlocksCount, m_rangeGrowthBlocksCount), requestedBlocksCount };
+        for(size_t attempt = 0; !ret && attempt < 4; ++attempt)
+        {
+            size_t count = growthsCount[attempt / 2];
+            bool isLeft = (0 == attempt % 2) == isLeftFirst;
+            MemoryRangeStats * neighbour = isLeft ? left : right;
+            if(neighbour && neighbour->blocksCount >= count + m_rangeMinBlocksCount &&
+               freeBlocks(neighbour) >= count)
+            {
+                size_t first = isLeft ? range.firstBlock - count : range.firstBlock + range.blocksCount;
+                if(m_freeRuns.findFirstFit(count, first, first + count) == first)
+                {
+                    if(isLeft)
+                    {
+                        range.firstBlock -= count;
+                    }
+                    else
+                    {
+                        neighbour->firstBlock += count;
+                    }
+                    range.blocksCount += count;
+                    neighbour->blocksCount -= count;
+                    ++range.growthsCount;
+                    ret = true;
+                }
+            }
+        }
+        return ret;
+    }
+
+    // A run may straddle a boundary after growing in place, each range counts its own part.
+    void SimpleFixedMemoryPool::updateRangesUsage(size_t first, size_t last, bool isUsed)
+    {
+        for(size_t i = findBlockRange(first); first < last && i < m_distributedBlocksCount; ++i)
+        {
+            size_t end = std::min(last, m_ranges[i].firstBlock + m_ranges[i].blocksCount);
+            if(isUsed)
+            {
+                m_ranges[i].usedBlocksCount += end - first;
+            }
+            else
+            {
+                m_ranges[i].usedBlocksCount -= end - first;
+            }
+            first = end;
+        }
+    }
+
+    size_t SimpleFixedMemoryPool::findBlockIndex(const unsigned char * ptr) const
+    {
+        size_t ret = m_blocksCount;
+        auto startPtr = reinterpret_cast<const unsigned char *>(m_startBlockPtr);
+        if(m_blockStride > 0 && ptr >= startPtr)
+        {
+            size_t offset = static_cast<size_t>(ptr - startPtr);
+            if(0 == offset % m_blockStride)
+            {
+                ret = std::min(offset / m_blockStride, m_blocksCount);
+            }
+        }
+        return ret;
+    }
+
     MemoryBlock SimpleFixedMemoryPool::allocateMemory()
     {
+#if SMP_HARDENING_ENABLED
+        // A single block has to hold its red zone too.
+        return allocateRun(m_blockSize > Hardening::RedZoneSize ? m_blockSize - Hardening::RedZoneSize : m_blockSize,
+                           TraceEventType::Allocate);
+#else
+        if(MemoryDistributionPolicy::AdaptiveRanges == m_distributionPolicy)
+        {
+            return allocateRun(m_blockSize, TraceEventType::Allocate);
+        }
         MemoryBlock ret;
-        if(m_freeBlocksCount > 0)
+        uint64_t sampleStart = m_stats.beginSample();
+        if(m_freeBlocksCount > 0 && !isWithinQuota(1))
+        {
+            m_stats.recordQuotaFailure();
+        }
+        else if(m_freeBlocksCount > 0)
         {
-            for(size_t i = 0; i < m_blocksCount; ++i)
+            size_t i = m_freeRuns.findFirstFit(1, 0, m_blocksCount);
+            if(FreeRunTree::npos != i)
             {
-                if(!m_blocksInfo[i].isUsed)
+                ret = MemoryBlock(getBlockPtr(i), m_blockSize);
+                claimRun(i, i + 1, ++m_lastBlockId);
+                m_freeRuns.markUsed(i, i + 1);
+                touchRun(i, i + 1);
+                if(m_ranges)
                 {
-                    ret = m_blocksInfo[i].memoryBlock;
-                    m_blocksInfo[i].isUsed = true;
-                    m_blocksInfo[i].id = ++m_lastBlockId;
-                    m_usedSize += m_blockSize;
-                    m_freeBlocksCount--;
-                    break;
+                    updateRangesUsage(i, i + 1, true);
                 }
+                m_usedSize += m_blockSize;
+                m_freeBlocksCount--;
             }
         }
+        m_stats.recordAllocation(m_blockSize, 1, ret.ptr != nullptr, m_usedSize, sampleStart);
+        if(m_traceRecorder)
+        {
+            m_traceRecorder->record(TraceEventType::Allocate, ret.ptr ? m_lastBlockId : 0, m_blockSize, 1);
+        }
         return ret;
+#endif
     }
 
     MemoryBlock SimpleFixedMemoryPool::allocateMemory(size_t size)
+    {
+        return allocateRun(size, TraceEventType::Allocate);
+    }
+
+    MemoryBlock SimpleFixedMemoryPool::allocateRun(size_t size, TraceEventType eventType)
     {
         MemoryBlock ret;
+        uint64_t sampleStart = m_stats.beginSample();
+#if SMP_HARDENING_ENABLED
+        size_t requestedBlocksCount = (size + Hardening::RedZoneSize + m_blockSize - 1) / m_blockSize;
+#else
         size_t requestedBlocksCount = (size + m_blockSize - 1) / m_blockSize;
+#endif
 
-        if(m_freeBlocksCount >= requestedBlocksCount &&
+        size_t i = FreeRunTree::npos;
+        if(m_freeBlocksCount >= requestedBlocksCount && !isWithinQuota(requestedBlocksCount))
+        {
+            m_stats.recordQuotaFailure();
+        }
+        else if(MemoryDistributionPolicy::AdaptiveRanges == m_distributionPolicy)
+        {
+            if(m_freeBlocksCount >= requestedBlocksCount && requestedBlocksCount > 0)
+            {
+                i = findAdaptiveRun(requestedBlocksCount);
+            }
+        }
+        else if(m_freeBlocksCount >= requestedBlocksCount &&
             (MemoryDistributionPolicy::None == m_distributionPolicy || m_blocksCount/ m_distributedBlocksCount >= requestedBlocksCount))
         {
-            size_t i = 0;
+            size_t first = 0;
             size_t blocksCount = m_blocksCount;
             if(MemoryDistributionPolicy::None != m_distributionPolicy)
             {
-                i = computeStartingAllocationIndex(requestedBlocksCount);
+                first = computeStartingAllocationIndex(requestedBlocksCount);
             }
             if(MemoryDistributionPolicy::CloseRanges == m_distributionPolicy)
             {
-                blocksCount = i + (m_blocksCount /  m_distributedBlocksCount);
-            }
-            while(i < blocksCount && (requestedBlocksCount <= (blocksCount - i)))
-            {
-                bool hasFreeBlocks = false;
-                auto beginPtr = m_blocksInfo + i;
-                auto endPtr = m_blocksInfo + i + requestedBlocksCount;
-                auto it = std::find_if(beginPtr, endPtr, [](MemoryBlockInfo & memInfo) {
-                    return memInfo.isUsed;
-                });
-                hasFreeBlocks = (it == endPtr);
-                if(hasFreeBlocks)
-                {
-                    ret = m_blocksInfo[i].memoryBlock;
-                    ret.size = m_blockSize * requestedBlocksCount;
-                    ++m_lastBlockId;
-                    std::for_each(beginPtr, endPtr, [this](MemoryBlockInfo & memInfo) {
-                        memInfo.isUsed = true;
-                        memInfo.id = m_lastBlockId;
-                    });
-                    m_usedSize += ret.size;
-                    m_freeBlocksCount -= requestedBlocksCount;
-                    break;
+                blocksCount = first + (m_blocksCount /  m_distributedBlocksCount);
+            }
+            i = m_freeRuns.findFirstFit(requestedBlocksCount, first, blocksCount);
+            if(m_ranges)
+            {
+                MemoryRangeStats & range = m_ranges[std::min(findBlockRange(first), m_distributedBlocksCount - 1)];
+                bool isSpill = FreeRunTree::npos != i && i >= range.firstBlock + range.blocksCount;
+                if(FreeRunTree::npos == i || isSpill)
+                {
+                    ++range.missesCount;
                 }
-                ++i;
+                if(isSpill)
+                {
+                    ++range.spillsCount;
+                }
+                if(FreeRunTree::npos != i)
+                {
+                    ++range.allocationsCount;
+                }
+            }
+        }
+        if(FreeRunTree::npos != i)
+        {
+            ret = MemoryBlock(getBlockPtr(i), m_blockSize * requestedBlocksCount);
+            claimRun(i, i + requestedBlocksCount, ++m_lastBlockId);
+            m_freeRuns.markUsed(i, i + requestedBlocksCount);
+            touchRun(i, i + requestedBlocksCount);
+            if(m_ranges)
+            {
+                updateRangesUsage(i, i + requestedBlocksCount, true);
             }
+            m_usedSize += ret.size;
+            m_freeBlocksCount -= requestedBlocksCount;
+#if SMP_HARDENING_ENABLED
+            hardenAllocatedRun(i, requestedBlocksCount, size);
+            ret.size = size;
+#endif
+        }
+        m_stats.recordAllocation(size, requestedBlocksCount, ret.ptr != nullptr, m_usedSize, sampleStart);
+        if(m_traceRecorder)
+        {
+            m_traceRecorder->record(eventType, ret.ptr ? m_lastBlockId : 0, size, requestedBlocksCount);
         }
         return ret;
     }
 
     bool SimpleFixedMemoryPool::freeMemory(MemoryBlock * memoryBlock)
+    {
+        return freeRun(memoryBlock, TraceEventType::Free);
+    }
+
+    bool SimpleFixedMemoryPool::freeRun(MemoryBlock * memoryBlock, TraceEventType eventType)
     {
         bool ret = false;
-        auto endPtr = m_blocksInfo + m_blocksCount;
+        uint64_t sampleStart = m_stats.beginSample();
         if(memoryBlock && memoryBlock->ptr && m_freeBlocksCount != m_blocksCount)
         {
-            auto firstItemIter = std::find_if(m_blocksInfo, endPtr, [memoryBlock] (MemoryBlockInfo & memInfo) {
-                return memInfo.isUsed && memInfo.memoryBlock.ptr == memoryBlock->ptr;
-            });
-            if(firstItemIter != endPtr)
+            size_t first = findBlockIndex(memoryBlock->ptr);
+            if(first < m_blocksCount && isBlockUsed(first))
             {
-                auto id = firstItemIter->id;
-                std::for_each(firstItemIter, endPtr, [&](MemoryBlockInfo & memInfo) {
-                    if (memInfo.id == id)
+                auto id = m_blocksInfo[first].id;
+                size_t last = first;
+#if SMP_HARDENING_ENABLED
+                if(first > 0 && m_blocksInfo[first - 1].id == id)
+                {
+                    Hardening::reportCorruption("free of an interior pointer", id, memoryBlock->ptr);
+                }
+#endif
+                while(last < m_blocksCount && m_blocksInfo[last].id == id)
+                {
+                    m_blocksInfo[last].isUsed = false;
+                    m_blocksInfo[last].isDirty = true;
+                    m_blocksInfo[last].id = 0;
+                    ++last;
+                }
+#if SMP_HARDENING_ENABLED
+                hardenFreedRun(first, last, id);
+#endif
+                m_freeRuns.markFree(first, last);
+                if(m_ranges)
+                {
+                    updateRangesUsage(first, last, false);
+                }
+                if(m_traceRecorder)
+                {
+                    m_traceRecorder->record(eventType, id, memoryBlock->size, last - first);
+                }
+                m_usedSize -= (last - first) * m_blockSize;
+                m_freeBlocksCount += last - first;
+
+#if !SMP_HARDENING_ENABLED
+                zeroFreedRun(first, last);
+#endif
+                autoTrim();
+                memoryBlock->ptr = nullptr;
+                memoryBlock->size = 0;
+
+                ret = true;
+            }
+        }
+        m_stats.recordFree(ret, m_usedSize, sampleStart);
+        return ret;
+    }
+
+    // Hands a whole sub-pool run back in O(log n): only the free runs tree and the counters
+    // change, the blocks keep their metadata and content until claimRun() takes them again.
+    // Hardened builds check the red zone and fill the run with the freed pattern instead.
+    bool SimpleFixedMemoryPool::releaseRun(MemoryBlock * memoryBlock)
+    {
+#if SMP_HARDENING_ENABLED
+        return freeRun(memoryBlock, TraceEventType::Free);
+#else
+        bool ret = false;
+        uint64_t sampleStart = m_stats.beginSample();
+        if(memoryBlock && memoryBlock->ptr)
+        {
+            size_t first = findBlockIndex(memoryBlock->ptr);
+            size_t last = first + (m_blockSize > 0 ? (memoryBlock->size + m_blockSize - 1) / m_blockSize : 0);
+            if(first < last && last <= m_blocksCount && isBlockUsed(first))
+            {
+                m_freeRuns.markFree(first, last);
+                if(m_ranges)
+                {
+                    updateRangesUsage(first, last, false);
+                }
+                if(m_traceRecorder)
+                {
+                    m_traceRecorder->record(TraceEventType::Free, m_blocksInfo[first].id, memoryBlock->size, last - first);
+                }
+                m_usedSize -= (last - first) * m_blockSize;
+                m_freeBlocksCount += last - first;
+                autoTrim();
+                memoryBlock->ptr = nullptr;
+                memoryBlock->size = 0;
+                ret = true;
+            }
+        }
+        m_stats.recordFree(ret, m_usedSize, sampleStart);
+        return ret;
+#endif
+    }
+
+    // Marks blocks just taken from the free runs tree as used by the run id. The ones still
+    // flagged used were released with a whole run, they are cleaned now as freeRun() would have.
+    void SimpleFixedMemoryPool::claimRun(size_t first, size_t last, long long id)
+    {
+        size_t releasedFirst = last;
+        for(size_t i = first; i < last; ++i)
+        {
+            MemoryBlockInfo & memInfo = m_blocksInfo[i];
+            if(memInfo.isUsed)
+            {
+                memInfo.isDirty = true;
+                releasedFirst = std::min(releasedFirst, i);
+            }
+            else if(releasedFirst < i)
+            {
+                zeroFreedRun(releasedFirst, i);
+                releasedFirst = last;
+            }
+            memInfo.isUsed = true;
+            memInfo.id = id;
+        }
+        if(releasedFirst < last)
+        {
+            zeroFreedRun(releasedFirst, last);
+        }
+    }
+
+    bool SimpleFixedMemoryPool::isBlockUsed(size_t i) const
+    {
+        return m_blocksInfo[i].isUsed && !m_freeRuns.isFree(i);
+    }
+
+    bool SimpleFixedMemoryPool::resizeMemory(MemoryBlock * memoryBlock, size_t size)
+    {
+        bool ret = false;
+        long long id = 0;
+#if SMP_HARDENING_ENABLED
+        size_t requestedBlocksCount = (size + Hardening::RedZoneSize + m_blockSize - 1) / m_blockSize;
+#else
+        size_t requestedBlocksCount = m_blockSize > 0 ? (size + m_blockSize - 1) / m_blockSize : 0;
+#endif
+        if(memoryBlock && memoryBlock->ptr && requestedBlocksCount > 0)
+        {
+            size_t first = findBlockIndex(memoryBlock->ptr);
+            if(first < m_blocksCount && isBlockUsed(first) &&
+               (0 == first || m_blocksInfo[first - 1].id != m_blocksInfo[first].id))
+            {
+                id = m_blocksInfo[first].id;
+                size_t last = first;
+                while(last < m_blocksCount && m_blocksInfo[last].id == id)
+                {
+                    ++last;
+                }
+                size_t newLast = first + requestedBlocksCount;
+                if(newLast > last)
+                {
+                    ret = newLast <= m_blocksCount;
+                    if(ret && !isWithinQuota(newLast - last))
                     {
-                        m_usedSize -= m_blockSize;
-                        memInfo.isUsed = false;
-                        memInfo.id = 0;
-                        ++m_freeBlocksCount;
+                        m_stats.recordQuotaFailure();
+                        ret = false;
                     }
-                    else
+                    ret = ret && m_freeRuns.findFirstFit(newLast - last, last, newLast) == last;
+                    if(ret)
                     {
-                        return;
+                        claimRun(last, newLast, id);
+                        m_freeRuns.markUsed(last, newLast);
+                        touchRun(last, newLast);
+                        if(m_ranges)
+                        {
+                            updateRangesUsage(last, newLast, true);
+                        }
+                        m_usedSize += (newLast - last) * m_blockSize;
+                        m_freeBlocksCount -= newLast - last;
                     }
-                });
-                
-                memset(memoryBlock->ptr, 0, memoryBlock->size);
-                memoryBlock->ptr = nullptr;
-                memoryBlock->size = 0;
+                }
+                else
+                {
+                    for(size_t i = newLast; i < last; ++i)
+                    {
+                        m_blocksInfo[i].isUsed = false;
+                        m_blocksInfo[i].isDirty = true;
+                        m_blocksInfo[i].id = 0;
+                    }
+                    if(newLast < last)
+                    {
+                        m_freeRuns.markFree(newLast, last);
+                        if(m_ranges)
+                        {
+                            updateRangesUsage(newLast, last, false);
+                        }
+#if !SMP_HARDENING_ENABLED
+                        zeroFreedRun(newLast, last);
+#endif
+                    }
+                    m_usedSize -= (last - newLast) * m_blockSize;
+                    m_freeBlocksCount += last - newLast;
+                    autoTrim();
+                    ret = true;
+                }
+                if(ret)
+                {
+#if SMP_HARDENING_ENABLED
+                    hardenResizedRun(first, last, newLast, id, size);
+                    memoryBlock->size = size;
+#else
+                    memoryBlock->size = requestedBlocksCount * m_blockSize;
+#endif
+                }
+            }
+        }
+        m_stats.recordResize(ret, m_usedSize);
+        if(m_traceRecorder)
+        {
+            m_traceRecorder->record(TraceEventType::Resize, ret ? id : 0, size, requestedBlocksCount);
+        }
+        return ret;
+    }
 
-                ret = true;
+    MemoryBlock SimpleFixedMemoryPool::allocateZeroed(size_t size)
+    {
+        MemoryBlock ret = allocateRun(size, TraceEventType::Allocate);
+        zeroAllocatedRun(ret);
+        return ret;
+    }
+
+    void SimpleFixedMemoryPool::zeroAllocatedRun(const MemoryBlock & memoryBlock)
+    {
+#if !SMP_HARDENING_ENABLED
+        if(memoryBlock.ptr)
+        {
+            if(MemoryZeroingPolicy::Never == m_zeroingPolicy)
+            {
+                memset(memoryBlock.ptr, 0, memoryBlock.size);
+            }
+            else if(MemoryZeroingPolicy::OnAllocate == m_zeroingPolicy)
+            {
+                size_t first = findBlockIndex(memoryBlock.ptr);
+                zeroDirtyBlocks(first, first + (memoryBlock.size + m_blockSize - 1) / m_blockSize);
             }
         }
+#else
+        (void)memoryBlock;
+#endif
+    }
+
+    size_t SimpleFixedMemoryPool::trim(MemoryTrimMode trimMode)
+    {
+        size_t ret = 0;
+#if !SMP_HARDENING_ENABLED
+        size_t highWaterBlocksCount = m_highWaterBlocksCount.load(std::memory_order_relaxed);
+        if(m_freeBlocksCount > 0 && highWaterBlocksCount > 0)
+        {
+            // Pages above the high water mark were never touched, there is nothing to give back.
+            size_t i = allocateTrimmedPages() ? 0 : highWaterBlocksCount;
+            while(i < highWaterBlocksCount)
+            {
+                if(isBlockUsed(i))
+                {
+                    ++i;
+                }
+                else
+                {
+                    size_t last = i + 1;
+                    while(last < highWaterBlocksCount && !isBlockUsed(last))
+                    {
+                        ++last;
+                    }
+                    ret += trimFreeRun(i, last, trimMode);
+                    i = last;
+                }
+            }
+        }
+#else
+        (void)trimMode;
+#endif
+        m_stats.recordTrim(ret);
         return ret;
     }
 
+    // The released pages map is only paid for by pools that give pages back.
+    bool SimpleFixedMemoryPool::allocateTrimmedPages()
+    {
+        if(!m_trimmedPages)
+        {
+            size_t pageSize = getSystemPageSize();
+            auto startPtr = reinterpret_cast<uintptr_t>(m_startBlockPtr);
+            auto endPtr = startPtr + m_blocksCount * m_blockStride;
+            m_firstPagePtr = reinterpret_cast<unsigned char *>(startPtr & ~(uintptr_t)(pageSize - 1));
+            m_trimmedPages = reinterpret_cast<unsigned char *>(
+                calloc((endPtr - (startPtr & ~(uintptr_t)(pageSize - 1)) + pageSize - 1) / pageSize, 1));
+        }
+        return nullptr != m_trimmedPages;
+    }
+
+    // Releases the pages lying entirely inside [first, last), skipping the ones already released.
+    size_t SimpleFixedMemoryPool::trimFreeRun(size_t first, size_t last, MemoryTrimMode trimMode)
+    {
+        size_t ret = 0;
+        size_t pageSize = getSystemPageSize();
+        auto startPtr = reinterpret_cast<unsigned char *>(m_startBlockPtr);
+        auto beginPtr = reinterpret_cast<uintptr_t>(getBlockPtr(first));
+        auto endPtr = reinterpret_cast<uintptr_t>(getBlockPtr(last));
+        auto ptr = reinterpret_cast<unsigned char *>((beginPtr + pageSize - 1) & ~(uintptr_t)(pageSize - 1));
+        auto pagesEnd = reinterpret_cast<unsigned char *>(endPtr & ~(uintptr_t)(pageSize - 1));
+        size_t page = ptr < pagesEnd ? static_cast<size_t>(ptr - m_firstPagePtr) / pageSize : 0;
+        while(ptr < pagesEnd)
+        {
+            while(ptr < pagesEnd && m_trimmedPages[page])
+            {
+                ptr += pageSize;
+                ++page;
+            }
+            unsigned char * spanPtr = ptr;
+            size_t spanPage = page;
+            while(ptr < pagesEnd && !m_trimmedPages[page])
+            {
+                ptr += pageSize;
+                ++page;
+            }
+            if(spanPtr < ptr && releaseMemoryPages(spanPtr, ptr - spanPtr, trimMode))
+            {
+                memset(m_trimmedPages + spanPage, 1, page - spanPage);
+                ret += ptr - spanPtr;
+                if(MemoryZeroingPolicy::OnAllocate == m_zeroingPolicy && MemoryTrimMode::Release == trimMode)
+                {
+                    // Released pages read back as zeros, the blocks inside them are clean again.
+                    size_t cleanFirst = (spanPtr - startPtr + m_blockStride - 1) / m_blockStride;
+                    size_t cleanLast = (ptr - startPtr) / m_blockStride;
+                    for(size_t i = cleanFirst; i < cleanLast; ++i)
+                    {
+                        m_blocksInfo[i].isDirty = false;
+                    }
+                }
+            }
+        }
+        m_trimmedSize.store(m_trimmedSize.load(std::memory_order_relaxed) + ret, std::memory_order_relaxed);
+        return ret;
+    }
+
+    // Pages dropped by bulk zeroing from ptr on are no longer resident either, they are accounted
+    // as released so that touchRun() counts them back once the blocks inside are allocated again.
+    void SimpleFixedMemoryPool::recordDroppedPages(unsigned char * ptr, size_t size)
+    {
+        if(size > 0 && allocateTrimmedPages())
+        {
+            size_t pageSize = getSystemPageSize();
+            size_t droppedSize = 0;
+            size_t firstPage = (static_cast<size_t>(ptr - m_firstPagePtr) + pageSize - 1) / pageSize;
+            for(size_t page = firstPage; page < firstPage + size / pageSize; ++page)
+            {
+                if(!m_trimmedPages[page])
+                {
+                    m_trimmedPages[page] = 1;
+                    droppedSize += pageSize;
+                }
+            }
+            m_trimmedSize.store(m_trimmedSize.load(std::memory_order_relaxed) + droppedSize, std::memory_order_relaxed);
+        }
+    }
+
+    // Allocated blocks are about to be written: they raise the high water mark and
+    // their pages count as resident again.
+    void SimpleFixedMemoryPool::touchRun(size_t first, size_t last)
+    {
+        if(last > m_highWaterBlocksCount.load(std::memory_order_relaxed))
+        {
+            m_highWaterBlocksCount.store(last, std::memory_order_relaxed);
+        }
+        if(m_trimmedSize.load(std::memory_order_relaxed) > 0)
+        {
+            size_t pageSize = getSystemPageSize();
+            size_t firstPage = static_cast<size_t>(getBlockPtr(first) - m_firstPagePtr) / pageSize;
+            size_t lastPage = static_cast<size_t>(getBlockPtr(last) - 1 - m_firstPagePtr) / pageSize;
+            size_t untrimmedSize = 0;
+            for(size_t page = firstPage; page <= lastPage; ++page)
+            {
+                if(m_trimmedPages[page])
+                {
+                    m_trimmedPages[page] = 0;
+                    untrimmedSize += pageSize;
+                }
+            }
+            m_trimmedSize.store(m_trimmedSize.load(std::memory_order_relaxed) - untrimmedSize, std::memory_order_relaxed);
+        }
+    }
+
+    // The next automatic trim waits for another threshold of resident free bytes, so
+    // a pool whose free runs are too fragmented to release pages is not walked on every free.
+    void SimpleFixedMemoryPool::autoTrim()
+    {
+        if(m_autoTrimThreshold)
+        {
+            size_t residentFreeSize = getResidentFreeSize();
+            if(residentFreeSize >= m_autoTrimTrigger)
+            {
+                trim();
+                residentFreeSize = getResidentFreeSize();
+                m_autoTrimTrigger = residentFreeSize + m_autoTrimThreshold;
+            }
+        }
+    }
+
+    void SimpleFixedMemoryPool::setAutoTrimThreshold(size_t freeSize)
+    {
+        m_autoTrimThreshold = freeSize;
+        m_autoTrimTrigger = freeSize;
+    }
+
+    size_t SimpleFixedMemoryPool::getAutoTrimThreshold() const
+    {
+        return m_autoTrimThreshold;
+    }
+
+    size_t SimpleFixedMemoryPool::getResidentSize() const
+    {
+        return m_highWaterBlocksCount.load(std::memory_order_relaxed) * m_blockStride - m_trimmedSize.load(std::memory_order_relaxed);
+    }
+
+    // Free blocks above the high water mark were never touched, only the ones below count.
+    size_t SimpleFixedMemoryPool::getResidentFreeSize() const
+    {
+        size_t usedBlocksCount = m_blocksCount - m_freeBlocksCount;
+        return (m_highWaterBlocksCount.load(std::memory_order_relaxed) - usedBlocksCount) * m_blockStride -
+               m_trimmedSize.load(std::memory_order_relaxed);
+    }
+
+    size_t SimpleFixedMemoryPool::getHighWaterBlocksCount() const
+    {
+        return m_highWaterBlocksCount.load(std::memory_order_relaxed);
+    }
+
+    void SimpleFixedMemoryPool::setQuotaSize(size_t quotaSize)
+    {
+        m_quotaSize = quotaSize;
+    }
+
+    size_t SimpleFixedMemoryPool::getQuotaSize() const
+    {
+        return m_quotaSize;
+    }
+
+    SimpleFixedMemoryPool * SimpleFixedMemoryPool::getParentPool() const
+    {
+        return m_parentPool;
+    }
+
+    // Whole strides are cleared, with their coloring gap: a run shrunk in place may have written
+    // over the gaps of the blocks it kept.
+    void SimpleFixedMemoryPool::zeroFreedRun(size_t first, size_t last)
+    {
+        unsigned char * ptr = getBlockPtr(first);
+        size_t runSize = (last - first) * m_blockStride;
+        switch(m_zeroingPolicy)
+        {
+        case MemoryZeroingPolicy::OnFree:
+            memset(ptr, 0, runSize);
+            break;
+        case MemoryZeroingPolicy::OnFreeBulk:
+            recordDroppedPages(ptr, zeroMemoryInBulk(ptr, runSize));
+            break;
+        default:
+            break;
+        }
+    }
+
+    void SimpleFixedMemoryPool::zeroDirtyBlocks(size_t first, size_t last)
+    {
+        size_t i = first;
+        while(i < last)
+        {
+            if(m_blocksInfo[i].isDirty)
+            {
+                size_t dirtyEnd = i;
+                while(dirtyEnd < last && m_blocksInfo[dirtyEnd].isDirty)
+                {
+                    m_blocksInfo[dirtyEnd].isDirty = false;
+                    ++dirtyEnd;
+                }
+                memset(getBlockPtr(i), 0, (dirtyEnd - i) * m_blockStride);
+                i = dirtyEnd;
+            }
+            else
+            {
+                ++i;
+            }
+        }
+    }
+
+#if SMP_HARDENING_ENABLED
+    void SimpleFixedMemoryPool::hardenAllocatedRun(size_t first, size_t blocksCount, size_t requestedSize)
+    {
+        unsigned char * ptr = getBlockPtr(first);
+        size_t runSize = blocksCount * m_blockSize;
+        SMP_UNPOISON_MEMORY(ptr, runSize);
+        if(!Hardening::hasPattern(ptr, runSize, Hardening::FreedPattern))
+        {
+            Hardening::reportCorruption("write after free detected on reuse", m_blocksInfo[first].id, ptr);
+        }
+        memset(ptr, 0, requestedSize);
+        memset(ptr + requestedSize, Hardening::CanaryPattern, runSize - requestedSize);
+        SMP_POISON_MEMORY(ptr + requestedSize, runSize - requestedSize);
+        m_blocksInfo[first].requestedSize = requestedSize;
+    }
+
+    void SimpleFixedMemoryPool::hardenFreedRun(size_t first, size_t last, long long id)
+    {
+        unsigned char * ptr = getBlockPtr(first);
+        size_t runSize = (last - first) * m_blockSize;
+        size_t requestedSize = m_blocksInfo[first].requestedSize;
+        SMP_UNPOISON_MEMORY(ptr, runSize);
+        if(!Hardening::hasPattern(ptr + requestedSize, runSize - requestedSize, Hardening::CanaryPattern))
+        {
+            Hardening::reportCorruption("red zone overwritten", id, ptr);
+        }
+        memset(ptr, Hardening::FreedPattern, runSize);
+        SMP_POISON_MEMORY(ptr, runSize);
+        m_blocksInfo[first].requestedSize = 0;
+    }
+
+    void SimpleFixedMemoryPool::hardenResizedRun(size_t first, size_t last, size_t newLast, long long id, size_t requestedSize)
+    {
+        unsigned char * ptr = getBlockPtr(first);
+        size_t runSize = (last - first) * m_blockSize;
+        size_t newRunSize = (newLast - first) * m_blockSize;
+        size_t oldRequestedSize = m_blocksInfo[first].requestedSize;
+        SMP_UNPOISON_MEMORY(ptr, std::max(runSize, newRunSize));
+        if(!Hardening::hasPattern(ptr + oldRequestedSize, runSize - oldRequestedSize, Hardening::CanaryPattern))
+        {
+            Hardening::reportCorruption("red zone overwritten", id, ptr);
+        }
+        if(newRunSize > runSize && !Hardening::hasPattern(ptr + runSize, newRunSize - runSize, Hardening::FreedPattern))
+        {
+            Hardening::reportCorruption("write after free detected on reuse", id, ptr);
+        }
+        if(newRunSize < runSize)
+        {
+            memset(ptr + newRunSize, Hardening::FreedPattern, runSize - newRunSize);
+            SMP_POISON_MEMORY(ptr + newRunSize, runSize - newRunSize);
+        }
+        if(requestedSize > oldRequestedSize)
+        {
+            memset(ptr + oldRequestedSize, 0, requestedSize - oldRequestedSize);
+        }
+        memset(ptr + requestedSize, Hardening::CanaryPattern, newRunSize - requestedSize);
+        SMP_POISON_MEMORY(ptr + requestedSize, newRunSize - requestedSize);
+        m_blocksInfo[first].requestedSize = requestedSize;
+    }
+
+    void SimpleFixedMemoryPool::reportLeaks() const
+    {
+        size_t highWaterBlocksCount = m_highWaterBlocksCount.load(std::memory_order_relaxed);
+        for(size_t i = 0; i < highWaterBlocksCount; ++i)
+        {
+            if(m_blocksInfo[i].isUsed && (0 == i || m_blocksInfo[i - 1].id != m_blocksInfo[i].id))
+            {
+                fprintf(stderr, "SimpleMemoryPool : leaked allocation id %lld at %p, %zu bytes\n",
+                        m_blocksInfo[i].id, getBlockPtr(i), m_blocksInfo[i].requestedSize);
+            }
+        }
+    }
+#endif
+
     size_t  SimpleFixedMemoryPool::getMemoryTotalSize() const
     {
         return m_totalSize;
@@ -186,6 +1032,18 @@ namespace SimpleMemoryPool
         return m_blockSize;
     }
 
+    size_t SimpleFixedMemoryPool::getMemoryBlockStride() const
+    {
+        return m_blockStride;
+    }
+
+    bool SimpleFixedMemoryPool::containsMemory(const void * ptr) const
+    {
+        auto startPtr = reinterpret_cast<const unsigned char *>(m_startBlockPtr);
+        auto bytePtr = reinterpret_cast<const unsigned char *>(ptr);
+        return startPtr && bytePtr >= startPtr && bytePtr < startPtr + m_blocksCount * m_blockStride;
+    }
+
     size_t SimpleFixedMemoryPool::getMemoryBlocksCount() const
     {
         return m_blocksCount;
@@ -201,6 +1059,110 @@ namespace SimpleMemoryPool
         return m_blocksCount - m_freeBlocksCount;
     }
 
+    MemoryZeroingPolicy SimpleFixedMemoryPool::getZeroingPolicy() const
+    {
+        return m_zeroingPolicy;
+    }
+
+    MemoryPoolStats SimpleFixedMemoryPool::getStats() const
+    {
+        MemoryPoolStats ret;
+        ret.totalSize = m_totalSize;
+        ret.blockSize = m_blockSize;
+        ret.blocksCount = m_blocksCount;
+        ret.reservedSize = m_totalSize;
+        ret.residentSize = getResidentSize();
+        m_stats.fill(ret);
+        ret.usedBlocksCount = m_blockSize > 0 ? ret.usedSize / m_blockSize : 0;
+        return ret;
+    }
+
+    void SimpleFixedMemoryPool::resetStats()
+    {
+        m_stats.reset();
+        for(size_t i = 0; m_ranges && i < m_distributedBlocksCount; ++i)
+        {
+            m_ranges[i].allocationsCount = 0;
+            m_ranges[i].missesCount = 0;
+            m_ranges[i].spillsCount = 0;
+            m_ranges[i].growthsCount = 0;
+        }
+    }
+
+    void SimpleFixedMemoryPool::setLatencySamplingRate(size_t samplingRate)
+    {
+        m_stats.setLatencySamplingRate(samplingRate);
+    }
+
+    size_t SimpleFixedMemoryPool::getLargestFreeRunBlocksCount() const
+    {
+        return m_freeRuns.getLargestFreeRun();
+    }
+
+    size_t SimpleFixedMemoryPool::getFreeRunsCount() const
+    {
+        return m_freeRuns.getFreeRunsCount();
+    }
+
+    MemoryFragmentationStats SimpleFixedMemoryPool::getFragmentationStats() const
+    {
+        MemoryFragmentationStats ret;
+        ret.freeBlocksCount = m_freeBlocksCount;
+        auto addRun = [&ret](size_t run) {
+            size_t bucket = 0;
+            while((run >> bucket) > 1 && bucket < MemoryFragmentationStats::HistogramBucketsCount - 1)
+            {
+                ++bucket;
+            }
+            ++ret.freeRunsHistogram[bucket];
+            ++ret.freeRunsCount;
+            ret.largestFreeRunBlocksCount = std::max(ret.largestFreeRunBlocksCount, run);
+        };
+        size_t highWaterBlocksCount = m_highWaterBlocksCount.load(std::memory_order_relaxed);
+        size_t run = 0;
+        for(size_t i = 0; i < highWaterBlocksCount; ++i)
+        {
+            if(!isBlockUsed(i))
+            {
+                ++run;
+            }
+            else if(run > 0)
+            {
+                addRun(run);
+                run = 0;
+            }
+        }
+        // Everything above the high water mark is free.
+        run += m_blocksCount - highWaterBlocksCount;
+        if(run > 0)
+        {
+            addRun(run);
+        }
+        ret.fragmentationIndex = m_freeBlocksCount > 0 ?
+            1.0 - static_cast<double>(ret.largestFreeRunBlocksCount) / static_cast<double>(m_freeBlocksCount) : 0.0;
+        return ret;
+    }
+
+    size_t SimpleFixedMemoryPool::getDistributionRangesCount() const
+    {
+        return m_ranges ? m_distributedBlocksCount : 0;
+    }
+
+    MemoryRangeStats SimpleFixedMemoryPool::getDistributionRangeStats(size_t range) const
+    {
+        return m_ranges && range < m_distributedBlocksCount ? m_ranges[range] : MemoryRangeStats();
+    }
+
+    void SimpleFixedMemoryPool::setTraceRecorder(AllocationTraceRecorder * traceRecorder)
+    {
+        m_traceRecorder = traceRecorder;
+    }
+
+    AllocationTraceRecorder * SimpleFixedMemoryPool::getTraceRecorder() const
+    {
+        return m_traceRecorder;
+    }
+
     void SimpleFixedMemoryPool::logMemory() const
     {
         printf("================\n");
@@ -217,13 +1179,56 @@ namespace SimpleMemoryPool
             while(offset < sizeof(buffer) && i < getMemoryBlocksCount())
             {
                 offset += snprintf(offset + buffer, sizeof(buffer) - offset,
-                                   "Block[%d] = %s; id = %zu; ptr = %p\n", i, m_blocksInfo[i].isUsed ? "USED" : "FREE", m_blocksInfo[i].id,
-                                   m_blocksInfo[i].isUsed ? m_blocksInfo[i].memoryBlock.ptr : nullptr);
+                                   "Block[%d] = %s; id = %zu; ptr = %p\n", i, isBlockUsed(i) ? "USED" : "FREE", m_blocksInfo[i].id,
+                                   isBlockUsed(i) ? getBlockPtr(i) : nullptr);
                 ++i;
             }
             --i;
             printf("%s\n", buffer);
         }
     }
-}
 
+    void SimpleFixedMemoryPool::logStats() const
+    {
+        MemoryPoolStats stats = getStats();
+        printf("================\n");
+        printf("Total Memory size : %zu, usedSize Mem : %zu, peak usedSize Mem : %zu\n",
+               stats.totalSize, stats.usedSize, stats.peakUsedSize);
+        printf("Allocations : %zu, Allocation failures : %zu, Frees : %zu, Free failures : %zu\n",
+               stats.allocationsCount, stats.allocationFailuresCount, stats.freesCount, stats.freeFailuresCount);
+        printf("Resizes : %zu, Resize failures : %zu\n", stats.resizesCount, stats.resizeFailuresCount);
+        if(m_quotaSize || stats.quotaFailuresCount)
+        {
+            printf("Quota : %zu, Quota failures : %zu\n", m_quotaSize, stats.quotaFailuresCount);
+        }
+        printf("Reserved : %zu, Resident : %zu, Trims : %zu, Released : %zu\n",
+               stats.reservedSize, stats.residentSize, stats.trimsCount, stats.releasedSize);
+        if(stats.allocateLatencySamplesCount)
+        {
+            printf("Allocate latency avg : %llu, max : %llu\n",
+                   (unsigned long long)(stats.allocateLatencyTotal / stats.allocateLatencySamplesCount),
+                   (unsigned long long)stats.allocateLatencyMax);
+        }
+        if(stats.freeLatencySamplesCount)
+        {
+            printf("Free latency avg : %llu, max : %llu\n",
+                   (unsigned long long)(stats.freeLatencyTotal / stats.freeLatencySamplesCount),
+                   (unsigned long long)stats.freeLatencyMax);
+        }
+        for(size_t i = 0; i < getDistributionRangesCount(); ++i)
+        {
+            printf("Range[%zu] : blocks [%zu, %zu); used = %zu; allocations = %zu; misses = %zu; spills = %zu; growths = %zu\n",
+                   i, m_ranges[i].firstBlock, m_ranges[i].firstBlock + m_ranges[i].blocksCount, m_ranges[i].usedBlocksCount,
+                   m_ranges[i].allocationsCount, m_ranges[i].missesCount, m_ranges[i].spillsCount, m_ranges[i].growthsCount);
+        }
+        printf("================\n");
+        for(size_t i = 0; i < MemoryPoolStats::HistogramBucketsCount; ++i)
+        {
+            if(stats.requestedSizeHistogram[i] || stats.blocksCountHistogram[i])
+            {
+                printf("Bucket[< %zu] : requested sizes = %zu; blocks counts = %zu\n",
+                       (size_t)1 << i, stats.requestedSizeHistogram[i], stats.blocksCountHistogram[i]);
+            }
+        }
+    }
+}
\ No newline at end of file
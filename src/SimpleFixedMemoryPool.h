@@ -1,9 +1,18 @@
 ﻿#pragma once
 
-#include <utility>
+#include <atomic>
+#include <cstring>
+#include <iterator>
 #include <new>
+#include <type_traits>
+#include <utility>
 
 #include "MemoryBlock.h"
+#include "MemoryPoolStats.h"
+#include "FreeRunTree.h"
+#include "AllocationTrace.h"
+#include "MemoryHardening.h"
+#include "MemoryZeroing.h"
 
 namespace SimpleMemoryPool
 {
@@ -11,7 +20,22 @@ namespace SimpleMemoryPool
     {
         None,
         CloseRanges,
-        OpenRanges
+        OpenRanges,
+        // Starts as CloseRanges. A range missing room takes the free blocks at the edge of a
+        // neighbour by moving their boundary, live allocations never move.
+        AdaptiveRanges
+    };
+
+    // Where the blocks start in the pool memory.
+    //  Packed  : back to back, block i starts at i * blockSize.
+    //  Colored : when blockSize is an even number of cache lines, blocks are spaced one more
+    //            cache line apart, so the same field of consecutive blocks falls in different
+    //            cache sets, like slab coloring does across slabs. The pool holds fewer blocks
+    //            for the same total size, and a run stays contiguous.
+    enum class MemoryColoringPolicy
+    {
+        Packed,
+        Colored
     };
 
     class SimpleFixedMemoryPool
@@ -19,20 +43,86 @@ namespace SimpleMemoryPool
         size_t                      m_totalSize;
         size_t                      m_usedSize;
         size_t                      m_blockSize;
+        // Distance between two block starts, blockSize unless the pool is colored.
+        size_t                      m_blockStride;
         size_t                      m_freeBlocksCount;
         size_t                      m_blocksCount;
         size_t                      m_lastBlockId;
         void *                      m_startBlockPtr;
         size_t                      m_distributedBlocksCount;
         MemoryDistributionPolicy    m_distributionPolicy;
+        MemoryZeroingPolicy         m_zeroingPolicy;
 
         struct MemoryBlockInfo;
         MemoryBlockInfo * m_blocksInfo;
+        MemoryPoolStatsCollector m_stats;
+        FreeRunTree m_freeRuns;
+        AllocationTraceRecorder * m_traceRecorder;
+        // One flag per page of the pool memory, set while the page is given back by trim.
+        unsigned char *             m_trimmedPages;
+        unsigned char *             m_firstPagePtr;
+        std::atomic<size_t>         m_trimmedSize;
+        size_t                      m_autoTrimThreshold;
+        size_t                      m_autoTrimTrigger;
+        // Blocks at or above it have never been allocated, neither they nor their metadata were touched.
+        // Atomic since getStats() reads it from other threads, only the pool thread writes it.
+        std::atomic<size_t>         m_highWaterBlocksCount;
+        // One entry per distribution range, null with MemoryDistributionPolicy::None.
+        MemoryRangeStats *          m_ranges;
+        // Blocks a range takes from a neighbour at once, and the least it leaves to it.
+        size_t                      m_rangeGrowthBlocksCount;
+        size_t                      m_rangeMinBlocksCount;
+        // Set for a sub-pool: the blocks, their metadata and the free runs tree all live in
+        // m_parentRun, a single run of the parent.
+        SimpleFixedMemoryPool *     m_parentPool;
+        MemoryBlock                 m_parentRun;
+        size_t                      m_quotaSize;
 
         size_t computeStartingAllocationIndex(size_t requestedBlocksCount) const;
+        size_t findBlockRange(size_t i) const;
+        size_t findAdaptiveRun(size_t requestedBlocksCount);
+        bool growRange(size_t range, size_t requestedBlocksCount);
+        void updateRangesUsage(size_t first, size_t last, bool isUsed);
+        size_t findBlockIndex(const unsigned char * ptr) const;
+        unsigned char * getBlockPtr(size_t i) const { return reinterpret_cast<unsigned char *>(m_startBlockPtr) + i * m_blockStride; }
+        MemoryBlock allocateRun(size_t size, TraceEventType eventType);
+        bool freeRun(MemoryBlock * memoryBlock, TraceEventType eventType);
+        bool releaseRun(MemoryBlock * memoryBlock);
+        void claimRun(size_t first, size_t last, long long id);
+        bool isBlockUsed(size_t i) const;
+        void zeroFreedRun(size_t first, size_t last);
+        void zeroDirtyBlocks(size_t first, size_t last);
+        void zeroAllocatedRun(const MemoryBlock & memoryBlock);
+        bool allocateTrimmedPages();
+        size_t trimFreeRun(size_t first, size_t last, MemoryTrimMode trimMode);
+        void recordDroppedPages(unsigned char * ptr, size_t size);
+        void touchRun(size_t first, size_t last);
+        void autoTrim();
+        size_t getResidentFreeSize() const;
+        bool isWithinQuota(size_t blocksCount) const { return 0 == m_quotaSize || m_usedSize + blocksCount * m_blockSize <= m_quotaSize; }
+        template<typename T>
+        static void destroyElements(T * ptr, size_t count);
+#if SMP_HARDENING_ENABLED
+        void hardenAllocatedRun(size_t first, size_t blocksCount, size_t requestedSize);
+        void hardenFreedRun(size_t first, size_t last, long long id);
+        void hardenResizedRun(size_t first, size_t last, size_t newLast, long long id, size_t requestedSize);
+        void reportLeaks() const;
+#endif
     public:
+        static constexpr size_t CacheLineSize = 64;
+
+        // The zeroing policy decides whether allocations come back zeroed, see MemoryZeroingPolicy.
+        // Hardened builds ignore it: they always zero the requested bytes on allocation.
         SimpleFixedMemoryPool(size_t totalSize, size_t chunckSize,
-                              size_t distributedCount = 1, MemoryDistributionPolicy distributionPolicy = MemoryDistributionPolicy::None);
+                              size_t distributedCount = 1, MemoryDistributionPolicy distributionPolicy = MemoryDistributionPolicy::None,
+                              MemoryZeroingPolicy zeroingPolicy = MemoryZeroingPolicy::OnFree,
+                              MemoryColoringPolicy coloringPolicy = MemoryColoringPolicy::Packed);
+        // Sub-pool carved from one run of parentPool, with its own block size and stats. It never
+        // calls the system allocator, and its destruction hands the whole run back in O(log n),
+        // whatever is still allocated in it. The parent has to outlive it. When the parent
+        // has no room the sub-pool is empty and getMemoryTotalSize() returns 0.
+        SimpleFixedMemoryPool(SimpleFixedMemoryPool * parentPool, size_t totalSize, size_t chunckSize,
+                              MemoryZeroingPolicy zeroingPolicy = MemoryZeroingPolicy::OnFree);
         ~SimpleFixedMemoryPool();
 
         SimpleFixedMemoryPool(const SimpleFixedMemoryPool &) = delete;
@@ -43,32 +133,88 @@ namespace SimpleMemoryPool
         MemoryBlock allocateMemory();
         MemoryBlock allocateMemory(size_t size);
         bool freeMemory(MemoryBlock * memoryBlock);
+        // Grows or shrinks a run without moving it, growing only succeeds when the blocks
+        // right after the run are free. A failed resize leaves the run untouched.
+        bool resizeMemory(MemoryBlock * memoryBlock, size_t size);
+        // Zeroed whatever the zeroing policy is, only the OnAllocate and Never policies pay for it here.
+        MemoryBlock allocateZeroed(size_t size);
+
+        // Gives the whole pages inside free runs back to the OS and returns how many bytes.
+        // They fault back in when their blocks are allocated again, zeroed with the Release
+        // mode. Walks every block, meant for idle times. Hardened builds never trim.
+        size_t trim(MemoryTrimMode trimMode = MemoryTrimMode::Release);
+        // Frees trim the pool once that many free bytes are resident again, 0 disables it.
+        void setAutoTrimThreshold(size_t freeSize);
+        size_t getAutoTrimThreshold() const;
+        // Pool memory touched so far, up to the high water mark, minus what trim gave back.
+        size_t getResidentSize() const;
+        // Blocks below it have been allocated at least once, the pool starts at 0.
+        size_t getHighWaterBlocksCount() const;
+
+        // Allocations and resizes fail once they would take the used size over quotaSize,
+        // 0 removes the quota. Lowering it under the used size frees nothing.
+        void setQuotaSize(size_t quotaSize);
+        size_t getQuotaSize() const;
+        // Null unless the pool is a sub-pool.
+        SimpleFixedMemoryPool * getParentPool() const;
 
         template<typename T, class ... Args>
         T * construct(Args && ... args);
         template<typename T>
         bool destruct(T ** ptr);
 
+        // Every element is built from the same args. Trivial types are filled in bulk, and if
+        // a constructor throws the built elements are destroyed and the run freed before rethrowing.
         template<typename T, class ... Args>
         ArrayBlock<T> constructArray(size_t count, Args && ... args);
+        // Copies a forward range, with a single memcpy for contiguous trivially copyable elements.
+        template<typename T, class ForwardIt,
+                 class = std::enable_if_t<std::is_base_of<std::forward_iterator_tag,
+                                                          typename std::iterator_traits<ForwardIt>::iterator_category>::value>>
+        ArrayBlock<T> constructArray(ForwardIt first, ForwardIt last);
         template<typename T>
         bool destructArray(ArrayBlock<T> * ptr);
 
         size_t getMemoryTotalSize() const;
         size_t getMemoryUsedSize() const;
         size_t getMemoryBlockSize() const;
+        size_t getMemoryBlockStride() const;
         size_t getMemoryBlocksCount() const;
         size_t getFreeMemoryBlocksCount() const;
         size_t getUsedMemoryBlocksCount() const;
+        MemoryZeroingPolicy getZeroingPolicy() const;
+        // True when ptr points inside the pool memory, used or not.
+        bool containsMemory(const void * ptr) const;
+
+        // Cheap to call from another thread, the counters are left at zero when
+        // the pool is built with SMP_STATS_ENABLED=0.
+        MemoryPoolStats getStats() const;
+        void resetStats();
+        void setLatencySamplingRate(size_t samplingRate);
+
+        // Longest run of contiguous free blocks and number of free runs, both O(1).
+        size_t getLargestFreeRunBlocksCount() const;
+        size_t getFreeRunsCount() const;
+        // Walks every block to build the run length distribution, meant for occasional polling.
+        MemoryFragmentationStats getFragmentationStats() const;
+        // Current bounds, occupancy and demand of each distribution range, 0 ranges with
+        // MemoryDistributionPolicy::None. Read them from the thread using the pool.
+        size_t getDistributionRangesCount() const;
+        MemoryRangeStats getDistributionRangeStats(size_t range) const;
+
+        // Events are recorded only while a recorder is attached, nullptr detaches it.
+        void setTraceRecorder(AllocationTraceRecorder * traceRecorder);
+        AllocationTraceRecorder * getTraceRecorder() const;
 
         void logMemory() const;
+        void logStats() const;
     };
 
     template<typename T, class ... Args>
     T * SimpleFixedMemoryPool::construct(Args && ... args)
     {
         T * ret = nullptr;
-        MemoryBlock mem = allocateMemory(sizeof(T));
+        MemoryBlock mem = allocateRun(sizeof(T), TraceEventType::Construct);
         if(mem.ptr)
         {
             ret = new (mem.ptr) T(std::forward<Args>(args)...);
@@ -84,40 +230,108 @@ namespace SimpleMemoryPool
         {
             (*ptr)->~T();
             MemoryBlock memoryBlock((unsigned char *)(*ptr), sizeof(T));
-            ret = freeMemory(&memoryBlock);
+            ret = freeRun(&memoryBlock, TraceEventType::Destruct);
             *ptr = reinterpret_cast<T *>(memoryBlock.ptr);
         }
         return ret;
     }
 
+    template<typename T>
+    void SimpleFixedMemoryPool::destroyElements(T * ptr, size_t count)
+    {
+        if constexpr(!std::is_trivially_destructible<T>::value)
+        {
+            while(count > 0)
+            {
+                ptr[--count].~T();
+            }
+        }
+    }
+
     template<typename T, class ... Args>
     ArrayBlock<T> SimpleFixedMemoryPool::constructArray(size_t count, Args && ... args)
     {
         ArrayBlock<T> ret;
-        MemoryBlock mem = allocateMemory(sizeof(T) * count);
+        MemoryBlock mem = count > 0 ? allocateRun(sizeof(T) * count, TraceEventType::Construct) : MemoryBlock();
         if(mem.ptr)
         {
-            ret.ptr = reinterpret_cast<T *>(mem.ptr);
-            T * elemPtr = nullptr;
-            for(int i = 0; i < count; ++i)
+            T * ptr = reinterpret_cast<T *>(mem.ptr);
+            if constexpr(0 == sizeof...(Args) && std::is_trivially_default_constructible<T>::value &&
+                         std::is_trivially_copyable<T>::value)
+            {
+                // Value initialization of a trivial type is all zeros.
+                zeroAllocatedRun(MemoryBlock(mem.ptr, sizeof(T) * count));
+            }
+            else if constexpr(1 == sizeof...(Args) && (std::is_same<std::decay_t<Args>, T>::value && ...) &&
+                              std::is_trivially_copyable<T>::value)
             {
-                elemPtr = new (ret.ptr + i) T(std::forward<Args>(args)...);
-                if(!elemPtr)
+                // Copy the prototype once, then keep doubling the filled prefix.
+                memcpy(ptr, &args..., sizeof(T));
+                size_t filled = 1;
+                while(filled < count)
                 {
-                    freeMemory(&mem);
-                    break;
+                    size_t copied = filled < count - filled ? filled : count - filled;
+                    memcpy(ptr + filled, ptr, copied * sizeof(T));
+                    filled += copied;
                 }
             }
-            if(elemPtr)
+            else
             {
-                ret.ptr = reinterpret_cast<T *>(mem.ptr);
-                ret.count = count;
+                size_t i = 0;
+                try
+                {
+                    for(; i < count; ++i)
+                    {
+                        new (ptr + i) T(args...);
+                    }
+                }
+                catch(...)
+                {
+                    destroyElements(ptr, i);
+                    freeRun(&mem, TraceEventType::Destruct);
+                    throw;
+                }
+            }
+            ret.ptr = ptr;
+            ret.count = count;
+        }
+        return ret;
+    }
+
+    template<typename T, class ForwardIt, class>
+    ArrayBlock<T> SimpleFixedMemoryPool::constructArray(ForwardIt first, ForwardIt last)
+    {
+        ArrayBlock<T> ret;
+        size_t count = static_cast<size_t>(std::distance(first, last));
+        MemoryBlock mem = count > 0 ? allocateRun(sizeof(T) * count, TraceEventType::Construct) : MemoryBlock();
+        if(mem.ptr)
+        {
+            T * ptr = reinterpret_cast<T *>(mem.ptr);
+            if constexpr(std::is_pointer<ForwardIt>::value &&
+                         std::is_same<std::remove_cv_t<std::remove_pointer_t<ForwardIt>>, T>::value &&
+                         std::is_trivially_copyable<T>::value)
+            {
+                memcpy(ptr, first, count * sizeof(T));
             }
             else
             {
-                ret.ptr = nullptr;
-                ret.count = 0;
+                size_t i = 0;
+                try
+                {
+                    for(; i < count; ++i, ++first)
+                    {
+                        new (ptr + i) T(*first);
+                    }
+                }
+                catch(...)
+                {
+                    destroyElements(ptr, i);
+                    freeRun(&mem, TraceEventType::Destruct);
+                    throw;
+                }
             }
+            ret.ptr = ptr;
+            ret.count = count;
         }
         return ret;
     }
@@ -128,12 +342,9 @@ namespace SimpleMemoryPool
         bool ret = false;
         if(array->ptr)
         {
-            for(int i = 0; i < array->count; ++i)
-            {
-                (*array)[i].~T();
-            }
+            destroyElements(array->ptr, array->count);
             MemoryBlock memoryBlock((unsigned char *)(array->ptr), array->count * sizeof(T));
-            ret = freeMemory(&memoryBlock);
+            ret = freeRun(&memoryBlock, TraceEventType::Destruct);
             array->ptr = reinterpret_cast<T *>(memoryBlock.ptr);
             array->count = 0;
         }
@@ -0,0 +1,388 @@
+#include "StringSearch.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+// Built for every x86 target and only taken when the CPU reports AVX2.
+#define SMP_HAS_AVX2 1
+#define SMP_TARGET_AVX2 __attribute__((target("avx2")))
+#elif defined(__AVX2__)
+#include <immintrin.h>
+#define SMP_HAS_AVX2 1
+#define SMP_TARGET_AVX2
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SMP_HAS_SSE2 1
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+namespace SimpleMemoryPool
+{
+    namespace
+    {
+        inline unsigned lowestBit(uint32_t mask)
+        {
+#if defined(_MSC_VER) && !defined(__clang__)
+            unsigned long ret;
+            _BitScanForward(&ret, mask);
+            return ret;
+#else
+            return __builtin_ctz(mask);
+#endif
+        }
+
+        inline unsigned highestBit(uint32_t mask)
+        {
+#if defined(_MSC_VER) && !defined(__clang__)
+            unsigned long ret;
+            _BitScanReverse(&ret, mask);
+            return ret;
+#else
+            return 31 - __builtin_clz(mask);
+#endif
+        }
+
+        bool hasAvx2()
+        {
+#if SMP_HAS_AVX2 && (defined(__GNUC__) || defined(__clang__)) && !defined(__AVX2__)
+            static const bool ret = __builtin_cpu_supports("avx2");
+            return ret;
+#elif SMP_HAS_AVX2
+            return true;
+#else
+            return false;
+#endif
+        }
+
+        // The first and the last pattern chars already matched.
+        inline bool matchesAt(const char * str, const char * pattern, size_t patternSize)
+        {
+            return patternSize <= 2 || 0 == memcmp(str + 1, pattern + 1, patternSize - 2);
+        }
+
+        size_t findMismatchScalar(const char * a, const char * b, size_t from, size_t size)
+        {
+            size_t ret = from;
+            while(ret < size && a[ret] == b[ret])
+            {
+                ++ret;
+            }
+            return ret;
+        }
+
+        size_t findStringScalar(const char * str, size_t size, const char * pattern, size_t patternSize, size_t from)
+        {
+            size_t ret = StringNotFound;
+            size_t last = size - patternSize;
+            while(StringNotFound == ret && from <= last)
+            {
+                const char * found = static_cast<const char *>(memchr(str + from, pattern[0], last - from + 1));
+                if(!found)
+                {
+                    break;
+                }
+                size_t position = static_cast<size_t>(found - str);
+                if(0 == memcmp(found, pattern, patternSize))
+                {
+                    ret = position;
+                }
+                from = position + 1;
+            }
+            return ret;
+        }
+
+        // Looks at the candidates [0, candidatesCount), from the last one down.
+        size_t findLastStringScalar(const char * str, const char * pattern, size_t patternSize, size_t candidatesCount)
+        {
+            size_t ret = StringNotFound;
+            for(size_t i = candidatesCount; StringNotFound == ret && i-- > 0;)
+            {
+                if(str[i] == pattern[0] && 0 == memcmp(str + i, pattern, patternSize))
+                {
+                    ret = i;
+                }
+            }
+            return ret;
+        }
+
+        // The vector kernels compare a block of candidate positions against the first and
+        // the last pattern chars at once and only memcmp the positions where both match.
+
+#if SMP_HAS_AVX2
+        SMP_TARGET_AVX2 uint32_t matchMaskAvx2(const char * a, const char * b)
+        {
+            __m256i left = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a));
+            __m256i right = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b));
+            return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(left, right)));
+        }
+
+        SMP_TARGET_AVX2 __m256i candidatesAvx2(const char * str, size_t patternSize, __m256i first, __m256i last)
+        {
+            __m256i blockFirst = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(str));
+            __m256i blockLast = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(str + patternSize - 1));
+            return _mm256_and_si256(_mm256_cmpeq_epi8(first, blockFirst), _mm256_cmpeq_epi8(last, blockLast));
+        }
+
+        SMP_TARGET_AVX2 uint32_t candidatesMaskAvx2(const char * str, size_t patternSize, __m256i first, __m256i last)
+        {
+            return static_cast<uint32_t>(_mm256_movemask_epi8(candidatesAvx2(str, patternSize, first, last)));
+        }
+
+        // True when no position in [str, str + 64) can start the pattern.
+        SMP_TARGET_AVX2 bool hasNoCandidatesAvx2(const char * str, size_t patternSize, __m256i first, __m256i last)
+        {
+            __m256i candidates = _mm256_or_si256(candidatesAvx2(str, patternSize, first, last), candidatesAvx2(str + 32, patternSize, first, last));
+            return _mm256_testz_si256(candidates, candidates);
+        }
+
+        SMP_TARGET_AVX2 bool areEqualAvx2(const char * a, const char * b)
+        {
+            __m256i equal = _mm256_and_si256(
+                _mm256_and_si256(
+                    _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(a)), _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b))),
+                    _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + 32)), _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + 32)))),
+                _mm256_and_si256(
+                    _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + 64)), _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + 64))),
+                    _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + 96)), _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + 96)))));
+            return 0xFFFFFFFF == static_cast<uint32_t>(_mm256_movemask_epi8(equal));
+        }
+
+        // size is at least 32. Equal 128 byte blocks are skipped with a single test, the
+        // last block overlaps the previous one instead of leaving a scalar tail.
+        SMP_TARGET_AVX2 size_t findMismatchAvx2(const char * a, const char * b, size_t size)
+        {
+            size_t ret = size;
+            size_t i = 0;
+            while(i + 128 <= size && areEqualAvx2(a + i, b + i))
+            {
+                i += 128;
+            }
+            for(; size == ret && i < size; i += 32)
+            {
+                i = std::min(i, size - 32);
+                uint32_t mask = ~matchMaskAvx2(a + i, b + i);
+                if(mask)
+                {
+                    ret = i + lowestBit(mask);
+                }
+            }
+            return ret;
+        }
+
+        SMP_TARGET_AVX2 size_t findStringAvx2(const char * str, size_t size, const char * pattern, size_t patternSize, size_t from)
+        {
+            size_t ret = StringNotFound;
+            const __m256i first = _mm256_set1_epi8(pattern[0]);
+            const __m256i last = _mm256_set1_epi8(pattern[patternSize - 1]);
+            size_t i = from;
+            for(; StringNotFound == ret && i + patternSize + 31 <= size; i += 32)
+            {
+                while(i + patternSize + 63 <= size && hasNoCandidatesAvx2(str + i, patternSize, first, last))
+                {
+                    i += 64;
+                }
+                uint32_t mask = i + patternSize + 31 <= size ? candidatesMaskAvx2(str + i, patternSize, first, last) : 0;
+                while(mask && StringNotFound == ret)
+                {
+                    size_t position = i + lowestBit(mask);
+                    ret = matchesAt(str + position, pattern, patternSize) ? position : StringNotFound;
+                    mask &= mask - 1;
+                }
+            }
+            return StringNotFound == ret ? findStringScalar(str, size, pattern, patternSize, i) : ret;
+        }
+
+        SMP_TARGET_AVX2 size_t findLastStringAvx2(const char * str, const char * pattern, size_t patternSize, size_t candidatesCount)
+        {
+            size_t ret = StringNotFound;
+            const __m256i first = _mm256_set1_epi8(pattern[0]);
+            const __m256i last = _mm256_set1_epi8(pattern[patternSize - 1]);
+            while(StringNotFound == ret && candidatesCount >= 32)
+            {
+                candidatesCount -= 32;
+                uint32_t mask = candidatesMaskAvx2(str + candidatesCount, patternSize, first, last);
+                while(mask && StringNotFound == ret)
+                {
+                    unsigned bit = highestBit(mask);
+                    size_t position = candidatesCount + bit;
+                    ret = matchesAt(str + position, pattern, patternSize) ? position : StringNotFound;
+                    mask &= ~(1u << bit);
+                }
+            }
+            return StringNotFound == ret ? findLastStringScalar(str, pattern, patternSize, candidatesCount) : ret;
+        }
+#endif
+
+#if SMP_HAS_SSE2
+        inline uint32_t candidatesMaskSse2(const char * str, size_t patternSize, __m128i first, __m128i last)
+        {
+            __m128i blockFirst = _mm_loadu_si128(reinterpret_cast<const __m128i *>(str));
+            __m128i blockLast = _mm_loadu_si128(reinterpret_cast<const __m128i *>(str + patternSize - 1));
+            __m128i matches = _mm_and_si128(_mm_cmpeq_epi8(first, blockFirst), _mm_cmpeq_epi8(last, blockLast));
+            return static_cast<uint32_t>(_mm_movemask_epi8(matches));
+        }
+
+        size_t findMismatchSse2(const char * a, const char * b, size_t size)
+        {
+            size_t ret = size;
+            for(size_t i = 0; size == ret && i < size; i += 16)
+            {
+                i = std::min(i, size - 16);
+                __m128i left = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+                __m128i right = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+                uint32_t mask = ~static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(left, right))) & 0xFFFF;
+                if(mask)
+                {
+                    ret = i + lowestBit(mask);
+                }
+            }
+            return ret;
+        }
+
+        size_t findStringSse2(const char * str, size_t size, const char * pattern, size_t patternSize, size_t from)
+        {
+            size_t ret = StringNotFound;
+            const __m128i first = _mm_set1_epi8(pattern[0]);
+            const __m128i last = _mm_set1_epi8(pattern[patternSize - 1]);
+            size_t i = from;
+            for(; StringNotFound == ret && i + patternSize + 15 <= size; i += 16)
+            {
+                uint32_t mask = candidatesMaskSse2(str + i, patternSize, first, last);
+                while(mask && StringNotFound == ret)
+                {
+                    size_t position = i + lowestBit(mask);
+                    ret = matchesAt(str + position, pattern, patternSize) ? position : StringNotFound;
+                    mask &= mask - 1;
+                }
+            }
+            return StringNotFound == ret ? findStringScalar(str, size, pattern, patternSize, i) : ret;
+        }
+
+        size_t findLastStringSse2(const char * str, const char * pattern, size_t patternSize, size_t candidatesCount)
+        {
+            size_t ret = StringNotFound;
+            const __m128i first = _mm_set1_epi8(pattern[0]);
+            const __m128i last = _mm_set1_epi8(pattern[patternSize - 1]);
+            while(StringNotFound == ret && candidatesCount >= 16)
+            {
+                candidatesCount -= 16;
+                uint32_t mask = candidatesMaskSse2(str + candidatesCount, patternSize, first, last);
+                while(mask && StringNotFound == ret)
+                {
+                    unsigned bit = highestBit(mask);
+                    size_t position = candidatesCount + bit;
+                    ret = matchesAt(str + position, pattern, patternSize) ? position : StringNotFound;
+                    mask &= ~(1u << bit);
+                }
+            }
+            return StringNotFound == ret ? findLastStringScalar(str, pattern, patternSize, candidatesCount) : ret;
+        }
+#endif
+    }
+
+    size_t findMismatch(const char * a, const char * b, size_t size)
+    {
+        size_t ret;
+#if SMP_HAS_AVX2
+        if(size >= 32 && hasAvx2())
+        {
+            ret = findMismatchAvx2(a, b, size);
+        }
+        else
+#endif
+#if SMP_HAS_SSE2
+        if(size >= 16)
+        {
+            ret = findMismatchSse2(a, b, size);
+        }
+        else
+#endif
+        {
+            ret = findMismatchScalar(a, b, 0, size);
+        }
+        return ret;
+    }
+
+    int compareStrings(const char * a, size_t aSize, const char * b, size_t bSize)
+    {
+        size_t size = std::min(aSize, bSize);
+        size_t mismatch = findMismatch(a, b, size);
+        int ret;
+        if(mismatch < size)
+        {
+            ret = static_cast<unsigned char>(a[mismatch]) < static_cast<unsigned char>(b[mismatch]) ? -1 : 1;
+        }
+        else
+        {
+            ret = aSize < bSize ? -1 : (aSize > bSize ? 1 : 0);
+        }
+        return ret;
+    }
+
+    size_t findString(const char * str, size_t size, const char * pattern, size_t patternSize, size_t from)
+    {
+        size_t ret = StringNotFound;
+        if(from <= size && patternSize <= size - from)
+        {
+            if(0 == patternSize)
+            {
+                ret = from;
+            }
+#if SMP_HAS_AVX2
+            else if(size - from >= patternSize + 31 && hasAvx2())
+            {
+                ret = findStringAvx2(str, size, pattern, patternSize, from);
+            }
+#endif
+#if SMP_HAS_SSE2
+            else if(size - from >= patternSize + 15)
+            {
+                ret = findStringSse2(str, size, pattern, patternSize, from);
+            }
+#endif
+            else
+            {
+                ret = findStringScalar(str, size, pattern, patternSize, from);
+            }
+        }
+        return ret;
+    }
+
+    size_t findLastString(const char * str, size_t size, const char * pattern, size_t patternSize, size_t from)
+    {
+        size_t ret = StringNotFound;
+        if(patternSize <= size)
+        {
+            // Every start position up to the last one is a candidate.
+            size_t candidatesCount = std::min(from, size - patternSize) + 1;
+            if(0 == patternSize)
+            {
+                ret = candidatesCount - 1;
+            }
+#if SMP_HAS_AVX2
+            else if(candidatesCount >= 32 && hasAvx2())
+            {
+                ret = findLastStringAvx2(str, pattern, patternSize, candidatesCount);
+            }
+#endif
+#if SMP_HAS_SSE2
+            else if(candidatesCount >= 16)
+            {
+                ret = findLastStringSse2(str, pattern, patternSize, candidatesCount);
+            }
+#endif
+            else
+            {
+                ret = findLastStringScalar(str, pattern, patternSize, candidatesCount);
+            }
+        }
+        return ret;
+    }
+}
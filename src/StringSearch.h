@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace SimpleMemoryPool
+{
+    constexpr size_t StringNotFound = SIZE_MAX;
+
+    // Length based string kernels behind SMPString: none of them looks for a NUL.
+    // On x86 they run 32 bytes at a time when the CPU has AVX2, 16 bytes at a time with
+    // SSE2 otherwise, and fall back to a scalar loop elsewhere and for short inputs.
+
+    // Index of the first byte that differs, size when both ranges are equal.
+    size_t findMismatch(const char * a, const char * b, size_t size);
+
+    // memcmp ordering on the common prefix, then the shorter string first.
+    int compareStrings(const char * a, size_t aSize, const char * b, size_t bSize);
+
+    // First occurrence of pattern starting at or after from, StringNotFound when there is none.
+    size_t findString(const char * str, size_t size, const char * pattern, size_t patternSize, size_t from);
+
+    // Last occurrence of pattern starting at or before from, StringNotFound when there is none.
+    size_t findLastString(const char * str, size_t size, const char * pattern, size_t patternSize, size_t from);
+}
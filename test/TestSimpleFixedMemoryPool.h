@@ -1,8 +1,25 @@
-#include <cstdio>
+﻿#include <cstdio>
 #include "SimpleFixedMemoryPool.h"
 #include "SMPString.h"
+#include "SMPStringBuilder.h"
+#include "SMPStringTable.h"
+#include "SMPVector.h"
+#include "SMPHashMap.h"
+#include "EpochReclaimer.h"
+#include "PoolPointers.h"
+#include "BasicFixedPool.h"
+#include "PoolCoroutine.h"
 #include "gtest/gtest.h"
+#include <atomic>
 #include <cstring>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 namespace smp = SimpleMemoryPool;
 
@@ -10,6 +27,30 @@ namespace smp = SimpleMemoryPool;
                               (MEM).logMemory();\
                             } while(0)
 
+// Hardened builds keep a red zone after every allocation, so a run can take one more
+// block and the allocation reports the size asked for instead of the whole run.
+#if SMP_HARDENING_ENABLED
+constexpr size_t RedZoneSize = smp::Hardening::RedZoneSize;
+#else
+constexpr size_t RedZoneSize = 0;
+#endif
+
+constexpr size_t getRunBlocksCount(size_t size, size_t blockSize)
+{
+    return (size + RedZoneSize + blockSize - 1) / blockSize;
+}
+
+constexpr size_t getAllocatedSize(size_t size, size_t blockSize)
+{
+    return RedZoneSize > 0 ? size : getRunBlocksCount(size, blockSize) * blockSize;
+}
+
+// Buffer size of a pool string holding stringSize chars in a buffer of its own.
+constexpr size_t getStringBufferSize(size_t stringSize, size_t blockSize)
+{
+    return getAllocatedSize(smp::SMPString::BufferHeaderSize + stringSize + 1, blockSize) - smp::SMPString::BufferHeaderSize;
+}
+
 struct Point
 {
     float x;
@@ -61,7 +102,7 @@ TEST(SMP_Allocate, SuccessfulAllocateMemory)
 
     smp::MemoryBlock mem = simpleMemoryPool.allocateMemory();
     ASSERT_TRUE(mem.ptr);
-    EXPECT_EQ(mem.size, memoryBlockSize);
+    EXPECT_EQ(mem.size, memoryBlockSize - RedZoneSize);
     EXPECT_EQ(simpleMemoryPool.getMemoryUsedSize(), memoryBlockSize);
     EXPECT_EQ(simpleMemoryPool.getFreeMemoryBlocksCount(), memoryBlockCount - 1);
     EXPECT_EQ(simpleMemoryPool.getUsedMemoryBlocksCount(), 1);
@@ -69,9 +110,9 @@ TEST(SMP_Allocate, SuccessfulAllocateMemory)
     smp::MemoryBlock mem2 = simpleMemoryPool.allocateMemory();
     smp::MemoryBlock mem3 = simpleMemoryPool.allocateMemory();
     ASSERT_TRUE(mem2.ptr);
-    EXPECT_EQ(mem2.size, memoryBlockSize);
+    EXPECT_EQ(mem2.size, memoryBlockSize - RedZoneSize);
     ASSERT_TRUE(mem3.ptr);
-    EXPECT_EQ(mem3.size, memoryBlockSize);
+    EXPECT_EQ(mem3.size, memoryBlockSize - RedZoneSize);
     EXPECT_EQ(simpleMemoryPool.getMemoryUsedSize(), 3 * memoryBlockSize);
     EXPECT_EQ(simpleMemoryPool.getFreeMemoryBlocksCount(), memoryBlockCount - 3);
     EXPECT_EQ(simpleMemoryPool.getUsedMemoryBlocksCount(), 3);
@@ -86,20 +127,22 @@ TEST(SMP_Allocate, SuccessfulAllocateMemoryWithSize)
 
     smp::MemoryBlock mem = simpleMemoryPool.allocateMemory(300);
     ASSERT_TRUE(mem.ptr);
-    EXPECT_EQ(simpleMemoryPool.getMemoryUsedSize(), 2 *memoryBlockSize);
-    EXPECT_EQ(simpleMemoryPool.getFreeMemoryBlocksCount(), memoryBlockCount - 2);
-    EXPECT_EQ(simpleMemoryPool.getUsedMemoryBlocksCount(), 2);
-    EXPECT_EQ(mem.size, 2 * memoryBlockSize);
+    size_t usedBlocksCount = getRunBlocksCount(300, memoryBlockSize);
+    EXPECT_EQ(simpleMemoryPool.getMemoryUsedSize(), usedBlocksCount * memoryBlockSize);
+    EXPECT_EQ(simpleMemoryPool.getFreeMemoryBlocksCount(), memoryBlockCount - usedBlocksCount);
+    EXPECT_EQ(simpleMemoryPool.getUsedMemoryBlocksCount(), usedBlocksCount);
+    EXPECT_EQ(mem.size, getAllocatedSize(300, memoryBlockSize));
 
     smp::MemoryBlock mem2 = simpleMemoryPool.allocateMemory(10);
     smp::MemoryBlock mem3 = simpleMemoryPool.allocateMemory(1024);
     ASSERT_TRUE(mem2.ptr);
-    EXPECT_EQ(mem2.size, memoryBlockSize);
+    EXPECT_EQ(mem2.size, getAllocatedSize(10, memoryBlockSize));
     ASSERT_TRUE(mem3.ptr);
-    EXPECT_EQ(mem3.size, 4 * memoryBlockSize);
-    EXPECT_EQ(simpleMemoryPool.getMemoryUsedSize(), 7 * memoryBlockSize);
-    EXPECT_EQ(simpleMemoryPool.getFreeMemoryBlocksCount(), memoryBlockCount - 7);
-    EXPECT_EQ(simpleMemoryPool.getUsedMemoryBlocksCount(), 7);
+    EXPECT_EQ(mem3.size, getAllocatedSize(1024, memoryBlockSize));
+    usedBlocksCount += getRunBlocksCount(10, memoryBlockSize) + getRunBlocksCount(1024, memoryBlockSize);
+    EXPECT_EQ(simpleMemoryPool.getMemoryUsedSize(), usedBlocksCount * memoryBlockSize);
+    EXPECT_EQ(simpleMemoryPool.getFreeMemoryBlocksCount(), memoryBlockCount - usedBlocksCount);
+    EXPECT_EQ(simpleMemoryPool.getUsedMemoryBlocksCount(), usedBlocksCount);
 }
 
 TEST(SMP_Allocate, UnsuccessfulAllocateMemory)
@@ -114,7 +157,7 @@ TEST(SMP_Allocate, UnsuccessfulAllocateMemory)
     {
         memories[i] = simpleMemoryPool.allocateMemory();
         ASSERT_TRUE(memories[i].ptr);
-        EXPECT_EQ(memories[i].size, memoryBlockSize);
+        EXPECT_EQ(memories[i].size, memoryBlockSize - RedZoneSize);
     }
 
     auto memory = simpleMemoryPool.allocateMemory();
@@ -131,17 +174,17 @@ TEST(SMP_Allocate, UnsuccessfulAllocateMemoryWithSize)
 
     smp::MemoryBlock mem = simpleMemoryPool.allocateMemory(200);
     ASSERT_TRUE(mem.ptr);
-    EXPECT_EQ(mem.size, simpleMemoryPool.getMemoryBlockSize());
+    EXPECT_EQ(mem.size, getAllocatedSize(200, memoryBlockSize));
     EXPECT_EQ(simpleMemoryPool.getFreeMemoryBlocksCount(), 3);
     
-    smp::MemoryBlock mem2 = simpleMemoryPool.allocateMemory(500);
+    smp::MemoryBlock mem2 = simpleMemoryPool.allocateMemory(500 - RedZoneSize);
     ASSERT_TRUE(mem2.ptr);
-    EXPECT_EQ(mem2.size, 2 * simpleMemoryPool.getMemoryBlockSize());
+    EXPECT_EQ(mem2.size, getAllocatedSize(500 - RedZoneSize, memoryBlockSize));
     EXPECT_EQ(simpleMemoryPool.getFreeMemoryBlocksCount(), 1);
 
-    smp::MemoryBlock mem3 = simpleMemoryPool.allocateMemory(256);
+    smp::MemoryBlock mem3 = simpleMemoryPool.allocateMemory(256 - RedZoneSize);
     ASSERT_TRUE(mem3.ptr);
-    EXPECT_EQ(mem3.size, simpleMemoryPool.getMemoryBlockSize());
+    EXPECT_EQ(mem3.size, getAllocatedSize(256 - RedZoneSize, memoryBlockSize));
     EXPECT_EQ(simpleMemoryPool.getFreeMemoryBlocksCount(), 0);
 
     bool res = simpleMemoryPool.freeMemory(&mem);
@@ -158,7 +201,7 @@ TEST(SMP_Allocate, UnsuccessfulAllocateMemoryWithSize)
 
     smp::MemoryBlock mem5 = simpleMemoryPool.allocateMemory(150);
     ASSERT_TRUE(mem5.ptr);
-    EXPECT_EQ(mem5.size, simpleMemoryPool.getMemoryBlockSize());
+    EXPECT_EQ(mem5.size, getAllocatedSize(150, memoryBlockSize));
     EXPECT_EQ(simpleMemoryPool.getFreeMemoryBlocksCount(), 1);
     
     res = simpleMemoryPool.freeMemory(&mem2);
@@ -167,7 +210,7 @@ TEST(SMP_Allocate, UnsuccessfulAllocateMemoryWithSize)
 
     smp::MemoryBlock mem6 = simpleMemoryPool.allocateMemory(700);
     ASSERT_TRUE(mem6.ptr);
-    EXPECT_EQ(mem6.size, 3 * simpleMemoryPool.getMemoryBlockSize());
+    EXPECT_EQ(mem6.size, getAllocatedSize(700, memoryBlockSize));
 
 }
 
@@ -337,9 +380,10 @@ TEST(SMP_ConstructArray, SuccessfulConstructArray)
     ASSERT_TRUE(points.ptr);
     EXPECT_EQ(points.count, 4);
 
-    EXPECT_EQ(simpleMemoryPool.getMemoryUsedSize(), 2 * memoryBlockSize);
-    EXPECT_EQ(simpleMemoryPool.getFreeMemoryBlocksCount(), memoryBlockCount - 2);
-    EXPECT_EQ(simpleMemoryPool.getUsedMemoryBlocksCount(), 2);
+    size_t usedBlocksCount = getRunBlocksCount(4 * sizeof(Point), memoryBlockSize);
+    EXPECT_EQ(simpleMemoryPool.getMemoryUsedSize(), usedBlocksCount * memoryBlockSize);
+    EXPECT_EQ(simpleMemoryPool.getFreeMemoryBlocksCount(), memoryBlockCount - usedBlocksCount);
+    EXPECT_EQ(simpleMemoryPool.getUsedMemoryBlocksCount(), usedBlocksCount);
 }
 
 TEST(SMP_DestructArray, SuccessfulDestructArrayInOneBlock)
@@ -371,9 +415,10 @@ TEST(SMP_DestructArray, SuccessfulDestructArray)
     EXPECT_EQ(points.count, 4);
     LOG_MEMORY(simpleMemoryPool);
 
-    EXPECT_EQ(simpleMemoryPool.getMemoryUsedSize(), 2 * memoryBlockSize);
-    EXPECT_EQ(simpleMemoryPool.getFreeMemoryBlocksCount(), memoryBlockCount - 2);
-    EXPECT_EQ(simpleMemoryPool.getUsedMemoryBlocksCount(), 2);
+    size_t usedBlocksCount = getRunBlocksCount(4 * sizeof(Point), memoryBlockSize);
+    EXPECT_EQ(simpleMemoryPool.getMemoryUsedSize(), usedBlocksCount * memoryBlockSize);
+    EXPECT_EQ(simpleMemoryPool.getFreeMemoryBlocksCount(), memoryBlockCount - usedBlocksCount);
+    EXPECT_EQ(simpleMemoryPool.getUsedMemoryBlocksCount(), usedBlocksCount);
 
     bool res = simpleMemoryPool.destructArray(&points);
     LOG_MEMORY(simpleMemoryPool);
@@ -386,6 +431,95 @@ TEST(SMP_DestructArray, SuccessfulDestructArray)
     EXPECT_EQ(simpleMemoryPool.getUsedMemoryBlocksCount(), 0);
 }
 
+struct Quote
+{
+    double  price;
+    int     size;
+};
+
+struct ThrowingElement
+{
+    static int constructedCount;
+    static int destructedCount;
+
+    explicit ThrowingElement(int throwAt)
+    {
+        if(constructedCount == throwAt)
+        {
+            throw std::runtime_error("element construction failed");
+        }
+        ++constructedCount;
+    }
+    ~ThrowingElement()
+    {
+        ++destructedCount;
+    }
+};
+
+int ThrowingElement::constructedCount = 0;
+int ThrowingElement::destructedCount = 0;
+
+TEST(SMP_ConstructArray, SuccessfulTrivialArrayFill)
+{
+    const size_t totalMemorySize = 4096;
+    const size_t memoryBlockSize = 64;
+    smp::SimpleFixedMemoryPool simpleMemoryPool(totalMemorySize, memoryBlockSize, 1, smp::MemoryDistributionPolicy::None,
+                                                smp::MemoryZeroingPolicy::Never);
+    smp::MemoryBlock mem = simpleMemoryPool.allocateMemory(totalMemorySize);
+    memset(mem.ptr, 0xFF, mem.size);
+    simpleMemoryPool.freeMemory(&mem);
+
+    smp::ArrayBlock zeros = simpleMemoryPool.constructArray<Quote>(100);
+    ASSERT_TRUE(zeros.ptr);
+    for(size_t i = 0; i < zeros.count; ++i)
+    {
+        EXPECT_EQ(zeros[i].price, 0.0);
+        EXPECT_EQ(zeros[i].size, 0);
+    }
+
+    const Quote prototype = { 1.25, 100 };
+    smp::ArrayBlock quotes = simpleMemoryPool.constructArray<Quote>(77, prototype);
+    ASSERT_TRUE(quotes.ptr);
+    EXPECT_EQ(quotes.count, 77);
+    for(size_t i = 0; i < quotes.count; ++i)
+    {
+        EXPECT_EQ(quotes[i].price, 1.25);
+        EXPECT_EQ(quotes[i].size, 100);
+    }
+
+    std::vector<int> values = { 1, 2, 3, 4, 5 };
+    smp::ArrayBlock copies = simpleMemoryPool.constructArray<int>(values.data(), values.data() + values.size());
+    ASSERT_TRUE(copies.ptr);
+    EXPECT_EQ(copies.count, values.size());
+    EXPECT_EQ(0, memcmp(copies.ptr, values.data(), sizeof(int) * values.size()));
+
+    std::vector<Point> sources = { Point(1.0f, 1.0f), Point(2.0f, 2.0f), Point(3.0f, 3.0f) };
+    smp::ArrayBlock points = simpleMemoryPool.constructArray<Point>(sources.begin(), sources.end());
+    ASSERT_TRUE(points.ptr);
+    EXPECT_EQ(points.count, 3);
+    EXPECT_EQ(points[2].x, 3.0f);
+    EXPECT_EQ(points[2].y, 3.0f);
+
+    EXPECT_TRUE(simpleMemoryPool.destructArray(&zeros));
+    EXPECT_TRUE(simpleMemoryPool.destructArray(&quotes));
+    EXPECT_TRUE(simpleMemoryPool.destructArray(&copies));
+    EXPECT_TRUE(simpleMemoryPool.destructArray(&points));
+    EXPECT_EQ(simpleMemoryPool.getMemoryUsedSize(), 0);
+}
+
+TEST(SMP_ConstructArray, SuccessfulRollbackOnThrowingConstructor)
+{
+    const size_t totalMemorySize = 1024;
+    const size_t memoryBlockSize = 16;
+    smp::SimpleFixedMemoryPool simpleMemoryPool(totalMemorySize, memoryBlockSize);
+
+    EXPECT_THROW(simpleMemoryPool.constructArray<ThrowingElement>(10, 6), std::runtime_error);
+    EXPECT_EQ(ThrowingElement::constructedCount, 6);
+    EXPECT_EQ(ThrowingElement::destructedCount, 6);
+    EXPECT_EQ(simpleMemoryPool.getMemoryUsedSize(), 0);
+    EXPECT_EQ(simpleMemoryPool.getFreeMemoryBlocksCount(), simpleMemoryPool.getMemoryBlocksCount());
+}
+
 TEST(SMP_Policy, SUCCESSFUL_ALLOCATE_RANGES_POLICY)
 {
     const size_t totalMemorySize = 1024;
@@ -394,7 +528,7 @@ TEST(SMP_Policy, SUCCESSFUL_ALLOCATE_RANGES_POLICY)
     size_t memoryBlockCount = totalMemorySize / memoryBlockSize;
 
     auto mem1 = simpleMemoryPool.allocateMemory(64);
-    auto mem2 = simpleMemoryPool.allocateMemory(500);
+    auto mem2 = simpleMemoryPool.allocateMemory(500 - RedZoneSize);
     auto mem3 = simpleMemoryPool.allocateMemory(64);
 
     EXPECT_TRUE(mem1.ptr);
@@ -428,15 +562,15 @@ TEST(SMP_Policy, SUCCESSFUL_ALLOCATE_CLOSERANGES_POLICY2)
     smp::SimpleFixedMemoryPool simpleMemoryPool(totalMemorySize, memoryBlockSize, 4, smp::MemoryDistributionPolicy::CloseRanges);
     size_t memoryBlockCount = totalMemorySize / memoryBlockSize;
 
-    auto mem1 = simpleMemoryPool.allocateMemory(64 * memoryBlockSize);
+    auto mem1 = simpleMemoryPool.allocateMemory(64 * memoryBlockSize - RedZoneSize);
     EXPECT_TRUE(mem1.ptr);
-    auto mem2 = simpleMemoryPool.allocateMemory(64 * memoryBlockSize);
+    auto mem2 = simpleMemoryPool.allocateMemory(64 * memoryBlockSize - RedZoneSize);
     EXPECT_TRUE(mem2.ptr);
-    auto mem3 = simpleMemoryPool.allocateMemory(64 * memoryBlockSize);
+    auto mem3 = simpleMemoryPool.allocateMemory(64 * memoryBlockSize - RedZoneSize);
     EXPECT_TRUE(mem3.ptr);
-    auto mem4 = simpleMemoryPool.allocateMemory(64 * memoryBlockSize);
+    auto mem4 = simpleMemoryPool.allocateMemory(64 * memoryBlockSize - RedZoneSize);
     EXPECT_TRUE(mem4.ptr);
-    auto mem5 = simpleMemoryPool.allocateMemory(64 * memoryBlockSize);
+    auto mem5 = simpleMemoryPool.allocateMemory(64 * memoryBlockSize - RedZoneSize);
     EXPECT_FALSE(mem5.ptr);
 }
 
@@ -471,6 +605,104 @@ TEST(SMP_Policy, UNSUCCESSFUL_ALLOCATE_RANGES_POLICY)
     EXPECT_EQ(mem.size, 0);
 }
 
+TEST(SMP_Policy, SUCCESSFUL_ADAPTIVE_RANGES_GROW_WITH_DEMAND)
+{
+    const size_t memoryBlockSize = 64;
+    const size_t totalMemorySize = memoryBlockSize * 1024;
+    smp::SimpleFixedMemoryPool simpleMemoryPool(totalMemorySize, memoryBlockSize, 4, smp::MemoryDistributionPolicy::AdaptiveRanges);
+    ASSERT_EQ(simpleMemoryPool.getDistributionRangesCount(), 4);
+
+    // Only the first size class is used, its range takes its neighbour's blocks instead of failing.
+    std::vector<smp::MemoryBlock> blocks;
+    for(size_t i = 0; i < 600; ++i)
+    {
+        blocks.push_back(simpleMemoryPool.allocateMemory());
+        EXPECT_TRUE(blocks.back().ptr);
+    }
+    smp::MemoryRangeStats first = simpleMemoryPool.getDistributionRangeStats(0);
+    smp::MemoryRangeStats second = simpleMemoryPool.getDistributionRangeStats(1);
+    // The neighbour keeps an eighth of its starting size, the rest spills.
+    EXPECT_EQ(first.firstBlock, 0);
+    EXPECT_EQ(first.blocksCount, 480);
+    EXPECT_EQ(first.usedBlocksCount, 480);
+    EXPECT_EQ(first.allocationsCount, 600);
+    EXPECT_EQ(first.spillsCount, 120);
+    EXPECT_GT(first.growthsCount, 0);
+    EXPECT_GE(first.missesCount, first.growthsCount + first.spillsCount);
+    EXPECT_EQ(second.firstBlock, 480);
+    EXPECT_EQ(second.blocksCount, 32);
+    EXPECT_EQ(second.usedBlocksCount, 32);
+    EXPECT_EQ(simpleMemoryPool.getDistributionRangeStats(2).usedBlocksCount, 88);
+
+    for(auto & block : blocks)
+    {
+        EXPECT_TRUE(simpleMemoryPool.freeMemory(&block));
+    }
+    for(size_t i = 0; i < simpleMemoryPool.getDistributionRangesCount(); ++i)
+    {
+        EXPECT_EQ(simpleMemoryPool.getDistributionRangeStats(i).usedBlocksCount, 0);
+    }
+    EXPECT_EQ(simpleMemoryPool.getDistributionRangeStats(0).blocksCount, 480);
+}
+
+TEST(SMP_Policy, SUCCESSFUL_ADAPTIVE_RANGES_KEEP_LIVE_ALLOCATIONS)
+{
+    const size_t memoryBlockSize = 64;
+    const size_t totalMemorySize = memoryBlockSize * 1024;
+    smp::SimpleFixedMemoryPool simpleMemoryPool(totalMemorySize, memoryBlockSize, 4, smp::MemoryDistributionPolicy::AdaptiveRanges);
+
+    // A run of the second size class sits at the start of its range, the boundary cannot move over it.
+    auto run = simpleMemoryPool.allocateMemory(99 * memoryBlockSize - RedZoneSize);
+    ASSERT_TRUE(run.ptr);
+    memset(run.ptr, 0x5A, run.size);
+    std::vector<smp::MemoryBlock> blocks;
+    for(size_t i = 0; i < 300; ++i)
+    {
+        blocks.push_back(simpleMemoryPool.allocateMemory());
+        EXPECT_TRUE(blocks.back().ptr);
+        EXPECT_TRUE(blocks.back().ptr < run.ptr || blocks.back().ptr >= run.ptr + run.size);
+    }
+    smp::MemoryRangeStats first = simpleMemoryPool.getDistributionRangeStats(0);
+    EXPECT_EQ(first.blocksCount, 256);
+    EXPECT_EQ(first.growthsCount, 0);
+    EXPECT_EQ(first.spillsCount, 44);
+    EXPECT_EQ(simpleMemoryPool.getDistributionRangeStats(1).firstBlock, 256);
+    EXPECT_EQ(simpleMemoryPool.getDistributionRangeStats(1).usedBlocksCount, 143);
+    for(size_t i = 0; i < run.size; ++i)
+    {
+        ASSERT_EQ(run.ptr[i], 0x5A);
+    }
+
+    for(auto & block : blocks)
+    {
+        simpleMemoryPool.freeMemory(&block);
+    }
+    simpleMemoryPool.freeMemory(&run);
+}
+
+TEST(SMP_Policy, SUCCESSFUL_CLOSERANGES_REPORT_OCCUPANCY)
+{
+    const size_t memoryBlockSize = 16;
+    const size_t totalMemorySize = memoryBlockSize * 1024;
+    smp::SimpleFixedMemoryPool simpleMemoryPool(totalMemorySize, memoryBlockSize, 4, smp::MemoryDistributionPolicy::CloseRanges);
+    smp::SimpleFixedMemoryPool plainMemoryPool(totalMemorySize, memoryBlockSize);
+    EXPECT_EQ(plainMemoryPool.getDistributionRangesCount(), 0);
+
+    auto mem1 = simpleMemoryPool.allocateMemory(200 * memoryBlockSize - RedZoneSize);
+    auto mem2 = simpleMemoryPool.allocateMemory(200 * memoryBlockSize - RedZoneSize);
+    EXPECT_TRUE(mem1.ptr);
+    EXPECT_FALSE(mem2.ptr);
+    smp::MemoryRangeStats last = simpleMemoryPool.getDistributionRangeStats(3);
+    EXPECT_EQ(last.firstBlock, 768);
+    EXPECT_EQ(last.blocksCount, 256);
+    EXPECT_EQ(last.usedBlocksCount, 200);
+    EXPECT_EQ(last.allocationsCount, 1);
+    EXPECT_EQ(last.missesCount, 1);
+    EXPECT_EQ(last.growthsCount, 0);
+    simpleMemoryPool.freeMemory(&mem1);
+    EXPECT_EQ(simpleMemoryPool.getDistributionRangeStats(3).usedBlocksCount, 0);
+}
+
 TEST(SMP_STRING, SUCCESSFUL_STRING_DEFAULT_CONSTRUCTION)
 {
     const size_t totalMemorySize = 1024 * 1024;
@@ -481,8 +713,8 @@ TEST(SMP_STRING, SUCCESSFUL_STRING_DEFAULT_CONSTRUCTION)
     auto str = smp::SMPString(&simpleMemoryPool);
     EXPECT_EQ(strcmp(str.getBuffer(), ""), 0);
     EXPECT_EQ(str.getStringSize(), 0);
-    EXPECT_EQ(str.getBufferSize(), 32);
-    EXPECT_EQ(simpleMemoryPool.getMemoryUsedSize(), 2 * memoryBlockSize);
+    EXPECT_EQ(str.getBufferSize(), smp::SMPString::InlineCapacity + 1);
+    EXPECT_EQ(simpleMemoryPool.getMemoryUsedSize(), 0);
 }
 
 TEST(SMP_STRING, SUCCESSFUL_STRING_CONSTRUCTOR_WITH_CONST_CHAR_PTR)
@@ -495,8 +727,8 @@ TEST(SMP_STRING, SUCCESSFUL_STRING_CONSTRUCTOR_WITH_CONST_CHAR_PTR)
     auto str = smp::SMPString(&simpleMemoryPool, "Sina");
     EXPECT_EQ(strcmp(str.getBuffer(), "Sina"), 0);
     EXPECT_EQ(str.getStringSize(), 4);
-    EXPECT_EQ(str.getBufferSize(), memoryBlockSize);
-    EXPECT_EQ(simpleMemoryPool.getMemoryUsedSize(), memoryBlockSize);
+    EXPECT_TRUE(str.isInline());
+    EXPECT_EQ(simpleMemoryPool.getMemoryUsedSize(), 0);
 }
 
 TEST(SMP_STRING, SUCCESSFUL_STRING_CONSTRUCTOR_WITH_SIZE)
@@ -510,8 +742,8 @@ TEST(SMP_STRING, SUCCESSFUL_STRING_CONSTRUCTOR_WITH_SIZE)
     str = "Sina";
     EXPECT_EQ(strcmp(str.getBuffer(), "Sina"), 0);
     EXPECT_EQ(str.getStringSize(), 4);
-    EXPECT_EQ(str.getBufferSize(), memoryBlockSize);
-    EXPECT_EQ(simpleMemoryPool.getMemoryUsedSize(), memoryBlockSize);
+    EXPECT_TRUE(str.isInline());
+    EXPECT_EQ(simpleMemoryPool.getMemoryUsedSize(), 0);
 }
 
 
@@ -523,11 +755,11 @@ TEST(SMP_STRING, SUCCESSFUL_STRING_DESTRUCTOR)
     size_t memoryBlockCount = totalMemorySize / memoryBlockSize;
 
     {
-        auto str = smp::SMPString(&simpleMemoryPool, "Sina");
-        EXPECT_EQ(strcmp(str.getBuffer(), "Sina"), 0);
-        EXPECT_EQ(str.getStringSize(), 4);
-        EXPECT_EQ(str.getBufferSize(), memoryBlockSize);
-        EXPECT_EQ(simpleMemoryPool.getMemoryUsedSize(), memoryBlockSize);
+        auto str = smp::SMPString(&simpleMemoryPool, "Sina-Sina-Sina-Sina-Sina-");
+        EXPECT_EQ(strcmp(str.getBuffer(), "Sina-Sina-Sina-Sina-Sina-"), 0);
+        EXPECT_EQ(str.getStringSize(), 25);
+        EXPECT_EQ(str.getBufferSize(), getStringBufferSize(25, memoryBlockSize));
+        EXPECT_EQ(simpleMemoryPool.getMemoryUsedSize(), getRunBlocksCount(smp::SMPString::BufferHeaderSize + 26, memoryBlockSize) * memoryBlockSize);
     }
     EXPECT_EQ(simpleMemoryPool.getMemoryUsedSize(), 0);
 }
@@ -543,8 +775,8 @@ TEST(SMP_STRING, SUCCESSFUL_STRING_COPY_CONSTRUCTION)
     smp::SMPString str2 = str;
     EXPECT_EQ(strcmp(str2.getBuffer(), "Sina"), 0);
     EXPECT_EQ(str2.getStringSize(), 4);
-    EXPECT_EQ(str2.getBufferSize(), memoryBlockSize);
-    EXPECT_EQ(simpleMemoryPool.getMemoryUsedSize(), 2 * memoryBlockSize);
+    EXPECT_TRUE(str2.isInline());
+    EXPECT_EQ(simpleMemoryPool.getMemoryUsedSize(), 0);
 }
 
 TEST(SMP_STRING, SUCCESSFUL_STRING_COPY_ASSIGNMENT)
@@ -559,7 +791,7 @@ TEST(SMP_STRING, SUCCESSFUL_STRING_COPY_ASSIGNMENT)
     str2 = str;
     EXPECT_EQ(strcmp(str2.getBuffer(), "Sina"), 0);
     EXPECT_EQ(str2.getStringSize(), 4);
-    EXPECT_EQ(str2.getBufferSize(), memoryBlockSize);
+    EXPECT_TRUE(str2.isInline());
 }
 
 TEST(SMP_STRING, SUCCESSFUL_STRING_MOVE_CONSTRUCTION)
@@ -573,8 +805,16 @@ TEST(SMP_STRING, SUCCESSFUL_STRING_MOVE_CONSTRUCTION)
     smp::SMPString str2 = std::move(str);
     EXPECT_EQ(strcmp(str2.getBuffer(), "Sina"), 0);
     EXPECT_EQ(str2.getStringSize(), 4);
-    EXPECT_EQ(str2.getBufferSize(), memoryBlockSize);
-    EXPECT_EQ(simpleMemoryPool.getMemoryUsedSize(), memoryBlockSize);
+    EXPECT_TRUE(str2.isInline());
+    EXPECT_EQ(simpleMemoryPool.getMemoryUsedSize(), 0);
+
+    auto longStr = smp::SMPString(&simpleMemoryPool, "Sina-Sina-Sina-Sina-Sina-");
+    const char * buffer = longStr.getBuffer();
+    smp::SMPString longStr2 = std::move(longStr);
+    EXPECT_EQ(longStr2.getBuffer(), buffer);
+    EXPECT_EQ(longStr.getStringSize(), 0);
+    EXPECT_TRUE(longStr.isInline());
+    EXPECT_EQ(simpleMemoryPool.getMemoryUsedSize(), getRunBlocksCount(smp::SMPString::BufferHeaderSize + 26, memoryBlockSize) * memoryBlockSize);
 }
 
 TEST(SMP_STRING, SUCCESSFUL_STRING_MOVE_ASSIGNMENT)
@@ -589,7 +829,14 @@ TEST(SMP_STRING, SUCCESSFUL_STRING_MOVE_ASSIGNMENT)
     str2 = std::move(str);
     EXPECT_EQ(strcmp(str2.getBuffer(), "Sina"), 0);
     EXPECT_EQ(str2.getStringSize(), 4);
-    EXPECT_EQ(str2.getBufferSize(), memoryBlockSize);
+    EXPECT_TRUE(str2.isInline());
+
+    auto longStr = smp::SMPString(&simpleMemoryPool, "Sina-Sina-Sina-Sina-Sina-");
+    str2 = "Mina-Mina-Mina-Mina-Mina-";
+    str2 = std::move(longStr);
+    EXPECT_EQ(strcmp(str2.getBuffer(), "Sina-Sina-Sina-Sina-Sina-"), 0);
+    EXPECT_EQ(longStr.getStringSize(), 0);
+    EXPECT_EQ(simpleMemoryPool.getMemoryUsedSize(), getRunBlocksCount(smp::SMPString::BufferHeaderSize + 26, memoryBlockSize) * memoryBlockSize);
 }
 
 TEST(SMP_STRING, SUCCESSFUL_STRING_ASSIGNMENT_WITH_CONST_CHAR_PTR)
@@ -603,7 +850,7 @@ TEST(SMP_STRING, SUCCESSFUL_STRING_ASSIGNMENT_WITH_CONST_CHAR_PTR)
     str = "GG";
     EXPECT_EQ(strcmp(str.getBuffer(), "GG"), 0);
     EXPECT_EQ(str.getStringSize(), 2);
-    EXPECT_EQ(str.getBufferSize(), memoryBlockSize);
+    EXPECT_TRUE(str.isInline());
 }
 
 TEST(SMP_STRING, SUCCESSFUL_STRING_ASSIGNMENT_WITH_CONST_CHAR_PTR2)
@@ -614,10 +861,10 @@ TEST(SMP_STRING, SUCCESSFUL_STRING_ASSIGNMENT_WITH_CONST_CHAR_PTR2)
     size_t memoryBlockCount = totalMemorySize / memoryBlockSize;
 
     auto str = smp::SMPString(&simpleMemoryPool, "Sina");
-    str = "Sina-Sina-Sina-Sina-";
-    EXPECT_EQ(strcmp(str.getBuffer(), "Sina-Sina-Sina-Sina-"), 0);
-    EXPECT_EQ(str.getStringSize(), 20);
-    EXPECT_EQ(str.getBufferSize(), 2 * memoryBlockSize);
+    str = "Sina-Sina-Sina-Sina-Sina-";
+    EXPECT_EQ(strcmp(str.getBuffer(), "Sina-Sina-Sina-Sina-Sina-"), 0);
+    EXPECT_EQ(str.getStringSize(), 25);
+    EXPECT_EQ(str.getBufferSize(), getStringBufferSize(25, memoryBlockSize));
 }
 
 TEST(SMP_STRING, SUCCESSFUL_STRING_INDEX_OPERATOR)
@@ -646,6 +893,71 @@ TEST(SMP_STRING, SUCCESSFUL_STRING_EQUAL_OPERATOR)
     EXPECT_TRUE(str == str2);
 }
 
+TEST(SMP_STRING, SUCCESSFUL_STRING_COMPARE_WITH_LENGTHS)
+{
+    const size_t totalMemorySize = 1024 * 1024;
+    const size_t memoryBlockSize = 16;
+    smp::SimpleFixedMemoryPool simpleMemoryPool(totalMemorySize, memoryBlockSize);
+
+    auto str = smp::SMPString(&simpleMemoryPool, "Sina");
+    EXPECT_FALSE(str == "Sin");
+    EXPECT_FALSE(str == "Sinaa");
+    EXPECT_TRUE(str != "Mina");
+    EXPECT_TRUE(str == std::string_view("Sina-", 4));
+    EXPECT_TRUE(std::string_view(str) == "Sina");
+
+    std::string text(100, 'x');
+    auto longStr = smp::SMPString(&simpleMemoryPool, std::string_view(text));
+    auto longStr2 = smp::SMPString(&simpleMemoryPool, std::string_view(text));
+    EXPECT_TRUE(longStr == longStr2);
+    for(size_t i : { 0, 15, 31, 32, 70, 99 })
+    {
+        std::string other = text;
+        other[i] = 'y';
+        longStr2 = std::string_view(other);
+        EXPECT_FALSE(longStr == longStr2);
+        EXPECT_LT(longStr.compare(longStr2), 0);
+        EXPECT_GT(longStr2.compare(longStr), 0);
+    }
+    EXPECT_GT(longStr.compare(std::string_view(text.data(), 99)), 0);
+    EXPECT_LT(str.compare("\xff"), 0);
+    EXPECT_EQ(longStr.compare(text), 0);
+}
+
+TEST(SMP_STRING, SUCCESSFUL_STRING_SEARCH_MATCHES_STD_STRING)
+{
+    const size_t totalMemorySize = 1024 * 1024;
+    const size_t memoryBlockSize = 64;
+    smp::SimpleFixedMemoryPool simpleMemoryPool(totalMemorySize, memoryBlockSize);
+
+    // Lengths around the vector widths so that every kernel and every tail is taken.
+    std::string text;
+    for(size_t i = 0; i < 130; ++i)
+    {
+        text += static_cast<char>('a' + (i * 7 + i / 13) % 5);
+    }
+    const char * patterns[] = { "", "a", "e", "ab", "cea", "bdace", "dacebdacebd", "zz", "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa" };
+    for(size_t size : { 0, 1, 5, 15, 16, 17, 31, 32, 33, 47, 64, 100, 130 })
+    {
+        std::string expected = text.substr(0, size);
+        auto str = smp::SMPString(&simpleMemoryPool, std::string_view(expected));
+        for(const char * pattern : patterns)
+        {
+            for(size_t from : { (size_t)0, (size_t)1, size / 2, size, size + 1 })
+            {
+                EXPECT_EQ(str.find(pattern, from), expected.find(pattern, from));
+                EXPECT_EQ(str.rfind(pattern, from), expected.rfind(pattern, from));
+            }
+            EXPECT_EQ(str.rfind(pattern), expected.rfind(pattern));
+            EXPECT_EQ(str.startsWith(pattern), 0 == expected.compare(0, strlen(pattern), pattern));
+            EXPECT_EQ(str.endsWith(pattern), expected.size() >= strlen(pattern) && 0 == expected.compare(expected.size() - strlen(pattern), std::string::npos, pattern));
+        }
+        EXPECT_EQ(str.find('d'), expected.find('d'));
+        EXPECT_EQ(str.rfind('d'), expected.rfind('d'));
+    }
+    EXPECT_EQ(smp::SMPString::NotFound, std::string::npos);
+}
+
 TEST(SMP_STRING, SUCCESSFUL_STRING_PLUS_OPERATOR)
 {
     const size_t totalMemorySize = 1024 * 1024;
@@ -658,8 +970,8 @@ TEST(SMP_STRING, SUCCESSFUL_STRING_PLUS_OPERATOR)
     auto str3 = str + str2;
     EXPECT_EQ(strcmp(str3.getBuffer(), "SinaGG"), 0);
     EXPECT_EQ(str3.getStringSize(), 6);
-    EXPECT_EQ(str3.getBufferSize(), memoryBlockSize);
-    EXPECT_EQ(simpleMemoryPool.getMemoryUsedSize(), 3 * memoryBlockSize);
+    EXPECT_TRUE(str3.isInline());
+    EXPECT_EQ(simpleMemoryPool.getMemoryUsedSize(), 0);
 }
 
 TEST(SMP_STRING, SUCCESSFUL_STRING_PLUS_OPERATOR2)
@@ -673,8 +985,8 @@ TEST(SMP_STRING, SUCCESSFUL_STRING_PLUS_OPERATOR2)
     auto str2 = str + "GG";
     EXPECT_EQ(strcmp(str2.getBuffer(), "SinaGG"), 0);
     EXPECT_EQ(str2.getStringSize(), 6);
-    EXPECT_EQ(str2.getBufferSize(), memoryBlockSize);
-    EXPECT_EQ(simpleMemoryPool.getMemoryUsedSize(), 2 * memoryBlockSize);
+    EXPECT_TRUE(str2.isInline());
+    EXPECT_EQ(simpleMemoryPool.getMemoryUsedSize(), 0);
 }
 
 TEST(SMP_STRING, SUCCESSFUL_STRING_INCREMENT_OPERATOR)
@@ -688,7 +1000,7 @@ TEST(SMP_STRING, SUCCESSFUL_STRING_INCREMENT_OPERATOR)
     str += "GG";
     EXPECT_EQ(strcmp(str.getBuffer(), "SinaGG"), 0);
     EXPECT_EQ(str.getStringSize(), 6);
-    EXPECT_EQ(str.getBufferSize(), memoryBlockSize);
+    EXPECT_TRUE(str.isInline());
 }
 
 TEST(SMP_STRING, SUCCESSFUL_STRING_INCREMENT_OPERATOR2)
@@ -702,7 +1014,7 @@ TEST(SMP_STRING, SUCCESSFUL_STRING_INCREMENT_OPERATOR2)
     str += "Sina-Sina-Sina-Sina-";
     EXPECT_EQ(strcmp(str.getBuffer(), "SinaSina-Sina-Sina-Sina-"), 0);
     EXPECT_EQ(str.getStringSize(), 24);
-    EXPECT_EQ(str.getBufferSize(), 2 * memoryBlockSize);
+    EXPECT_EQ(str.getBufferSize(), getStringBufferSize(24, memoryBlockSize));
 }
 
 TEST(SMP_STRING, SUCCESSFUL_STRING_INCREMENT_OPERATOR3)
@@ -717,7 +1029,7 @@ TEST(SMP_STRING, SUCCESSFUL_STRING_INCREMENT_OPERATOR3)
     str += str2;
     EXPECT_EQ(strcmp(str.getBuffer(), "SinaGG"), 0);
     EXPECT_EQ(str.getStringSize(), 6);
-    EXPECT_EQ(str.getBufferSize(), memoryBlockSize);
+    EXPECT_TRUE(str.isInline());
 }
 
 TEST(SMP_STRING, SUCCESSFUL_STRING_INCREMENT_OPERATOR4)
@@ -732,5 +1044,1519 @@ TEST(SMP_STRING, SUCCESSFUL_STRING_INCREMENT_OPERATOR4)
     str += str2;
     EXPECT_EQ(strcmp(str.getBuffer(), "SinaSina-Sina-Sina-Sina-"), 0);
     EXPECT_EQ(str.getStringSize(), 24);
-    EXPECT_EQ(str.getBufferSize(), 2 * memoryBlockSize);
-}
\ No newline at end of file
+    EXPECT_EQ(str.getBufferSize(), getStringBufferSize(24, memoryBlockSize));
+}
+
+TEST(SMP_STRING, SUCCESSFUL_STRING_SPILLS_TO_POOL_PAST_INLINE_CAPACITY)
+{
+    const size_t totalMemorySize = 1024;
+    const size_t memoryBlockSize = 64;
+    smp::SimpleFixedMemoryPool simpleMemoryPool(totalMemorySize, memoryBlockSize);
+    EXPECT_LE(sizeof(smp::SMPString), 32);
+
+    std::string text(smp::SMPString::InlineCapacity, 'x');
+    auto str = smp::SMPString(&simpleMemoryPool, text.c_str());
+    EXPECT_TRUE(str.isInline());
+    EXPECT_EQ(str.getStringSize(), smp::SMPString::InlineCapacity);
+    EXPECT_EQ(str.getBuffer()[smp::SMPString::InlineCapacity], '\0');
+    EXPECT_EQ(simpleMemoryPool.getMemoryUsedSize(), 0);
+
+    str += "y";
+    EXPECT_FALSE(str.isInline());
+    EXPECT_EQ(str.getStringSize(), smp::SMPString::InlineCapacity + 1);
+    EXPECT_EQ(str.getBufferSize(), getStringBufferSize(smp::SMPString::InlineCapacity + 1, memoryBlockSize));
+    EXPECT_EQ(strcmp(str.getBuffer(), (text + "y").c_str()), 0);
+    EXPECT_EQ(simpleMemoryPool.getMemoryUsedSize(), memoryBlockSize);
+
+    // Still fits the first block, hardened builds grow the exact sized buffer instead.
+    str += str;
+    EXPECT_EQ(strcmp(str.getBuffer(), (text + "y" + text + "y").c_str()), 0);
+    EXPECT_EQ(simpleMemoryPool.getMemoryUsedSize(),
+              getRunBlocksCount(smp::SMPString::BufferHeaderSize + 2 * (smp::SMPString::InlineCapacity + 1) + 1, memoryBlockSize) * memoryBlockSize);
+
+    str = "short";
+    EXPECT_EQ(strcmp(str.getBuffer(), "short"), 0);
+    EXPECT_EQ(str.getStringSize(), 5);
+
+    auto withoutPool = smp::SMPString(nullptr, text.c_str());
+    EXPECT_TRUE(withoutPool.isInline());
+    EXPECT_EQ(strcmp(withoutPool.getBuffer(), text.c_str()), 0);
+}
+
+TEST(SMP_STRING, SUCCESSFUL_STRING_GROWS_IN_PLACE)
+{
+    const size_t totalMemorySize = 1024;
+    const size_t memoryBlockSize = 16;
+    smp::SimpleFixedMemoryPool simpleMemoryPool(totalMemorySize, memoryBlockSize);
+
+    auto getCapacity = [&](size_t capacity) { return getStringBufferSize(capacity, memoryBlockSize) - 1; };
+    auto str = smp::SMPString(&simpleMemoryPool, "Sina-Sina-Sina-Sina-Sina-");
+    const char * buffer = str.getBuffer();
+    EXPECT_EQ(str.getCapacity(), getCapacity(25));
+    for(int i = 0; i < 13; ++i)
+    {
+        str += "Sina-";
+    }
+    // Each resize doubles the capacity, then takes the rest of the last block.
+    EXPECT_EQ(str.getBuffer(), buffer);
+    EXPECT_EQ(str.getStringSize(), 90);
+    EXPECT_EQ(str.getCapacity(), getCapacity(2 * getCapacity(2 * getCapacity(25))));
+    EXPECT_EQ(simpleMemoryPool.getStats().resizesCount, 2);
+
+    str.shrinkToFit();
+    EXPECT_EQ(str.getBuffer(), buffer);
+    EXPECT_EQ(str.getCapacity(), getCapacity(90));
+    EXPECT_EQ(simpleMemoryPool.getMemoryUsedSize(), getRunBlocksCount(smp::SMPString::BufferHeaderSize + 91, memoryBlockSize) * memoryBlockSize);
+
+    auto blocker = simpleMemoryPool.allocateMemory();
+    EXPECT_TRUE(str.reserve(200));
+    EXPECT_NE(str.getBuffer(), buffer);
+    EXPECT_GE(str.getCapacity(), 200);
+    EXPECT_EQ(str.getStringSize(), 90);
+    EXPECT_EQ(str[89], '-');
+
+    str = "Sina";
+    str.shrinkToFit();
+    EXPECT_TRUE(str.isInline());
+    EXPECT_EQ(strcmp(str.getBuffer(), "Sina"), 0);
+    EXPECT_EQ(simpleMemoryPool.getMemoryUsedSize(), getRunBlocksCount(blocker.size, memoryBlockSize) * memoryBlockSize);
+    simpleMemoryPool.freeMemory(&blocker);
+}
+
+#if SMP_STRING_SHARED_BUFFERS
+TEST(SMP_STRING, SUCCESSFUL_STRING_SHARES_BUFFER_UNTIL_MUTATION)
+{
+    const size_t totalMemorySize = 1024;
+    const size_t memoryBlockSize = 16;
+    smp::SimpleFixedMemoryPool simpleMemoryPool(totalMemorySize, memoryBlockSize);
+
+    auto str = smp::SMPString(&simpleMemoryPool, "Sina-Sina-Sina-Sina-Sina-");
+    auto usedSize = simpleMemoryPool.getMemoryUsedSize();
+    smp::SMPString copy = str;
+    smp::SMPString copy2(&simpleMemoryPool);
+    copy2 = copy;
+    EXPECT_EQ(copy.getBuffer(), str.getBuffer());
+    EXPECT_EQ(copy2.getBuffer(), str.getBuffer());
+    EXPECT_TRUE(str.isShared());
+    EXPECT_EQ(simpleMemoryPool.getMemoryUsedSize(), usedSize);
+
+    copy += "Mina";
+    EXPECT_NE(copy.getBuffer(), str.getBuffer());
+    EXPECT_EQ(strcmp(copy.getBuffer(), "Sina-Sina-Sina-Sina-Sina-Mina"), 0);
+    EXPECT_EQ(strcmp(str.getBuffer(), "Sina-Sina-Sina-Sina-Sina-"), 0);
+
+    copy2 = "Mina-Mina-Mina-Mina-Mina-";
+    EXPECT_FALSE(str.isShared());
+    EXPECT_EQ(strcmp(str.getBuffer(), "Sina-Sina-Sina-Sina-Sina-"), 0);
+
+    // A reference handed out by operator[] keeps later copies away from the buffer.
+    copy2 = str;
+    char & first = str[0];
+    EXPECT_NE(copy2.getBuffer(), str.getBuffer());
+    smp::SMPString copy3 = str;
+    first = 'M';
+    EXPECT_NE(copy3.getBuffer(), str.getBuffer());
+    EXPECT_EQ(copy3[0], 'S');
+    EXPECT_EQ(copy2[0], 'S');
+    EXPECT_EQ(str[0], 'M');
+}
+
+TEST(SMP_STRING, SUCCESSFUL_STRING_SET_CHAR_KEEPS_SHARED_BUFFER_ON_FULL_POOL)
+{
+    const size_t memoryBlockSize = 16;
+    const size_t totalMemorySize = 16 * memoryBlockSize;
+    smp::SimpleFixedMemoryPool simpleMemoryPool(totalMemorySize, memoryBlockSize);
+
+    auto str = smp::SMPString(&simpleMemoryPool, "Sina-Sina-Sina-Sina-Sina-");
+    smp::SMPString copy = str;
+    std::vector<smp::MemoryBlock> blocks;
+    for(smp::MemoryBlock mem = simpleMemoryPool.allocateMemory(); mem.ptr; mem = simpleMemoryPool.allocateMemory())
+    {
+        blocks.push_back(mem);
+    }
+    EXPECT_EQ(simpleMemoryPool.getFreeMemoryBlocksCount(), 0);
+
+    EXPECT_FALSE(copy.setChar(0, 'M'));
+    EXPECT_TRUE(str.isShared());
+    EXPECT_EQ(copy.getBuffer(), str.getBuffer());
+    EXPECT_EQ(std::string_view(str), "Sina-Sina-Sina-Sina-Sina-");
+    EXPECT_EQ(std::string_view(copy), "Sina-Sina-Sina-Sina-Sina-");
+    // A char & cannot report the failure, handing one out would let writes reach both strings.
+    EXPECT_DEATH(copy[0] = 'M', "");
+
+    // Once the pool has room again the write goes to a private copy.
+    for(smp::MemoryBlock & mem : blocks)
+    {
+        EXPECT_TRUE(simpleMemoryPool.freeMemory(&mem));
+    }
+    EXPECT_TRUE(copy.setChar(0, 'M'));
+    EXPECT_NE(copy.getBuffer(), str.getBuffer());
+    EXPECT_EQ(std::string_view(copy), "Mina-Sina-Sina-Sina-Sina-");
+    EXPECT_EQ(std::string_view(str), "Sina-Sina-Sina-Sina-Sina-");
+    // setChar() left the private copy shareable, operator[] does not.
+    smp::SMPString copy2 = copy;
+    EXPECT_TRUE(copy.isShared());
+    copy[1] = 'o';
+    EXPECT_NE(copy.getBuffer(), copy2.getBuffer());
+    EXPECT_EQ(std::string_view(copy), "Mona-Sina-Sina-Sina-Sina-");
+    EXPECT_EQ(std::string_view(copy2), "Mina-Sina-Sina-Sina-Sina-");
+}
+#endif
+
+TEST(SMP_Resize, SuccessfulResizeMemoryInPlace)
+{
+    const size_t totalMemorySize = 256;
+    const size_t memoryBlockSize = 16;
+    smp::SimpleFixedMemoryPool simpleMemoryPool(totalMemorySize, memoryBlockSize);
+
+    auto mem = simpleMemoryPool.allocateMemory(2 * memoryBlockSize);
+    auto mem2 = simpleMemoryPool.allocateMemory(memoryBlockSize);
+    EXPECT_FALSE(simpleMemoryPool.resizeMemory(&mem, 3 * memoryBlockSize));
+    EXPECT_EQ(mem.size, 2 * memoryBlockSize);
+
+    EXPECT_TRUE(simpleMemoryPool.freeMemory(&mem2));
+    EXPECT_TRUE(simpleMemoryPool.resizeMemory(&mem, 4 * memoryBlockSize));
+    EXPECT_EQ(mem.size, getAllocatedSize(4 * memoryBlockSize, memoryBlockSize));
+    EXPECT_EQ(simpleMemoryPool.getUsedMemoryBlocksCount(), getRunBlocksCount(4 * memoryBlockSize, memoryBlockSize));
+
+    EXPECT_TRUE(simpleMemoryPool.resizeMemory(&mem, 1));
+    EXPECT_EQ(mem.size, getAllocatedSize(1, memoryBlockSize));
+    EXPECT_EQ(simpleMemoryPool.getUsedMemoryBlocksCount(), getRunBlocksCount(1, memoryBlockSize));
+    EXPECT_EQ(simpleMemoryPool.getLargestFreeRunBlocksCount(), simpleMemoryPool.getMemoryBlocksCount() - getRunBlocksCount(1, memoryBlockSize));
+
+    smp::MemoryBlock interior(mem.ptr + memoryBlockSize, memoryBlockSize);
+    EXPECT_FALSE(simpleMemoryPool.resizeMemory(&interior, 2 * memoryBlockSize));
+    EXPECT_TRUE(simpleMemoryPool.freeMemory(&mem));
+    EXPECT_EQ(simpleMemoryPool.getMemoryUsedSize(), 0);
+}
+
+TEST(SMP_STRING_BUILDER, SUCCESSFUL_SINGLE_ALLOCATION_CONCATENATION)
+{
+    const size_t totalMemorySize = 1024;
+    const size_t memoryBlockSize = 16;
+    smp::SimpleFixedMemoryPool simpleMemoryPool(totalMemorySize, memoryBlockSize);
+
+    auto symbol = smp::SMPString(&simpleMemoryPool, "EURUSD");
+    auto venue = smp::SMPString(&simpleMemoryPool, "XLON");
+    std::string side = "BUY";
+    auto allocationsCount = simpleMemoryPool.getStats().allocationsCount;
+
+    auto str = smp::concatenate(&simpleMemoryPool, symbol, ".", venue, std::string_view("|"), side, "|quantity=1000000");
+    EXPECT_EQ(strcmp(str.getBuffer(), "EURUSD.XLON|BUY|quantity=1000000"), 0);
+    EXPECT_EQ(str.getStringSize(), 32);
+    EXPECT_EQ(simpleMemoryPool.getStats().allocationsCount, allocationsCount + 1);
+    EXPECT_EQ(str.getBufferSize(), getStringBufferSize(32, memoryBlockSize));
+
+    auto shortStr = smp::concatenate(&simpleMemoryPool, symbol, ".", venue);
+    EXPECT_TRUE(shortStr.isInline());
+    EXPECT_EQ(strcmp(shortStr.getBuffer(), "EURUSD.XLON"), 0);
+    EXPECT_EQ(simpleMemoryPool.getStats().allocationsCount, allocationsCount + 1);
+}
+
+TEST(SMP_STRING_BUILDER, SUCCESSFUL_BUILDER_SPILLS_PIECES_TO_POOL)
+{
+    const size_t totalMemorySize = 4096;
+    const size_t memoryBlockSize = 64;
+    smp::SimpleFixedMemoryPool simpleMemoryPool(totalMemorySize, memoryBlockSize);
+
+    smp::SMPStringBuilder builder(&simpleMemoryPool);
+    std::string expected;
+    for(int i = 0; i < 40; ++i)
+    {
+        builder << "field=" << "value;";
+        expected += "field=value;";
+    }
+    EXPECT_EQ(builder.getPiecesCount(), 80);
+    EXPECT_EQ(builder.getStringSize(), expected.size());
+    EXPECT_FALSE(builder.hasFailed());
+
+    auto str = builder.build();
+    EXPECT_EQ(strcmp(str.getBuffer(), expected.c_str()), 0);
+    EXPECT_EQ(str.getStringSize(), expected.size());
+
+    builder.clear();
+    EXPECT_EQ(strcmp(builder.build().getBuffer(), ""), 0);
+}
+
+TEST(SMP_STRING_TABLE, SUCCESSFUL_INTERNING)
+{
+    const size_t totalMemorySize = 64 * 1024;
+    const size_t memoryBlockSize = 64;
+    smp::SimpleFixedMemoryPool simpleMemoryPool(totalMemorySize, memoryBlockSize);
+
+    {
+        smp::SMPStringTable table(&simpleMemoryPool);
+        auto symbol = smp::SMPString(&simpleMemoryPool, "EURUSD");
+        smp::InternedString eurusd = table.intern(symbol);
+        smp::InternedString xlon = table.intern("XLON");
+        ASSERT_TRUE(eurusd.isValid());
+        ASSERT_TRUE(xlon.isValid());
+        EXPECT_NE(eurusd, xlon);
+        EXPECT_EQ(table.intern(std::string_view("EURUSD.XLON", 6)), eurusd);
+        EXPECT_EQ(table.find("XLON"), xlon);
+        EXPECT_FALSE(table.find("XPAR").isValid());
+        EXPECT_EQ(table.getString(eurusd), "EURUSD");
+        EXPECT_EQ(strcmp(table.getBuffer(xlon), "XLON"), 0);
+
+        std::vector<std::string> names;
+        for(int i = 0; i < 1000; ++i)
+        {
+            names.push_back("SYMBOL." + std::to_string(i));
+        }
+        std::string longName(3000, 'L');
+        names.push_back(longName);
+        std::unordered_set<smp::InternedString> handles;
+        for(const auto & name : names)
+        {
+            smp::InternedString handle = table.intern(name);
+            ASSERT_TRUE(handle.isValid());
+            handles.insert(handle);
+        }
+        EXPECT_EQ(handles.size(), names.size());
+        EXPECT_EQ(table.getSize(), names.size() + 2);
+        for(const auto & name : names)
+        {
+            EXPECT_EQ(table.getString(table.find(name)), name);
+        }
+        EXPECT_GT(simpleMemoryPool.getMemoryUsedSize(), 0);
+    }
+    EXPECT_EQ(simpleMemoryPool.getMemoryUsedSize(), 0);
+}
+
+TEST(SMP_STRING_TABLE, SUCCESSFUL_BATCH_INTERNING)
+{
+    const size_t totalMemorySize = 64 * 1024;
+    const size_t memoryBlockSize = 64;
+    smp::SimpleFixedMemoryPool simpleMemoryPool(totalMemorySize, memoryBlockSize);
+    smp::SMPStringTable table(&simpleMemoryPool, 4);
+
+    std::vector<std::string> tokens;
+    for(int i = 0; i < 300; ++i)
+    {
+        tokens.push_back("VENUE." + std::to_string(i % 100));
+    }
+    std::vector<std::string_view> views(tokens.begin(), tokens.end());
+    std::vector<smp::InternedString> handles(views.size());
+    EXPECT_EQ(table.internBatch(views.data(), views.size(), handles.data()), views.size());
+    EXPECT_EQ(table.getSize(), 100);
+    for(size_t i = 0; i < handles.size(); ++i)
+    {
+        EXPECT_EQ(handles[i], handles[i % 100]);
+        EXPECT_EQ(table.getString(handles[i]), tokens[i]);
+    }
+}
+
+TEST(SMP_VECTOR, SUCCESSFUL_GROWS_IN_PLACE)
+{
+    const size_t totalMemorySize = 4096;
+    const size_t memoryBlockSize = 64;
+    smp::SimpleFixedMemoryPool simpleMemoryPool(totalMemorySize, memoryBlockSize);
+
+    smp::SMPVector<uint64_t> vector(&simpleMemoryPool);
+    EXPECT_TRUE(vector.pushBack(0));
+    const uint64_t * data = vector.getData();
+    EXPECT_EQ(vector.getCapacity(), getAllocatedSize(4 * sizeof(uint64_t), memoryBlockSize) / sizeof(uint64_t));
+    for(uint64_t i = 1; i < 100; ++i)
+    {
+        EXPECT_TRUE(vector.pushBack(vector[i - 1] + 1));
+    }
+    EXPECT_EQ(vector.getData(), data);
+    EXPECT_EQ(vector.getSize(), 100);
+    EXPECT_EQ(vector.back(), 99);
+    EXPECT_EQ(simpleMemoryPool.getStats().allocationsCount, 1);
+
+    vector.shrinkToFit();
+    EXPECT_EQ(vector.getCapacity(), getAllocatedSize(100 * sizeof(uint64_t), memoryBlockSize) / sizeof(uint64_t));
+    auto blocker = simpleMemoryPool.allocateMemory();
+    EXPECT_TRUE(vector.reserve(200));
+    EXPECT_NE(vector.getData(), data);
+    uint64_t sum = 0;
+    for(uint64_t value : vector)
+    {
+        sum += value;
+    }
+    EXPECT_EQ(sum, 4950);
+
+    smp::SMPVector<uint64_t> copy = vector;
+    vector.swapRemove(0);
+    EXPECT_EQ(vector[0], 99);
+    EXPECT_EQ(copy[0], 0);
+    EXPECT_TRUE(copy.resize(150));
+    EXPECT_EQ(copy[149], 0);
+    simpleMemoryPool.freeMemory(&blocker);
+}
+
+TEST(SMP_VECTOR, SUCCESSFUL_MOVE_ONLY_ELEMENTS)
+{
+    const size_t totalMemorySize = 4096;
+    const size_t memoryBlockSize = 16;
+    smp::SimpleFixedMemoryPool simpleMemoryPool(totalMemorySize, memoryBlockSize);
+
+    {
+        smp::SMPVector<std::unique_ptr<std::string>> vector(&simpleMemoryPool);
+        std::vector<smp::MemoryBlock> blockers;
+        for(int i = 0; i < 20; ++i)
+        {
+            EXPECT_NE(vector.emplaceBack(new std::string(std::to_string(i))), nullptr);
+            // Forces the next growth to move the elements.
+            blockers.push_back(simpleMemoryPool.allocateMemory());
+        }
+        EXPECT_EQ(*vector[0], "0");
+        EXPECT_EQ(*vector[19], "19");
+
+        smp::SMPVector<std::unique_ptr<std::string>> moved = std::move(vector);
+        EXPECT_TRUE(vector.isEmpty());
+        EXPECT_EQ(*moved[7], "7");
+        moved.popBack();
+        EXPECT_EQ(moved.getSize(), 19);
+        for(auto & blocker : blockers)
+        {
+            simpleMemoryPool.freeMemory(&blocker);
+        }
+    }
+    EXPECT_EQ(simpleMemoryPool.getMemoryUsedSize(), 0);
+}
+
+TEST(SMP_HASH_MAP, SUCCESSFUL_MATCHES_UNORDERED_MAP)
+{
+    const size_t totalMemorySize = 1024 * 1024;
+    const size_t memoryBlockSize = 64;
+    smp::SimpleFixedMemoryPool simpleMemoryPool(totalMemorySize, memoryBlockSize);
+
+    {
+        smp::SMPHashMap<uint64_t, uint64_t> map(&simpleMemoryPool);
+        std::unordered_map<uint64_t, uint64_t> expected;
+        std::mt19937 random(42);
+        for(int i = 0; i < 20000; ++i)
+        {
+            uint64_t key = random() % 2000;
+            switch(random() % 3)
+            {
+            case 0:
+                EXPECT_EQ(*map.insertOrAssign(key, (uint64_t)i), (uint64_t)i);
+                expected[key] = i;
+                break;
+            case 1:
+                EXPECT_EQ(map.erase(key), expected.erase(key) == 1);
+                break;
+            default:
+                {
+                    auto found = expected.find(key);
+                    const uint64_t * value = map.find(key);
+                    EXPECT_EQ(value != nullptr, found != expected.end());
+                    if(value && found != expected.end())
+                    {
+                        EXPECT_EQ(*value, found->second);
+                    }
+                }
+                break;
+            }
+        }
+        EXPECT_EQ(map.getSize(), expected.size());
+        for(const auto & entry : map)
+        {
+            EXPECT_EQ(expected[entry.key], entry.value);
+        }
+        map.clear();
+        EXPECT_TRUE(map.isEmpty());
+        EXPECT_FALSE(map.contains(1));
+    }
+    EXPECT_EQ(simpleMemoryPool.getMemoryUsedSize(), 0);
+}
+
+TEST(SMP_HASH_MAP, SUCCESSFUL_MOVE_ONLY_VALUES_AND_RESERVE)
+{
+    const size_t totalMemorySize = 1024 * 1024;
+    const size_t memoryBlockSize = 64;
+    smp::SimpleFixedMemoryPool simpleMemoryPool(totalMemorySize, memoryBlockSize);
+
+    smp::SMPHashMap<std::string, std::unique_ptr<int>> map(&simpleMemoryPool, 1000);
+    size_t bucketsCount = map.getBucketsCount();
+    auto allocationsCount = simpleMemoryPool.getStats().allocationsCount;
+    for(int i = 0; i < 1000; ++i)
+    {
+        EXPECT_NE(map.tryEmplace(std::to_string(i), std::make_unique<int>(i)), nullptr);
+    }
+    EXPECT_EQ(simpleMemoryPool.getStats().allocationsCount, allocationsCount);
+    EXPECT_EQ(map.getBucketsCount(), bucketsCount);
+
+    std::unique_ptr<int> * value = map.tryEmplace(std::string("7"), std::make_unique<int>(-1));
+    EXPECT_EQ(**value, 7);
+    EXPECT_TRUE(map.erase("7"));
+    EXPECT_FALSE(map.erase("7"));
+    EXPECT_EQ(map.find("7"), nullptr);
+    EXPECT_EQ(**map.find("999"), 999);
+    EXPECT_EQ(map.getSize(), 999);
+}
+
+TEST(SMP_EPOCH_RECLAIMER, SUCCESSFUL_DEFERS_FREE_WHILE_READERS_INSIDE)
+{
+    const size_t totalMemorySize = 64 * 1024;
+    const size_t memoryBlockSize = 64;
+    smp::SimpleFixedMemoryPool simpleMemoryPool(totalMemorySize, memoryBlockSize);
+    {
+        smp::EpochReclaimer<> reclaimer(&simpleMemoryPool, 4, 8, 4);
+        Point * point = new (simpleMemoryPool.allocateMemory(sizeof(Point)).ptr) Point(1.0f, 2.0f);
+        {
+            smp::EpochReclaimer<>::ReadGuard guard(reclaimer);
+            reclaimer.retire(point);
+            EXPECT_EQ(reclaimer.reclaim(), 0);
+            EXPECT_EQ(reclaimer.getRetiredCount(), 1);
+            EXPECT_EQ(point->x, 1.0f);
+            EXPECT_EQ(simpleMemoryPool.getUsedMemoryBlocksCount(), 1);
+        }
+        EXPECT_EQ(reclaimer.reclaim(), 1);
+        EXPECT_EQ(reclaimer.getRetiredCount(), 0);
+        EXPECT_EQ(simpleMemoryPool.getUsedMemoryBlocksCount(), 0);
+
+        // Batches skip the blocks a reader inside may still reach, the next batch takes them.
+        {
+            smp::EpochReclaimer<>::ReadGuard guard(reclaimer);
+            for(size_t i = 0; i < 7; ++i)
+            {
+                reclaimer.retire(simpleMemoryPool.allocateMemory(memoryBlockSize - RedZoneSize));
+            }
+            EXPECT_EQ(reclaimer.getRetiredCount(), 7);
+            EXPECT_EQ(simpleMemoryPool.getUsedMemoryBlocksCount(), 7);
+        }
+        reclaimer.retire(simpleMemoryPool.allocateMemory(memoryBlockSize - RedZoneSize));
+        EXPECT_EQ(reclaimer.getRetiredCount(), 0);
+        EXPECT_EQ(simpleMemoryPool.getUsedMemoryBlocksCount(), 0);
+
+        smp::EpochReclaimer<>::ReadGuard guard(reclaimer);
+        reclaimer.retire(simpleMemoryPool.allocateMemory(memoryBlockSize));
+    }
+    EXPECT_EQ(simpleMemoryPool.getMemoryUsedSize(), 0);
+}
+
+TEST(SMP_EPOCH_RECLAIMER, SUCCESSFUL_RETIRES_PAST_CAPACITY_INSIDE_OWN_GUARD)
+{
+    const size_t totalMemorySize = 64 * 1024;
+    const size_t memoryBlockSize = 64;
+    const size_t retiredCapacity = 8;
+    smp::SimpleFixedMemoryPool simpleMemoryPool(totalMemorySize, memoryBlockSize);
+    smp::EpochReclaimer<> reclaimer(&simpleMemoryPool, 4, retiredCapacity, 4);
+
+    // The writer's own guard pins every block it retires, the list grows instead of waiting on it.
+    {
+        smp::EpochReclaimer<>::ReadGuard guard(reclaimer);
+        for(size_t i = 0; i < 3 * retiredCapacity + 1; ++i)
+        {
+            smp::MemoryBlock memoryBlock = simpleMemoryPool.allocateMemory(memoryBlockSize - RedZoneSize);
+            ASSERT_TRUE(memoryBlock.ptr);
+            memset(memoryBlock.ptr, int(i), memoryBlock.size);
+            reclaimer.retire(memoryBlock);
+        }
+        EXPECT_EQ(reclaimer.getRetiredCount(), 3 * retiredCapacity + 1);
+        EXPECT_EQ(reclaimer.getRetiredCapacity(), 4 * retiredCapacity);
+        EXPECT_EQ(simpleMemoryPool.getUsedMemoryBlocksCount(), 3 * retiredCapacity + 1);
+    }
+    EXPECT_EQ(reclaimer.reclaim(), 3 * retiredCapacity + 1);
+    EXPECT_EQ(simpleMemoryPool.getMemoryUsedSize(), 0);
+}
+
+TEST(SMP_EPOCH_RECLAIMER, SUCCESSFUL_READERS_NEVER_SEE_FREED_NODES)
+{
+    const size_t totalMemorySize = 1024 * 1024;
+    const size_t memoryBlockSize = 64;
+    const size_t readersCount = 4;
+    const int updatesCount = 20000;
+    smp::SimpleFixedMemoryPool simpleMemoryPool(totalMemorySize, memoryBlockSize);
+    smp::EpochReclaimer<smp::SimpleFixedMemoryPool, smp::NoLock> reclaimer(&simpleMemoryPool, readersCount, 64, 16);
+
+    // Freed blocks are zeroed, so a reader reaching a recycled node sees a mismatch.
+    struct Node
+    {
+        int value;
+        int check;
+    };
+    std::atomic<Node *> head(new (simpleMemoryPool.allocateMemory(sizeof(Node)).ptr) Node{ 1, -1 });
+    std::atomic<bool> isDone(false);
+    std::atomic<size_t> errorsCount(0);
+    std::vector<std::thread> readers;
+    for(size_t i = 0; i < readersCount; ++i)
+    {
+        readers.emplace_back([&]()
+        {
+            while(!isDone.load())
+            {
+                smp::EpochReclaimer<smp::SimpleFixedMemoryPool, smp::NoLock>::ReadGuard guard(reclaimer);
+                const Node * node = head.load(std::memory_order_acquire);
+                for(int j = 0; j < 16; ++j)
+                {
+                    if(node->value <= 0 || node->check != -node->value)
+                    {
+                        ++errorsCount;
+                    }
+                }
+            }
+        });
+    }
+    for(int i = 2; i <= updatesCount; ++i)
+    {
+        smp::MemoryBlock memoryBlock = simpleMemoryPool.allocateMemory(sizeof(Node));
+        ASSERT_NE(memoryBlock.ptr, nullptr);
+        Node * old = head.exchange(new (memoryBlock.ptr) Node{ i, -i }, std::memory_order_acq_rel);
+        reclaimer.retire(old);
+    }
+    isDone = true;
+    for(std::thread & reader : readers)
+    {
+        reader.join();
+    }
+    EXPECT_EQ(errorsCount.load(), 0);
+    reclaimer.reclaimAll();
+    EXPECT_EQ(reclaimer.getRetiredCount(), 0);
+    EXPECT_EQ(simpleMemoryPool.getUsedMemoryBlocksCount(), 1);
+}
+
+TEST(SMP_Construct, UNSUCCESSFUL_CONSTRUCTION_PAST_MAX_BLOCKS_COUNT)
+{
+    // Reported and left empty before any memory is reserved, like a sub-pool without room.
+    const size_t memoryBlockSize = 1;
+    const size_t totalMemorySize = (smp::FreeRunTree::MaxBlocksCount + 1) * memoryBlockSize;
+    smp::SimpleFixedMemoryPool simpleMemoryPool(totalMemorySize, memoryBlockSize);
+    EXPECT_EQ(simpleMemoryPool.getMemoryBlocksCount(), 0);
+    EXPECT_EQ(simpleMemoryPool.getMemoryTotalSize(), 0);
+    EXPECT_EQ(simpleMemoryPool.getFreeMemoryBlocksCount(), 0);
+    EXPECT_EQ(simpleMemoryPool.getLargestFreeRunBlocksCount(), 0);
+    EXPECT_FALSE(simpleMemoryPool.allocateMemory().ptr);
+
+    smp::SimpleFixedMemoryPool parentMemoryPool(1024, 64);
+    smp::SimpleFixedMemoryPool subMemoryPool(&parentMemoryPool, totalMemorySize, memoryBlockSize);
+    EXPECT_EQ(subMemoryPool.getMemoryBlocksCount(), 0);
+    EXPECT_EQ(parentMemoryPool.getMemoryUsedSize(), 0);
+}
+
+TEST(SMP_Allocate, SUCCESSFUL_LAZY_CONSTRUCTION_HIGH_WATER_MARK)
+{
+    const size_t totalMemorySize = size_t(1) << 30;
+    const size_t memoryBlockSize = 4096;
+    smp::SimpleFixedMemoryPool simpleMemoryPool(totalMemorySize, memoryBlockSize);
+    EXPECT_EQ(simpleMemoryPool.getHighWaterBlocksCount(), 0);
+    EXPECT_EQ(simpleMemoryPool.getResidentSize(), 0);
+    EXPECT_EQ(simpleMemoryPool.getFragmentationStats().largestFreeRunBlocksCount, totalMemorySize / memoryBlockSize);
+
+    smp::MemoryBlock first = simpleMemoryPool.allocateMemory(3 * memoryBlockSize - RedZoneSize);
+    smp::MemoryBlock second = simpleMemoryPool.allocateMemory();
+    EXPECT_EQ(simpleMemoryPool.getHighWaterBlocksCount(), 4);
+    EXPECT_EQ(simpleMemoryPool.getResidentSize(), 4 * memoryBlockSize);
+    EXPECT_TRUE(simpleMemoryPool.freeMemory(&first));
+    EXPECT_EQ(simpleMemoryPool.getHighWaterBlocksCount(), 4);
+
+    smp::MemoryFragmentationStats fragmentationStats = simpleMemoryPool.getFragmentationStats();
+    EXPECT_EQ(fragmentationStats.freeRunsCount, 2);
+    EXPECT_EQ(fragmentationStats.largestFreeRunBlocksCount, totalMemorySize / memoryBlockSize - 4);
+
+    // Blocks below the mark are reused before the untouched ones.
+    first = simpleMemoryPool.allocateMemory(2 * memoryBlockSize - RedZoneSize);
+    EXPECT_EQ(simpleMemoryPool.getHighWaterBlocksCount(), 4);
+    EXPECT_TRUE(simpleMemoryPool.resizeMemory(&second, 8 * memoryBlockSize - RedZoneSize));
+    EXPECT_EQ(simpleMemoryPool.getHighWaterBlocksCount(), 11);
+    for(size_t i = 0; i < second.size; ++i)
+    {
+        ASSERT_EQ(second.ptr[i], 0);
+    }
+    EXPECT_TRUE(simpleMemoryPool.freeMemory(&first));
+    EXPECT_TRUE(simpleMemoryPool.freeMemory(&second));
+}
+
+TEST(SMP_SUBPOOL, SUCCESSFUL_SUBPOOL_RELEASES_RUN_AT_ONCE)
+{
+    const size_t totalMemorySize = 1024 * 1024;
+    const size_t memoryBlockSize = 256;
+    smp::SimpleFixedMemoryPool parentMemoryPool(totalMemorySize, memoryBlockSize);
+    {
+        smp::SimpleFixedMemoryPool subMemoryPool(&parentMemoryPool, 64 * 1024, 16);
+        EXPECT_EQ(subMemoryPool.getParentPool(), &parentMemoryPool);
+        EXPECT_EQ(subMemoryPool.getMemoryTotalSize(), 64 * 1024);
+        EXPECT_EQ(subMemoryPool.getMemoryBlockSize(), 16);
+        EXPECT_EQ(subMemoryPool.getMemoryBlocksCount(), 4096);
+        // The blocks, their metadata and the free runs tree all come from a single parent run.
+        EXPECT_GT(parentMemoryPool.getMemoryUsedSize(), 64 * 1024);
+        EXPECT_EQ(parentMemoryPool.getStats().allocationsCount, 1);
+
+        std::vector<smp::MemoryBlock> blocks;
+        for(size_t i = 0; i < 100; ++i)
+        {
+            blocks.push_back(subMemoryPool.allocateMemory(40));
+            ASSERT_TRUE(blocks.back().ptr);
+            EXPECT_TRUE(parentMemoryPool.containsMemory(blocks.back().ptr));
+            EXPECT_EQ(blocks.back().ptr[0], 0);
+            memset(blocks.back().ptr, 0x33, 40);
+        }
+        EXPECT_TRUE(subMemoryPool.freeMemory(&blocks[0]));
+        auto str = smp::SMPString(&subMemoryPool, "A string long enough to live in the sub-pool");
+        EXPECT_EQ(subMemoryPool.getStats().allocationsCount, 101);
+        EXPECT_EQ(subMemoryPool.getStats().freesCount, 1);
+        EXPECT_EQ(parentMemoryPool.getStats().allocationsCount, 1);
+    }
+    // Everything still allocated in the sub-pool went back with its run.
+    EXPECT_EQ(parentMemoryPool.getMemoryUsedSize(), 0);
+    EXPECT_EQ(parentMemoryPool.getStats().freesCount, 1);
+    EXPECT_EQ(parentMemoryPool.getFreeMemoryBlocksCount(), parentMemoryPool.getMemoryBlocksCount());
+    EXPECT_EQ(parentMemoryPool.getFragmentationStats().largestFreeRunBlocksCount, parentMemoryPool.getMemoryBlocksCount());
+
+    // The released blocks are only cleaned when the parent hands them out again.
+    smp::MemoryBlock mem = parentMemoryPool.allocateMemory();
+    smp::MemoryBlock run = parentMemoryPool.allocateMemory(64 * memoryBlockSize);
+    ASSERT_TRUE(mem.ptr && run.ptr);
+    EXPECT_TRUE(parentMemoryPool.resizeMemory(&run, 300 * memoryBlockSize));
+    for(size_t i = 0; i < mem.size; ++i)
+    {
+        ASSERT_EQ(mem.ptr[i], 0);
+    }
+    for(size_t i = 0; i < run.size; ++i)
+    {
+        ASSERT_EQ(run.ptr[i], 0);
+    }
+    EXPECT_GE(parentMemoryPool.getUsedMemoryBlocksCount(), 301);
+    EXPECT_TRUE(parentMemoryPool.freeMemory(&mem));
+    EXPECT_TRUE(parentMemoryPool.freeMemory(&run));
+}
+
+TEST(SMP_SUBPOOL, SUCCESSFUL_SUBPOOL_RELEASED_RUN_DIRTY_ON_ALLOCATE)
+{
+    const size_t memoryBlockSize = 256;
+    smp::SimpleFixedMemoryPool parentMemoryPool(64 * 1024, memoryBlockSize, 1, smp::MemoryDistributionPolicy::None,
+                                                smp::MemoryZeroingPolicy::OnAllocate);
+    {
+        smp::SimpleFixedMemoryPool subMemoryPool(&parentMemoryPool, 16 * 1024, 64);
+        for(size_t i = 0; i < subMemoryPool.getMemoryBlocksCount(); ++i)
+        {
+            smp::MemoryBlock mem = subMemoryPool.allocateMemory();
+            ASSERT_TRUE(mem.ptr);
+            memset(mem.ptr, 0x44, mem.size);
+        }
+    }
+    smp::MemoryBlock mem = parentMemoryPool.allocateZeroed(32 * memoryBlockSize);
+    ASSERT_TRUE(mem.ptr);
+    for(size_t i = 0; i < mem.size; ++i)
+    {
+        ASSERT_EQ(mem.ptr[i], 0);
+    }
+    EXPECT_TRUE(parentMemoryPool.freeMemory(&mem));
+}
+
+TEST(SMP_SUBPOOL, UNSUCCESSFUL_FREE_OF_STALE_BLOCK_IN_RELEASED_RUN)
+{
+    const size_t memoryBlockSize = 256;
+    smp::SimpleFixedMemoryPool parentMemoryPool(64 * 1024, memoryBlockSize);
+    smp::MemoryBlock live = parentMemoryPool.allocateMemory();
+    ASSERT_TRUE(live.ptr);
+    smp::MemoryBlock stale;
+    smp::MemoryBlock staleSecond;
+    {
+        // Sub-pool blocks the size of the parent ones land on parent block boundaries.
+        smp::SimpleFixedMemoryPool subMemoryPool(&parentMemoryPool, 16 * 1024, memoryBlockSize);
+        stale = subMemoryPool.allocateMemory();
+        staleSecond = subMemoryPool.allocateMemory();
+        ASSERT_TRUE(stale.ptr && staleSecond.ptr);
+    }
+    size_t usedSize = parentMemoryPool.getMemoryUsedSize();
+    size_t freeBlocksCount = parentMemoryPool.getFreeMemoryBlocksCount();
+    EXPECT_EQ(usedSize, memoryBlockSize);
+
+    EXPECT_FALSE(parentMemoryPool.freeMemory(&stale));
+    EXPECT_FALSE(parentMemoryPool.freeMemory(&staleSecond));
+    EXPECT_FALSE(parentMemoryPool.resizeMemory(&stale, 2 * memoryBlockSize));
+    EXPECT_FALSE(parentMemoryPool.resizeMemory(&staleSecond, 1));
+    EXPECT_EQ(parentMemoryPool.getMemoryUsedSize(), usedSize);
+    EXPECT_EQ(parentMemoryPool.getFreeMemoryBlocksCount(), freeBlocksCount);
+    EXPECT_EQ(parentMemoryPool.getFragmentationStats().freeBlocksCount, freeBlocksCount);
+    EXPECT_TRUE(parentMemoryPool.freeMemory(&live));
+    EXPECT_EQ(parentMemoryPool.getMemoryUsedSize(), 0);
+}
+
+TEST(SMP_SUBPOOL, SUCCESSFUL_SUBPOOL_QUOTA)
+{
+    const size_t totalMemorySize = 1024 * 1024;
+    smp::SimpleFixedMemoryPool parentMemoryPool(totalMemorySize, 4096);
+    smp::SimpleFixedMemoryPool subMemoryPool(&parentMemoryPool, 16 * 1024, 64);
+    subMemoryPool.setQuotaSize(1024);
+    EXPECT_EQ(subMemoryPool.getQuotaSize(), 1024);
+
+    auto mem1 = subMemoryPool.allocateMemory(512 - RedZoneSize);
+    auto mem2 = subMemoryPool.allocateMemory();
+    EXPECT_TRUE(mem1.ptr);
+    EXPECT_TRUE(mem2.ptr);
+    EXPECT_FALSE(subMemoryPool.allocateMemory(512 - RedZoneSize).ptr);
+    EXPECT_FALSE(subMemoryPool.resizeMemory(&mem2, 576 - RedZoneSize));
+    EXPECT_TRUE(subMemoryPool.resizeMemory(&mem2, 448 - RedZoneSize));
+    EXPECT_FALSE(subMemoryPool.allocateMemory(128 - RedZoneSize).ptr);
+    EXPECT_EQ(subMemoryPool.getMemoryUsedSize(), 960);
+    smp::MemoryPoolStats stats = subMemoryPool.getStats();
+    EXPECT_EQ(stats.quotaFailuresCount, 3);
+    EXPECT_EQ(stats.allocationFailuresCount, 2);
+    EXPECT_EQ(stats.resizeFailuresCount, 1);
+
+    subMemoryPool.setQuotaSize(0);
+    auto mem3 = subMemoryPool.allocateMemory(512);
+    EXPECT_TRUE(mem3.ptr);
+    subMemoryPool.freeMemory(&mem1);
+    subMemoryPool.freeMemory(&mem2);
+    subMemoryPool.freeMemory(&mem3);
+}
+
+TEST(SMP_SUBPOOL, UNSUCCESSFUL_SUBPOOL_WITHOUT_PARENT_ROOM)
+{
+    smp::SimpleFixedMemoryPool parentMemoryPool(16 * 1024, 1024);
+    smp::SimpleFixedMemoryPool subMemoryPool(&parentMemoryPool, 32 * 1024, 64);
+    EXPECT_EQ(subMemoryPool.getMemoryTotalSize(), 0);
+    EXPECT_EQ(subMemoryPool.getMemoryBlocksCount(), 0);
+    EXPECT_FALSE(subMemoryPool.allocateMemory().ptr);
+    EXPECT_FALSE(subMemoryPool.allocateMemory(64).ptr);
+    EXPECT_EQ(parentMemoryPool.getMemoryUsedSize(), 0);
+}
+
+TEST(SMP_COLORING, SUCCESSFUL_COLORED_BLOCKS_LAYOUT)
+{
+    const size_t memoryBlockSize = 256;
+    const size_t memoryBlockStride = memoryBlockSize + smp::SimpleFixedMemoryPool::CacheLineSize;
+    const size_t totalMemorySize = 16 * memoryBlockStride;
+    smp::SimpleFixedMemoryPool memoryPool(totalMemorySize, memoryBlockSize, 1, smp::MemoryDistributionPolicy::None,
+                                          smp::MemoryZeroingPolicy::OnFree, smp::MemoryColoringPolicy::Colored);
+    EXPECT_EQ(memoryPool.getMemoryBlockStride(), memoryBlockStride);
+    EXPECT_EQ(memoryPool.getMemoryBlocksCount(), 16);
+
+    smp::MemoryBlock first = memoryPool.allocateMemory();
+    smp::MemoryBlock second = memoryPool.allocateMemory();
+    smp::MemoryBlock run = memoryPool.allocateMemory(3 * memoryBlockSize - smp::SimpleFixedMemoryPool::CacheLineSize);
+    EXPECT_EQ(static_cast<size_t>(second.ptr - first.ptr), memoryBlockStride);
+    EXPECT_EQ(static_cast<size_t>(run.ptr - first.ptr), 2 * memoryBlockStride);
+    EXPECT_TRUE(memoryPool.containsMemory(run.ptr + run.size - 1));
+    EXPECT_EQ(memoryPool.getUsedMemoryBlocksCount(), 5);
+    EXPECT_TRUE(memoryPool.freeMemory(&second));
+    EXPECT_TRUE(memoryPool.freeMemory(&run));
+    EXPECT_TRUE(memoryPool.freeMemory(&first));
+    EXPECT_EQ(memoryPool.getLargestFreeRunBlocksCount(), 16);
+
+    // Sizes that are not an even number of cache lines already stagger their blocks.
+    smp::SimpleFixedMemoryPool oddPool(totalMemorySize, 192, 1, smp::MemoryDistributionPolicy::None,
+                                       smp::MemoryZeroingPolicy::OnFree, smp::MemoryColoringPolicy::Colored);
+    EXPECT_EQ(oddPool.getMemoryBlockStride(), 192);
+}
+
+smp::SimpleFixedMemoryPool g_staticMemoryPool(1024, 64);
+
+TEST(SMP_PTR, SUCCESSFUL_UNIQUE_PTR_RUNTIME_POOL)
+{
+    const size_t totalMemorySize = 1024;
+    const size_t memoryBlockSize = 64;
+    smp::SimpleFixedMemoryPool simpleMemoryPool(totalMemorySize, memoryBlockSize);
+
+    {
+        auto p = smp::makePoolUnique<Point>(&simpleMemoryPool, 12.0f, 25.0f);
+        ASSERT_TRUE(p);
+        EXPECT_FLOAT_EQ(p->x, 12.0f);
+        EXPECT_FLOAT_EQ(p->y, 25.0f);
+        EXPECT_EQ(simpleMemoryPool.getUsedMemoryBlocksCount(), 1);
+    }
+    EXPECT_EQ(simpleMemoryPool.getUsedMemoryBlocksCount(), 0);
+}
+
+TEST(SMP_PTR, SUCCESSFUL_UNIQUE_PTR_STATIC_POOL)
+{
+    {
+        auto p = smp::makePoolUnique<&g_staticMemoryPool, Point>(12.0f, 25.0f);
+        ASSERT_TRUE(p);
+        EXPECT_EQ(sizeof(p), sizeof(Point *));
+        EXPECT_EQ(g_staticMemoryPool.getUsedMemoryBlocksCount(), 1);
+    }
+    EXPECT_EQ(g_staticMemoryPool.getUsedMemoryBlocksCount(), 0);
+}
+
+TEST(SMP_PTR, SUCCESSFUL_SHARED_PTR_SINGLE_ALLOCATION)
+{
+    const size_t totalMemorySize = 1024;
+    const size_t memoryBlockSize = 64;
+    smp::SimpleFixedMemoryPool simpleMemoryPool(totalMemorySize, memoryBlockSize);
+
+    {
+        auto p = smp::makePoolShared<Point>(&simpleMemoryPool, 12.0f, 25.0f);
+        ASSERT_TRUE(p);
+        EXPECT_EQ(simpleMemoryPool.getUsedMemoryBlocksCount(), 1);
+        auto p2 = p;
+        EXPECT_EQ(p.use_count(), 2);
+        EXPECT_EQ(simpleMemoryPool.getUsedMemoryBlocksCount(), 1);
+    }
+    EXPECT_EQ(simpleMemoryPool.getUsedMemoryBlocksCount(), 0);
+}
+
+TEST(SMP_PTR, UNSUCCESSFUL_SHARED_PTR_ON_FULL_POOL)
+{
+    const size_t totalMemorySize = 64;
+    const size_t memoryBlockSize = 64;
+    smp::SimpleFixedMemoryPool simpleMemoryPool(totalMemorySize, memoryBlockSize);
+
+    auto mem = simpleMemoryPool.allocateMemory();
+    auto p = smp::makePoolShared<Point>(&simpleMemoryPool, 12.0f, 25.0f);
+    EXPECT_FALSE(p);
+}
+
+TEST(SMP_STATS, SUCCESSFUL_STATS_COUNTERS)
+{
+    const size_t totalMemorySize = 1024;
+    const size_t memoryBlockSize = 256;
+    smp::SimpleFixedMemoryPool simpleMemoryPool(totalMemorySize, memoryBlockSize);
+
+    auto mem = simpleMemoryPool.allocateMemory();
+    auto mem2 = simpleMemoryPool.allocateMemory(600);
+    auto mem3 = simpleMemoryPool.allocateMemory(600);
+    simpleMemoryPool.freeMemory(&mem2);
+    simpleMemoryPool.freeMemory(&mem2);
+
+    auto stats = simpleMemoryPool.getStats();
+    EXPECT_EQ(stats.allocationsCount, 2);
+    EXPECT_EQ(stats.allocationFailuresCount, 1);
+    EXPECT_EQ(stats.freesCount, 1);
+    EXPECT_EQ(stats.freeFailuresCount, 1);
+    EXPECT_EQ(stats.usedSize, memoryBlockSize);
+    EXPECT_EQ(stats.peakUsedSize, 4 * memoryBlockSize);
+    // Hardened builds ask for the block without its red zone, 240 bytes instead of 256.
+    EXPECT_EQ(stats.requestedSizeHistogram[RedZoneSize > 0 ? 8 : 9], 1);
+    EXPECT_EQ(stats.requestedSizeHistogram[10], 2);
+    EXPECT_EQ(stats.blocksCountHistogram[1], 1);
+    EXPECT_EQ(stats.blocksCountHistogram[2], 2);
+}
+
+TEST(SMP_STATS, SUCCESSFUL_STATS_LATENCY_SAMPLING)
+{
+    const size_t totalMemorySize = 1024;
+    const size_t memoryBlockSize = 64;
+    smp::SimpleFixedMemoryPool simpleMemoryPool(totalMemorySize, memoryBlockSize);
+    simpleMemoryPool.setLatencySamplingRate(2);
+
+    smp::MemoryBlock memories[4];
+    for(auto & mem : memories)
+    {
+        mem = simpleMemoryPool.allocateMemory();
+    }
+    for(auto & mem : memories)
+    {
+        simpleMemoryPool.freeMemory(&mem);
+    }
+
+    auto stats = simpleMemoryPool.getStats();
+    EXPECT_EQ(stats.allocateLatencySamplesCount, 2);
+    EXPECT_EQ(stats.freeLatencySamplesCount, 2);
+
+    simpleMemoryPool.resetStats();
+    stats = simpleMemoryPool.getStats();
+    EXPECT_EQ(stats.allocationsCount, 0);
+    EXPECT_EQ(stats.peakUsedSize, 0);
+}
+
+TEST(SMP_FRAGMENTATION, SUCCESSFUL_LARGEST_FREE_RUN)
+{
+    const size_t totalMemorySize = 1024;
+    const size_t memoryBlockSize = 64;
+    smp::SimpleFixedMemoryPool simpleMemoryPool(totalMemorySize, memoryBlockSize);
+    EXPECT_EQ(simpleMemoryPool.getLargestFreeRunBlocksCount(), 16);
+    EXPECT_EQ(simpleMemoryPool.getFreeRunsCount(), 1);
+
+    smp::MemoryBlock memories[16];
+    for(auto & mem : memories)
+    {
+        mem = simpleMemoryPool.allocateMemory();
+    }
+    EXPECT_EQ(simpleMemoryPool.getLargestFreeRunBlocksCount(), 0);
+    EXPECT_EQ(simpleMemoryPool.getFreeRunsCount(), 0);
+
+    for(size_t i = 0; i < 16; i += 2)
+    {
+        simpleMemoryPool.freeMemory(&memories[i]);
+    }
+    simpleMemoryPool.freeMemory(&memories[9]);
+    EXPECT_EQ(simpleMemoryPool.getLargestFreeRunBlocksCount(), 3);
+    EXPECT_EQ(simpleMemoryPool.getFreeRunsCount(), 7);
+    EXPECT_FALSE(simpleMemoryPool.allocateMemory(4 * memoryBlockSize - RedZoneSize).ptr);
+
+    auto mem = simpleMemoryPool.allocateMemory(3 * memoryBlockSize - RedZoneSize);
+    EXPECT_EQ(mem.ptr, memories[7].ptr + memoryBlockSize);
+
+    auto stats = simpleMemoryPool.getFragmentationStats();
+    EXPECT_EQ(stats.freeBlocksCount, 6);
+    EXPECT_EQ(stats.largestFreeRunBlocksCount, 1);
+    EXPECT_EQ(stats.freeRunsCount, 6);
+    EXPECT_EQ(stats.freeRunsHistogram[0], 6);
+    EXPECT_DOUBLE_EQ(stats.fragmentationIndex, 1.0 - 1.0 / 6.0);
+}
+
+TEST(SMP_FRAGMENTATION, SUCCESSFUL_RANDOM_ALLOCATIONS_MATCH_BLOCKS_LAYOUT)
+{
+    const size_t memoryBlockSize = 16;
+    // The free runs tree splits a count that is not a power of two unevenly.
+    for(size_t totalMemorySize : { 4096, 4000 })
+    {
+        smp::SimpleFixedMemoryPool simpleMemoryPool(totalMemorySize, memoryBlockSize);
+        size_t memoryBlockCount = totalMemorySize / memoryBlockSize;
+
+        std::vector<smp::MemoryBlock> memories;
+        unsigned int seed = 7;
+        for(int i = 0; i < 2000; ++i)
+        {
+            seed = seed * 1103515245 + 12345;
+            if(memories.empty() || (seed >> 16) % 3)
+            {
+                auto mem = simpleMemoryPool.allocateMemory(((seed >> 8) % 8 + 1) * memoryBlockSize);
+                if(mem.ptr)
+                {
+                    memories.push_back(mem);
+                }
+            }
+            else
+            {
+                size_t index = (seed >> 4) % memories.size();
+                ASSERT_TRUE(simpleMemoryPool.freeMemory(&memories[index]));
+                memories.erase(memories.begin() + index);
+            }
+
+            auto stats = simpleMemoryPool.getFragmentationStats();
+            EXPECT_EQ(stats.largestFreeRunBlocksCount, simpleMemoryPool.getLargestFreeRunBlocksCount());
+            EXPECT_EQ(stats.freeRunsCount, simpleMemoryPool.getFreeRunsCount());
+        }
+        EXPECT_LT(simpleMemoryPool.getFreeMemoryBlocksCount(), memoryBlockCount);
+    }
+}
+
+TEST(SMP_TRACE, SUCCESSFUL_TRACE_RECORDING)
+{
+    const size_t totalMemorySize = 1024;
+    const size_t memoryBlockSize = 64;
+    smp::SimpleFixedMemoryPool simpleMemoryPool(totalMemorySize, memoryBlockSize);
+    smp::AllocationTraceRecorder recorder(16);
+    simpleMemoryPool.setTraceRecorder(&recorder);
+
+    auto mem = simpleMemoryPool.allocateMemory(100);
+    Point * p = simpleMemoryPool.construct<Point>(12.0f, 25.0f);
+    auto mem2 = simpleMemoryPool.allocateMemory(2000);
+    simpleMemoryPool.destruct(&p);
+    simpleMemoryPool.freeMemory(&mem);
+
+    auto events = recorder.getEvents();
+    ASSERT_EQ(events.size(), 5);
+    EXPECT_EQ(events[0].type, smp::TraceEventType::Allocate);
+    EXPECT_EQ(events[0].size, 100);
+    EXPECT_EQ(events[0].blocksCount, 2);
+    EXPECT_EQ(events[1].type, smp::TraceEventType::Construct);
+    EXPECT_EQ(events[2].id, 0);
+    EXPECT_EQ(events[3].type, smp::TraceEventType::Destruct);
+    EXPECT_EQ(events[3].id, events[1].id);
+    EXPECT_EQ(events[4].type, smp::TraceEventType::Free);
+    EXPECT_EQ(events[4].id, events[0].id);
+    EXPECT_LE(events[0].timestamp, events[4].timestamp);
+}
+
+TEST(SMP_TRACE, SUCCESSFUL_TRACE_RING_BUFFER_AND_FILE)
+{
+    const size_t totalMemorySize = 1024;
+    const size_t memoryBlockSize = 64;
+    smp::SimpleFixedMemoryPool simpleMemoryPool(totalMemorySize, memoryBlockSize);
+    smp::AllocationTraceRecorder recorder(4);
+    simpleMemoryPool.setTraceRecorder(&recorder);
+
+    for(int i = 0; i < 6; ++i)
+    {
+        auto mem = simpleMemoryPool.allocateMemory();
+        simpleMemoryPool.freeMemory(&mem);
+    }
+    EXPECT_EQ(recorder.getDroppedEventsCount(), 8);
+
+    const char * filePath = "smp_trace_test.bin";
+    ASSERT_TRUE(recorder.saveToFile(filePath));
+    std::vector<smp::TraceEvent> events;
+    ASSERT_TRUE(smp::AllocationTraceRecorder::loadFromFile(filePath, events));
+    remove(filePath);
+    ASSERT_EQ(events.size(), 4);
+    EXPECT_EQ(events[3].type, smp::TraceEventType::Free);
+    EXPECT_EQ(events[3].id, 6);
+}
+
+TEST(SMP_BASIC_POOL, SUCCESSFUL_ALLOCATE_AND_FREE)
+{
+    const size_t totalMemorySize = 1024;
+    smp::BasicFixedPool<256> basicPool(totalMemorySize);
+    EXPECT_EQ(basicPool.getMemoryBlocksCount(), 4);
+
+    auto mem = basicPool.allocateMemory(300);
+    ASSERT_TRUE(mem.ptr);
+    EXPECT_EQ(mem.size, 512);
+    auto mem2 = basicPool.allocateMemory();
+    ASSERT_TRUE(mem2.ptr);
+    EXPECT_EQ(mem2.ptr, mem.ptr + 512);
+    EXPECT_FALSE(basicPool.allocateMemory(512).ptr);
+    EXPECT_EQ(basicPool.getFreeMemoryBlocksCount(), 1);
+
+    smp::MemoryBlock interior(mem.ptr + 256, 256);
+    EXPECT_FALSE(basicPool.freeMemory(&interior));
+    EXPECT_TRUE(basicPool.freeMemory(&mem));
+    EXPECT_FALSE(mem.ptr);
+    EXPECT_EQ(basicPool.getMemoryUsedSize(), 256);
+    EXPECT_EQ(basicPool.getLargestFreeRunBlocksCount(), 2);
+}
+
+TEST(SMP_BASIC_POOL, SUCCESSFUL_CLOSE_RANGES_POLICY)
+{
+    const size_t memoryBlockSize = 16;
+    const size_t totalMemorySize = memoryBlockSize * 1024;
+    smp::BasicFixedPool<memoryBlockSize, smp::CloseRangesDistribution<4>> basicPool(totalMemorySize);
+
+    for(int i = 0; i < 4; ++i)
+    {
+        EXPECT_TRUE(basicPool.allocateMemory(64 * memoryBlockSize).ptr);
+    }
+    EXPECT_FALSE(basicPool.allocateMemory(64 * memoryBlockSize).ptr);
+    EXPECT_FALSE(basicPool.allocateMemory(300 * memoryBlockSize).ptr);
+}
+
+TEST(SMP_BASIC_POOL, SUCCESSFUL_LOCKED_POOL_WITH_STATS)
+{
+    smp::BasicFixedPool<64, smp::NoDistribution, smp::MutexLock, smp::CollectStats, smp::NoZeroing> basicPool(1024);
+
+    Point * p = basicPool.construct<Point>(12.0f, 25.0f);
+    ASSERT_TRUE(p);
+    EXPECT_FLOAT_EQ(p->y, 25.0f);
+    EXPECT_TRUE(basicPool.destruct(&p));
+    EXPECT_FALSE(p);
+
+    auto stats = basicPool.getStats();
+    EXPECT_EQ(stats.allocationsCount, 1);
+    EXPECT_EQ(stats.freesCount, 1);
+    EXPECT_EQ(stats.peakUsedSize, 64);
+}
+
+#if SMP_HARDENING_ENABLED
+// With AddressSanitizer the poisoned red zone and freed blocks stop the faulty write itself.
+#define SMP_CORRUPTION_MESSAGE(what) what "|use-after-poison"
+
+TEST(SMP_HARDENING_DeathTest, SUCCESSFUL_DETECTS_RED_ZONE_OVERRUN)
+{
+    const size_t totalMemorySize = 1024;
+    const size_t memoryBlockSize = 64;
+    EXPECT_DEATH(
+    {
+        smp::SimpleFixedMemoryPool simpleMemoryPool(totalMemorySize, memoryBlockSize);
+        auto mem = simpleMemoryPool.allocateMemory(20);
+        mem.ptr[mem.size] = 'x';
+        simpleMemoryPool.freeMemory(&mem);
+    }, SMP_CORRUPTION_MESSAGE("red zone overwritten"));
+}
+
+TEST(SMP_HARDENING_DeathTest, SUCCESSFUL_DETECTS_WRITE_AFTER_FREE)
+{
+    const size_t totalMemorySize = 1024;
+    const size_t memoryBlockSize = 64;
+    EXPECT_DEATH(
+    {
+        smp::SimpleFixedMemoryPool simpleMemoryPool(totalMemorySize, memoryBlockSize);
+        auto mem = simpleMemoryPool.allocateMemory(20);
+        unsigned char * stalePtr = mem.ptr;
+        simpleMemoryPool.freeMemory(&mem);
+        stalePtr[0] = 'x';
+        simpleMemoryPool.allocateMemory(20);
+    }, SMP_CORRUPTION_MESSAGE("write after free detected on reuse"));
+}
+
+TEST(SMP_HARDENING_DeathTest, SUCCESSFUL_DETECTS_INTERIOR_POINTER_FREE)
+{
+    const size_t totalMemorySize = 1024;
+    const size_t memoryBlockSize = 64;
+    EXPECT_DEATH(
+    {
+        smp::SimpleFixedMemoryPool simpleMemoryPool(totalMemorySize, memoryBlockSize);
+        auto mem = simpleMemoryPool.allocateMemory(3 * memoryBlockSize - RedZoneSize);
+        smp::MemoryBlock interior(mem.ptr + memoryBlockSize, memoryBlockSize);
+        simpleMemoryPool.freeMemory(&interior);
+    }, "free of an interior pointer, allocation id 1 ");
+}
+
+TEST(SMP_HARDENING_DeathTest, SUCCESSFUL_REPORTS_LEAKED_IDS)
+{
+    const size_t totalMemorySize = 1024;
+    const size_t memoryBlockSize = 64;
+    // Only the allocations still live when the pool goes away are listed.
+    EXPECT_EXIT(
+    {
+        {
+            smp::SimpleFixedMemoryPool simpleMemoryPool(totalMemorySize, memoryBlockSize);
+            simpleMemoryPool.allocateMemory(20);
+            auto mem = simpleMemoryPool.allocateMemory(30);
+            simpleMemoryPool.allocateMemory(100);
+            simpleMemoryPool.freeMemory(&mem);
+        }
+        exit(0);
+    }, ::testing::ExitedWithCode(0), "leaked allocation id 1 at .*, 20 bytes\n.*leaked allocation id 3 at .*, 100 bytes");
+}
+#endif
+
+#if !SMP_HARDENING_ENABLED
+TEST(SMP_ZEROING, SUCCESSFUL_ZEROING_ON_ALLOCATE)
+{
+    const size_t totalMemorySize = 1024;
+    const size_t memoryBlockSize = 64;
+    smp::SimpleFixedMemoryPool memoryPool(totalMemorySize, memoryBlockSize, 1, smp::MemoryDistributionPolicy::None,
+                                          smp::MemoryZeroingPolicy::OnAllocate);
+    EXPECT_EQ(memoryPool.getZeroingPolicy(), smp::MemoryZeroingPolicy::OnAllocate);
+
+    smp::MemoryBlock mem = memoryPool.allocateMemory(3 * memoryBlockSize);
+    unsigned char * ptr = mem.ptr;
+    memset(mem.ptr, 0xAB, mem.size);
+    EXPECT_TRUE(memoryPool.freeMemory(&mem));
+    EXPECT_EQ(ptr[0], 0xAB);
+
+    mem = memoryPool.allocateZeroed(4 * memoryBlockSize);
+    ASSERT_EQ(mem.ptr, ptr);
+    for(size_t i = 0; i < mem.size; ++i)
+    {
+        ASSERT_EQ(mem.ptr[i], 0);
+    }
+    EXPECT_TRUE(memoryPool.freeMemory(&mem));
+}
+
+TEST(SMP_ZEROING, SUCCESSFUL_ZEROING_IN_BULK_ON_FREE)
+{
+    const size_t memoryBlockSize = 4096;
+    const size_t totalMemorySize = memoryBlockSize * 16;
+    smp::SimpleFixedMemoryPool memoryPool(totalMemorySize, memoryBlockSize, 1, smp::MemoryDistributionPolicy::None,
+                                          smp::MemoryZeroingPolicy::OnFreeBulk);
+
+    smp::MemoryBlock small = memoryPool.allocateMemory();
+    smp::MemoryBlock big = memoryPool.allocateMemory(8 * memoryBlockSize);
+    unsigned char * smallPtr = small.ptr;
+    unsigned char * bigPtr = big.ptr;
+    memset(small.ptr, 0x5A, small.size);
+    memset(big.ptr, 0x5A, big.size);
+    EXPECT_TRUE(memoryPool.freeMemory(&small));
+    EXPECT_TRUE(memoryPool.freeMemory(&big));
+
+    for(size_t i = 0; i < memoryBlockSize; ++i)
+    {
+        ASSERT_EQ(smallPtr[i], 0);
+    }
+    for(size_t i = 0; i < 8 * memoryBlockSize; ++i)
+    {
+        ASSERT_EQ(bigPtr[i], 0);
+    }
+
+    smp::MemoryBlock mem = memoryPool.allocateZeroed(2 * memoryBlockSize);
+    EXPECT_EQ(mem.ptr, smallPtr);
+    EXPECT_TRUE(memoryPool.freeMemory(&mem));
+}
+
+TEST(SMP_ZEROING, SUCCESSFUL_ZEROING_COLORED_BLOCKS)
+{
+    const size_t memoryBlockSize = 128;
+    const size_t totalMemorySize = 8 * (memoryBlockSize + smp::SimpleFixedMemoryPool::CacheLineSize);
+    for(smp::MemoryZeroingPolicy zeroingPolicy : { smp::MemoryZeroingPolicy::OnFree, smp::MemoryZeroingPolicy::OnAllocate })
+    {
+        smp::SimpleFixedMemoryPool memoryPool(totalMemorySize, memoryBlockSize, 1, smp::MemoryDistributionPolicy::None,
+                                              zeroingPolicy, smp::MemoryColoringPolicy::Colored);
+        // A run spans the gaps of its blocks, shrinking it leaves data in the gaps it keeps.
+        smp::MemoryBlock mem = memoryPool.allocateMemory(4 * memoryBlockSize);
+        memset(mem.ptr, 0xCD, mem.size);
+        EXPECT_TRUE(memoryPool.resizeMemory(&mem, memoryBlockSize));
+        EXPECT_TRUE(memoryPool.freeMemory(&mem));
+
+        std::vector<smp::MemoryBlock> blocks(memoryPool.getMemoryBlocksCount());
+        for(smp::MemoryBlock & block : blocks)
+        {
+            block = memoryPool.allocateZeroed(memoryBlockSize);
+            ASSERT_NE(block.ptr, nullptr);
+            for(size_t i = 0; i < block.size; ++i)
+            {
+                ASSERT_EQ(block.ptr[i], 0);
+            }
+            memset(block.ptr, 0xCD, block.size);
+        }
+        for(smp::MemoryBlock & block : blocks)
+        {
+            EXPECT_TRUE(memoryPool.freeMemory(&block));
+        }
+
+        mem = memoryPool.allocateZeroed(4 * memoryBlockSize);
+        for(size_t i = 0; i < mem.size; ++i)
+        {
+            ASSERT_EQ(mem.ptr[i], 0);
+        }
+        EXPECT_TRUE(memoryPool.freeMemory(&mem));
+    }
+}
+#endif
+
+#if !SMP_HARDENING_ENABLED && defined(__linux__)
+TEST(SMP_TRIM, SUCCESSFUL_TRIM_RELEASES_FREE_PAGES)
+{
+    const size_t totalMemorySize = 1024 * 1024;
+    const size_t memoryBlockSize = 64;
+    const size_t pageSize = smp::getSystemPageSize();
+    smp::SimpleFixedMemoryPool memoryPool(totalMemorySize, memoryBlockSize, 1, smp::MemoryDistributionPolicy::None,
+                                          smp::MemoryZeroingPolicy::Never);
+
+    smp::MemoryBlock first = memoryPool.allocateMemory(64 * 1024);
+    smp::MemoryBlock kept = memoryPool.allocateMemory(memoryBlockSize);
+    unsigned char * firstPtr = first.ptr;
+    memset(first.ptr, 0xAB, first.size);
+    memset(kept.ptr, 0xEF, kept.size);
+    EXPECT_TRUE(memoryPool.freeMemory(&first));
+    EXPECT_EQ(memoryPool.getHighWaterBlocksCount(), 64 * 1024 / memoryBlockSize + 1);
+    EXPECT_EQ(memoryPool.getResidentSize(), 64 * 1024 + memoryBlockSize);
+
+    // Only the pages under the high water mark are released, not the kept block's one.
+    size_t releasedSize = memoryPool.trim();
+    EXPECT_GE(releasedSize, 64 * 1024 - 2 * pageSize);
+    EXPECT_EQ(releasedSize % pageSize, 0);
+    EXPECT_EQ(memoryPool.getResidentSize(), 64 * 1024 + memoryBlockSize - releasedSize);
+    EXPECT_EQ(memoryPool.trim(), 0);
+    smp::MemoryPoolStats stats = memoryPool.getStats();
+    EXPECT_EQ(stats.reservedSize, totalMemorySize);
+    EXPECT_EQ(stats.residentSize, 64 * 1024 + memoryBlockSize - releasedSize);
+    EXPECT_EQ(stats.trimsCount, 2);
+    EXPECT_EQ(stats.releasedSize, releasedSize);
+
+    first = memoryPool.allocateMemory(64 * 1024);
+    ASSERT_EQ(first.ptr, firstPtr);
+    EXPECT_EQ(memoryPool.getResidentSize(), 64 * 1024 + memoryBlockSize);
+    size_t zerosCount = 0;
+    for(size_t i = 0; i < first.size; ++i)
+    {
+        zerosCount += 0 == first.ptr[i] ? 1 : 0;
+    }
+    EXPECT_GE(zerosCount, first.size - pageSize);
+    for(size_t i = 0; i < kept.size; ++i)
+    {
+        ASSERT_EQ(kept.ptr[i], 0xEF);
+    }
+    memset(first.ptr, 0xAB, first.size);
+    EXPECT_TRUE(memoryPool.freeMemory(&first));
+    EXPECT_TRUE(memoryPool.freeMemory(&kept));
+    releasedSize = memoryPool.trim(smp::MemoryTrimMode::Lazy);
+    EXPECT_GE(releasedSize, 64 * 1024 - pageSize);
+    EXPECT_LE(memoryPool.getResidentSize(), 2 * pageSize);
+    EXPECT_EQ(memoryPool.getHighWaterBlocksCount(), 64 * 1024 / memoryBlockSize + 1);
+}
+
+TEST(SMP_TRIM, SUCCESSFUL_AUTO_TRIM_ON_FREE)
+{
+    const size_t totalMemorySize = 1024 * 1024;
+    const size_t memoryBlockSize = 64;
+    const size_t pageSize = smp::getSystemPageSize();
+    smp::SimpleFixedMemoryPool memoryPool(totalMemorySize, memoryBlockSize);
+    memoryPool.setAutoTrimThreshold(256 * 1024);
+    EXPECT_EQ(memoryPool.getAutoTrimThreshold(), 256 * 1024);
+
+    std::vector<smp::MemoryBlock> mems;
+    for(size_t i = 0; i < 16; ++i)
+    {
+        mems.push_back(memoryPool.allocateMemory(totalMemorySize / 16));
+    }
+    EXPECT_EQ(memoryPool.getStats().trimsCount, 0);
+    for(size_t i = 0; i < 3; ++i)
+    {
+        EXPECT_TRUE(memoryPool.freeMemory(&mems[i]));
+    }
+    EXPECT_EQ(memoryPool.getStats().trimsCount, 0);
+    EXPECT_TRUE(memoryPool.freeMemory(&mems[3]));
+    EXPECT_EQ(memoryPool.getStats().trimsCount, 1);
+    EXPECT_LE(memoryPool.getResidentSize(), totalMemorySize - totalMemorySize / 4 + pageSize);
+
+    // The next trim waits for another threshold of free bytes.
+    for(size_t i = 4; i < 8; ++i)
+    {
+        EXPECT_TRUE(memoryPool.freeMemory(&mems[i]));
+    }
+    EXPECT_EQ(memoryPool.getStats().trimsCount, 2);
+    EXPECT_LE(memoryPool.getResidentSize(), totalMemorySize / 2 + pageSize);
+
+    smp::MemoryBlock mem = memoryPool.allocateMemory(totalMemorySize / 2);
+    EXPECT_EQ(memoryPool.getResidentSize(), totalMemorySize);
+    for(size_t i = 0; i < mem.size; ++i)
+    {
+        ASSERT_EQ(mem.ptr[i], 0);
+    }
+    EXPECT_TRUE(memoryPool.freeMemory(&mem));
+    for(size_t i = 8; i < 16; ++i)
+    {
+        EXPECT_TRUE(memoryPool.freeMemory(&mems[i]));
+    }
+}
+
+TEST(SMP_TRIM, SUCCESSFUL_BULK_ZEROING_STATS_RESIDENT_SIZE)
+{
+    const size_t totalMemorySize = 1024 * 1024;
+    const size_t memoryBlockSize = 64;
+    const uintptr_t pageSize = smp::getSystemPageSize();
+    smp::SimpleFixedMemoryPool memoryPool(totalMemorySize, memoryBlockSize, 1, smp::MemoryDistributionPolicy::None,
+                                          smp::MemoryZeroingPolicy::OnFreeBulk);
+
+    smp::MemoryBlock first = memoryPool.allocateMemory(64 * 1024);
+    smp::MemoryBlock kept = memoryPool.allocateMemory(memoryBlockSize);
+    unsigned char * firstPtr = first.ptr;
+    memset(first.ptr, 0xAB, first.size);
+    EXPECT_EQ(memoryPool.getResidentSize(), 64 * 1024 + memoryBlockSize);
+
+    // The whole pages of the freed run are dropped and no longer count as resident.
+    auto pagesBegin = (reinterpret_cast<uintptr_t>(first.ptr) + pageSize - 1) & ~(pageSize - 1);
+    auto pagesEnd = (reinterpret_cast<uintptr_t>(first.ptr) + first.size) & ~(pageSize - 1);
+    EXPECT_TRUE(memoryPool.freeMemory(&first));
+    EXPECT_EQ(memoryPool.getResidentSize(), 64 * 1024 + memoryBlockSize - (pagesEnd - pagesBegin));
+    smp::MemoryPoolStats stats = memoryPool.getStats();
+    EXPECT_EQ(stats.residentSize, 64 * 1024 + memoryBlockSize - (pagesEnd - pagesBegin));
+    EXPECT_EQ(stats.trimsCount, 0);
+    EXPECT_EQ(memoryPool.trim(), 0);
+
+    first = memoryPool.allocateMemory(64 * 1024);
+    ASSERT_EQ(first.ptr, firstPtr);
+    EXPECT_EQ(memoryPool.getResidentSize(), 64 * 1024 + memoryBlockSize);
+    EXPECT_EQ(memoryPool.getStats().residentSize, 64 * 1024 + memoryBlockSize);
+    for(size_t i = 0; i < first.size; ++i)
+    {
+        ASSERT_EQ(first.ptr[i], 0);
+    }
+    EXPECT_TRUE(memoryPool.freeMemory(&first));
+    EXPECT_TRUE(memoryPool.freeMemory(&kept));
+}
+#endif
+
+#if defined(__cpp_impl_coroutine)
+namespace
+{
+    smp::PoolTask<int> addAsync(std::allocator_arg_t, [[maybe_unused]] smp::SimpleFixedMemoryPool * memoryPool, int a, int b)
+    {
+        co_return a + b;
+    }
+
+    smp::PoolTask<int> sumAsync(std::allocator_arg_t, smp::SimpleFixedMemoryPool * memoryPool, int count)
+    {
+        int total = 0;
+        for(int i = 0; i < count; ++i)
+        {
+            total += co_await addAsync(std::allocator_arg, memoryPool, i, 1);
+        }
+        co_return total;
+    }
+
+    smp::PoolTask<std::string> greetAsync(std::string name)
+    {
+        co_return "Hello " + name;
+    }
+
+    smp::PoolTask<void> throwAsync()
+    {
+        throw std::runtime_error("task failed");
+        co_return;
+    }
+
+    smp::PoolGenerator<int> iotaGenerator(std::allocator_arg_t, [[maybe_unused]] smp::SimpleFixedMemoryPool * memoryPool, int count)
+    {
+        for(int i = 0; i < count; ++i)
+        {
+            co_yield i;
+        }
+    }
+
+    smp::PoolTask<int, smp::PoolFrameCache<>> incrementAsync(std::allocator_arg_t, [[maybe_unused]] smp::PoolFrameCache<> * frameCache, int value)
+    {
+        co_return value + 1;
+    }
+
+    struct Counter
+    {
+        int value = 40;
+
+        smp::PoolTask<int> nextAsync(std::allocator_arg_t, [[maybe_unused]] smp::SimpleFixedMemoryPool * memoryPool)
+        {
+            co_return ++value;
+        }
+    };
+}
+
+TEST(SMP_COROUTINE, SUCCESSFUL_TASK_FRAMES_FROM_ALLOCATOR_ARG_POOL)
+{
+    smp::SimpleFixedMemoryPool memoryPool(64 * 1024, 256);
+    {
+        smp::PoolTask<int> task = sumAsync(std::allocator_arg, &memoryPool, 10);
+        // Lazy: the frame exists, the body has not run yet.
+        EXPECT_FALSE(task.isDone());
+        EXPECT_EQ(memoryPool.getStats().allocationsCount, 1);
+        EXPECT_TRUE(task.resume());
+        EXPECT_EQ(task.getResult(), 55);
+        EXPECT_EQ(memoryPool.getStats().allocationsCount, 11);
+        EXPECT_EQ(memoryPool.getStats().freesCount, 10);
+
+        Counter counter;
+        smp::PoolTask<int> memberTask = counter.nextAsync(std::allocator_arg, &memoryPool);
+        EXPECT_TRUE(memberTask.resume());
+        EXPECT_EQ(memberTask.getResult(), 41);
+        EXPECT_EQ(memoryPool.getStats().allocationsCount, 12);
+    }
+    EXPECT_EQ(memoryPool.getMemoryUsedSize(), 0);
+}
+
+TEST(SMP_COROUTINE, SUCCESSFUL_TASK_FRAMES_FROM_THREAD_POOL)
+{
+    smp::SimpleFixedMemoryPool memoryPool(64 * 1024, 256);
+    EXPECT_EQ(smp::PoolPromise<>::setThreadPool(&memoryPool), nullptr);
+    EXPECT_EQ(smp::PoolPromise<>::getThreadPool(), &memoryPool);
+    {
+        smp::PoolTask<std::string> task = greetAsync("pool");
+        EXPECT_EQ(memoryPool.getStats().allocationsCount, 1);
+        EXPECT_TRUE(task.resume());
+        EXPECT_EQ(task.getResult(), "Hello pool");
+    }
+    EXPECT_EQ(memoryPool.getMemoryUsedSize(), 0);
+    EXPECT_EQ(smp::PoolPromise<>::setThreadPool(nullptr), &memoryPool);
+
+    // Without a pool the frame comes from the global operator new.
+    smp::PoolTask<std::string> task = greetAsync("heap");
+    EXPECT_TRUE(task.resume());
+    EXPECT_EQ(task.getResult(), "Hello heap");
+    EXPECT_EQ(memoryPool.getStats().allocationsCount, 1);
+
+    smp::PoolTask<void> throwingTask = throwAsync();
+    EXPECT_TRUE(throwingTask.resume());
+    EXPECT_THROW(throwingTask.getResult(), std::runtime_error);
+}
+
+TEST(SMP_COROUTINE, SUCCESSFUL_GENERATOR_AND_FULL_POOL_FALLBACK)
+{
+    smp::SimpleFixedMemoryPool memoryPool(64 * 1024, 256);
+    int total = 0;
+    for(int value : iotaGenerator(std::allocator_arg, &memoryPool, 100))
+    {
+        total += value;
+    }
+    EXPECT_EQ(total, 4950);
+    EXPECT_EQ(memoryPool.getStats().allocationsCount, 1);
+    EXPECT_EQ(memoryPool.getMemoryUsedSize(), 0);
+
+    // A pool too small for the frame falls back to the global operator new.
+    smp::SimpleFixedMemoryPool tinyMemoryPool(16, 16);
+    smp::PoolTask<int> task = sumAsync(std::allocator_arg, &tinyMemoryPool, 3);
+    EXPECT_TRUE(task.resume());
+    EXPECT_EQ(task.getResult(), 6);
+    EXPECT_EQ(tinyMemoryPool.getStats().allocationsCount, 0);
+    EXPECT_EQ(tinyMemoryPool.getStats().allocationFailuresCount, 4);
+}
+
+TEST(SMP_COROUTINE, SUCCESSFUL_FRAME_CACHE_RECYCLES_FRAMES)
+{
+    smp::SimpleFixedMemoryPool memoryPool(64 * 1024, 64);
+    {
+        smp::PoolFrameCache<> frameCache(&memoryPool);
+        int value = 0;
+        for(int i = 0; i < 100; ++i)
+        {
+            smp::PoolTask<int, smp::PoolFrameCache<>> task = incrementAsync(std::allocator_arg, &frameCache, value);
+            EXPECT_TRUE(task.resume());
+            value = task.getResult();
+        }
+        EXPECT_EQ(value, 100);
+        // One frame went through the pool, the others were recycled.
+        EXPECT_EQ(memoryPool.getStats().allocationsCount, 1);
+        EXPECT_EQ(frameCache.getCachedCount(), 1);
+        EXPECT_GT(memoryPool.getMemoryUsedSize(), 0);
+    }
+    EXPECT_EQ(memoryPool.getMemoryUsedSize(), 0);
+}
+#endif
@@ -0,0 +1,279 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+#include "SimpleFixedMemoryPool.h"
+#include "AllocationTrace.h"
+
+namespace smp = SimpleMemoryPool;
+
+namespace
+{
+    void printUsage(const char * programName)
+    {
+        printf("Usage : %s <trace file> <total size> <block size> [distributed count] [none|close|open|adaptive] [options]\n"
+               "Options :\n"
+               "  --zeroing=onfree|onfreebulk|onallocate|never\n"
+               "  --coloring=packed|colored\n"
+               "  --quota=<bytes>\n"
+               "  --trim-threshold=<bytes>\n", programName);
+    }
+
+    // Options are --name=value, value points past the '='.
+    const char * getOptionValue(const char * arg, const char * name)
+    {
+        size_t nameLength = strlen(name);
+        return 0 == strncmp(arg, name, nameLength) && '=' == arg[nameLength] ? arg + nameLength + 1 : nullptr;
+    }
+
+    bool parsePolicy(const char * name, smp::MemoryDistributionPolicy & policy)
+    {
+        bool ret = true;
+        if(0 == strcmp(name, "none"))
+        {
+            policy = smp::MemoryDistributionPolicy::None;
+        }
+        else if(0 == strcmp(name, "close"))
+        {
+            policy = smp::MemoryDistributionPolicy::CloseRanges;
+        }
+        else if(0 == strcmp(name, "open"))
+        {
+            policy = smp::MemoryDistributionPolicy::OpenRanges;
+        }
+        else if(0 == strcmp(name, "adaptive"))
+        {
+            policy = smp::MemoryDistributionPolicy::AdaptiveRanges;
+        }
+        else
+        {
+            ret = false;
+        }
+        return ret;
+    }
+
+    bool parseZeroingPolicy(const char * name, smp::MemoryZeroingPolicy & policy)
+    {
+        bool ret = true;
+        if(0 == strcmp(name, "onfree"))
+        {
+            policy = smp::MemoryZeroingPolicy::OnFree;
+        }
+        else if(0 == strcmp(name, "onfreebulk"))
+        {
+            policy = smp::MemoryZeroingPolicy::OnFreeBulk;
+        }
+        else if(0 == strcmp(name, "onallocate"))
+        {
+            policy = smp::MemoryZeroingPolicy::OnAllocate;
+        }
+        else if(0 == strcmp(name, "never"))
+        {
+            policy = smp::MemoryZeroingPolicy::Never;
+        }
+        else
+        {
+            ret = false;
+        }
+        return ret;
+    }
+
+    bool parseColoringPolicy(const char * name, smp::MemoryColoringPolicy & policy)
+    {
+        bool ret = true;
+        if(0 == strcmp(name, "packed"))
+        {
+            policy = smp::MemoryColoringPolicy::Packed;
+        }
+        else if(0 == strcmp(name, "colored"))
+        {
+            policy = smp::MemoryColoringPolicy::Colored;
+        }
+        else
+        {
+            ret = false;
+        }
+        return ret;
+    }
+
+    bool isAllocation(smp::TraceEventType type)
+    {
+        return smp::TraceEventType::Allocate == type || smp::TraceEventType::Construct == type;
+    }
+}
+
+// Feeds a recorded trace into a pool configuration and reports how it behaves.
+// Allocations are matched to their frees through the recorded allocation ids.
+int main(int argc, char ** argv)
+{
+    std::vector<const char *> positionalArgs;
+    smp::MemoryZeroingPolicy zeroingPolicy = smp::MemoryZeroingPolicy::OnFree;
+    smp::MemoryColoringPolicy coloringPolicy = smp::MemoryColoringPolicy::Packed;
+    size_t quotaSize = 0;
+    size_t trimThreshold = 0;
+    bool isValid = true;
+    for(int i = 1; i < argc; ++i)
+    {
+        const char * value = nullptr;
+        if(0 != strncmp(argv[i], "--", 2))
+        {
+            positionalArgs.push_back(argv[i]);
+        }
+        else if((value = getOptionValue(argv[i], "--zeroing")))
+        {
+            isValid = isValid && parseZeroingPolicy(value, zeroingPolicy);
+        }
+        else if((value = getOptionValue(argv[i], "--coloring")))
+        {
+            isValid = isValid && parseColoringPolicy(value, coloringPolicy);
+        }
+        else if((value = getOptionValue(argv[i], "--quota")))
+        {
+            quotaSize = strtoull(value, nullptr, 10);
+        }
+        else if((value = getOptionValue(argv[i], "--trim-threshold")))
+        {
+            trimThreshold = strtoull(value, nullptr, 10);
+        }
+        else
+        {
+            isValid = false;
+        }
+    }
+    smp::MemoryDistributionPolicy policy = smp::MemoryDistributionPolicy::None;
+    if(!isValid || positionalArgs.size() < 3 || positionalArgs.size() > 5 ||
+       (positionalArgs.size() > 4 && !parsePolicy(positionalArgs[4], policy)))
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    const char * tracePath = positionalArgs[0];
+    size_t totalSize = strtoull(positionalArgs[1], nullptr, 10);
+    size_t blockSize = strtoull(positionalArgs[2], nullptr, 10);
+    size_t distributedCount = positionalArgs.size() > 3 ? strtoull(positionalArgs[3], nullptr, 10) : 1;
+
+    std::vector<smp::TraceEvent> events;
+    if(!smp::AllocationTraceRecorder::loadFromFile(tracePath, events))
+    {
+        printf("COULD NOT LOAD trace file %s\n", tracePath);
+        return 1;
+    }
+
+    smp::SimpleFixedMemoryPool memoryPool(totalSize, blockSize, distributedCount, policy, zeroingPolicy, coloringPolicy);
+    memoryPool.setQuotaSize(quotaSize);
+    memoryPool.setAutoTrimThreshold(trimThreshold);
+    std::unordered_map<uint64_t, smp::MemoryBlock> liveBlocks;
+    liveBlocks.reserve(events.size());
+
+    size_t allocationsCount = 0;
+    size_t allocationFailuresCount = 0;
+    size_t recordedFailuresCount = 0;
+    size_t freesCount = 0;
+    size_t skippedFreesCount = 0;
+    size_t resizesCount = 0;
+    size_t movedResizesCount = 0;
+    size_t peakUsedSize = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for(const smp::TraceEvent & event : events)
+    {
+        if(isAllocation(event.type))
+        {
+            smp::MemoryBlock mem = memoryPool.allocateMemory(event.size);
+            ++allocationsCount;
+            if(!mem.ptr)
+            {
+                ++allocationFailuresCount;
+            }
+            if(0 == event.id)
+            {
+                // The recorded caller never got this memory, so it never frees it either.
+                ++recordedFailuresCount;
+                memoryPool.freeMemory(&mem);
+            }
+            else if(mem.ptr)
+            {
+                liveBlocks[event.id] = mem;
+                if(memoryPool.getMemoryUsedSize() > peakUsedSize)
+                {
+                    peakUsedSize = memoryPool.getMemoryUsedSize();
+                }
+            }
+        }
+        else if(smp::TraceEventType::Resize == event.type)
+        {
+            // A resize that fails in place here is replayed as a move to a new run.
+            auto it = liveBlocks.find(event.id);
+            if(0 != event.id && it != liveBlocks.end())
+            {
+                ++resizesCount;
+                if(!memoryPool.resizeMemory(&it->second, event.size))
+                {
+                    ++movedResizesCount;
+                    smp::MemoryBlock mem = memoryPool.allocateMemory(event.size);
+                    memoryPool.freeMemory(&it->second);
+                    if(mem.ptr)
+                    {
+                        it->second = mem;
+                    }
+                    else
+                    {
+                        ++allocationFailuresCount;
+                        liveBlocks.erase(it);
+                    }
+                }
+                if(memoryPool.getMemoryUsedSize() > peakUsedSize)
+                {
+                    peakUsedSize = memoryPool.getMemoryUsedSize();
+                }
+            }
+        }
+        else
+        {
+            auto it = liveBlocks.find(event.id);
+            if(it != liveBlocks.end())
+            {
+                memoryPool.freeMemory(&it->second);
+                liveBlocks.erase(it);
+                ++freesCount;
+            }
+            else
+            {
+                ++skippedFreesCount;
+            }
+        }
+    }
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    size_t operationsCount = allocationsCount + freesCount + resizesCount;
+
+    printf("================\n");
+    printf("Pool : total size %zu, block size %zu, block stride %zu, blocks %zu, distributed count %zu\n",
+           memoryPool.getMemoryTotalSize(), memoryPool.getMemoryBlockSize(), memoryPool.getMemoryBlockStride(),
+           memoryPool.getMemoryBlocksCount(), distributedCount);
+    printf("Events : %zu, elapsed : %.6f s, throughput : %.0f ops/s\n",
+           events.size(), elapsed, elapsed > 0 ? operationsCount / elapsed : 0.0);
+    printf("Allocations : %zu, failures : %zu (recorded failures : %zu)\n",
+           allocationsCount, allocationFailuresCount, recordedFailuresCount);
+    printf("Frees : %zu, skipped frees of failed allocations : %zu\n", freesCount, skippedFreesCount);
+    printf("Resizes : %zu, moved because the run could not grow in place : %zu\n", resizesCount, movedResizesCount);
+    printf("Peak used size : %zu (%.2f%%), still allocated at end : %zu\n", peakUsedSize,
+           memoryPool.getMemoryTotalSize() ? 100.0 * peakUsedSize / memoryPool.getMemoryTotalSize() : 0.0,
+           memoryPool.getMemoryUsedSize());
+    printf("Largest free run at end : %zu blocks\n", memoryPool.getLargestFreeRunBlocksCount());
+    smp::MemoryPoolStats stats = memoryPool.getStats();
+    printf("Quota : %zu, quota failures : %zu\n", memoryPool.getQuotaSize(), stats.quotaFailuresCount);
+    printf("Resident size at end : %zu, trims : %zu, released size : %zu\n", stats.residentSize, stats.trimsCount, stats.releasedSize);
+    for(size_t i = 0; i < memoryPool.getDistributionRangesCount(); ++i)
+    {
+        smp::MemoryRangeStats range = memoryPool.getDistributionRangeStats(i);
+        printf("Range %zu : blocks [%zu, %zu), used %zu, allocations %zu, misses %zu, spills %zu, growths %zu\n", i,
+               range.firstBlock, range.firstBlock + range.blocksCount, range.usedBlocksCount, range.allocationsCount,
+               range.missesCount, range.spillsCount, range.growthsCount);
+    }
+    printf("================\n");
+    return 0;
+}